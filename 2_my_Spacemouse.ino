@@ -2,9 +2,37 @@
 #include "config.h"
 #include "screen.h"
 #include "usbSpaceHID.h"
+#if HID_TRANSPORT == HID_TRANSPORT_BLE
+#include "bluetooth.h"
+#endif
+#include "profiler.h"
 #include "kinematics.h"
+#include "fixedPipeline.h"
+#include "fusedPipeline.h"
+#if ONE_EURO > 0
+#include "oneEuro.h"
+#endif
+#include "samplingTask.h"
+#if POWER_GOVERNOR > 0
+#include "powerGovernor.h"
+#endif
+#if CALIBSTORE > 0
+#include "calibStore.h"
+#endif
 #include "calibration.h"
+#include "kinematicFit.h"
 #include "spaceKeys.h"
+#include "commandParser.h"
+#include "benchmark.h"
+#if AUTOZERO > 0
+#include "autoZero.h"
+#endif
+#if FLIGHTRECORDER > 0
+#include "flightRecorder.h"
+#endif
+#if TRACE_REPLAY > 0
+#include "traceReplay.h"
+#endif
 
 
 
@@ -19,6 +47,10 @@ bool doOnce = true;
 
 // stores the raw analog values from the joysticks
 int rawReads[8];
+// timestamp of the newest sensor frame in us
+uint32_t frameTimeUs;
+// timestamp of the first ADC scan, which went into the newest sensor frame, in us
+uint32_t frameFirstScanUs;
 
 // Centerpoints store the zero position of the joysticks
 int centerPoints[8];
@@ -38,21 +70,45 @@ uint8_t keyState[NUMKEYS];
 // int16_t to match what the HID protocol expects.
 int16_t velocity[6];
 
+#if SCREEN_DIRTY_RENDER > 0
+/// @brief Report the traffic to the display, see updateFrequencyReport()
+void printScreenStats() {
+  SERIAL.printf("Display: %lu bytes/s, %lu frames, %lu bytes, longest frame %lu us, %lu frames over budget\n",
+                (unsigned long)screenStats.bytesPerSec, (unsigned long)screenStats.frames, (unsigned long)screenStats.totalBytes,
+                (unsigned long)screenStats.maxFrameUs, (unsigned long)screenStats.overBudget);
+}
+#endif
 
 
 void setup() {
   setupUSB();
+#if HID_TRANSPORT == HID_TRANSPORT_BLE
+  setupBLE();
+#endif
 
   analogReadResolution(analogRead_Resolution);
+  setupSensors();
 
   setupDisplay();
 
   setupkalmanFilters();
-  busyZeroing(centerPoints, 500, true);
+#if CALIBSTORE > 0
+  // a calibrated unit doesn't need to be zeroed again
+  bool calibrated = loadCalibration(centerPoints);
+#else
+  bool calibrated = false;
+#endif
+  if (!calibrated) busyZeroing(centerPoints, 500, true);
 #ifdef LEDpin
   initLEDring();
 #endif
-  busyZeroing(centerPoints, 3000, true);
+  if (!calibrated) busyZeroing(centerPoints, 3000, true);
+  doOnce = !calibrated;
+
+#if SAMPLING_TASK > 0
+  // from now on, the sensors are read by the sampling task
+  startSamplingTask(centerPoints);
+#endif
 
   if (!HID.ready()) {
     delay(1);
@@ -65,55 +121,53 @@ void setup() {
 #endif
 }
 
-void loop() {
-  // check if the user entered a debug mode via serial interface
-  if (SERIAL.available()) {
-    int tmpInput = SERIAL.parseInt();  // Read from serial interface, if a new debug value has been sent. Serial timeout has been set in setup()
-    if (tmpInput != 0) {
-      debug = tmpInput;
-      if (tmpInput == -1) {
-        SERIAL.println(F("Please enter the debug mode now or while the script is reporting."));
-      }
-    }
-  }
-
-  // Joystick values are read. 0-1023
-  readAllFromSensors(rawReads);
-
-#if NUMKEYS > 0
-  // LivingTheDream added reading of key presses
-  readAllFromKeys(keyVals);
+/// @brief Process the centered values to the velocities and the keys: deadzone, mapping, kinematics, kill-keys, switchYZ
+/// and exclusive mode, including the debug outputs of these steps. Used by the loop() and the replay of a trace.
+void processCentered() {
+#if FUSED_PIPELINE > 0
+  // the debug modes 4, 5 and 6 report the velocities between the steps, so they take the single steps
+  const bool fused = (debug != 4 && debug != 5 && debug != 6);
+#else
+  const bool fused = false;
 #endif
-  // Report back 0-1023 raw ADC 10-bit values if enabled
-  if (debug == 1) debugOutput1(rawReads, keyVals);
-
-  if (debug == 11 || doOnce) {
-    // calibrate the joystick
-    // As this is called in the debug=11, we do more iterations.
-    busyZeroing(centerPoints, 3000, true);
-    debug = -1;  // this only done once
-    doOnce = false;
-  }
-
-  // Subtract centre position from measured position to determine movement.
-  for (int i = 0; i < 8; i++) {
-    centered[i] = rawReads[i] - centerPoints[i];
-  }
-
-  if (debug == 12) calcMinMax(centered);  // debug=12 to calibrate MinMax values
-
-  // Report centered joystick values if enabled. Values should be approx -500 to +500, jitter around 0 at idle
-  if (debug == 2) debugOutput2(centered, keyVals);
-
+  PROFILE_BEGIN(PROF_FILTER);
+#if FUSED_PIPELINE > 0
+  // all steps from the deadzone to the exclusive mode in one sweep, centered gets the mapped values
+  if (fused) Pipeline::run(centered, keyVals, velocity);
+#endif
+#if FIXED_PIPELINE > 0
+  // the mapped values are kept in Q16.16 for the kinematics, centered gets the rounded values
+  static int32_t mappedQ16[8];
+  if (!fused) fixedPipeline.filter(centered, mappedQ16);
+#else
   FilterAnalogReadOuts(centered);
+#endif
+  PROFILE_END(PROF_FILTER);
+  TELEMETRY_TAP(TAP_DEADZONED, centered, 8);
 
-  // Report centered joystick values. Filtered for deadzone. Approx -350 to +350, locked to zero at idle
+  // Report centered joystick values. Filtered for deadzone. Approx -TOTALSENSITIVITY to +TOTALSENSITIVITY, locked to zero at idle
   if (debug == 3) debugOutput2(centered, keyVals);
 
-  calculateKinematic(centered, velocity);
+#if KINEMATIC_MATRIX > 0
+  // debug=16 to fit the decoupling matrix, the loop keeps on running meanwhile
+  if (debug == 16 && kinematicCalibration(centered)) debug = -1;
+#endif
+
+  if (!fused) {
+    PROFILE_BEGIN(PROF_KINEMATICS);
+#if FIXED_PIPELINE > 0
+    fixedPipeline.kinematic(mappedQ16, velocity);
+#else
+    calculateKinematic(centered, velocity);
+#endif
+    PROFILE_END(PROF_KINEMATICS);
+  }
+  TELEMETRY_TAP(TAP_VELOCITY, velocity, 6);
 
 #if NUMKEYS > 0
+  PROFILE_BEGIN(PROF_KEYS);
   evalKeys(keyVals, keyOut, keyState, debug);
+  PROFILE_END(PROF_KEYS);
 #endif
 
   // Report translation and rotation values if enabled.
@@ -124,52 +178,593 @@ void loop() {
 #if (NUMKILLKEYS == 2)
   // check for the raw keyVal and not keyOut, because keyOut is only 1 for a single iteration. keyVals has inverse Logic due to pull-ups
   // kill rotation
-  if (keyVals[KILLROT] == LOW) {
+  if (!fused && keyVals[KILLROT] == LOW) {
     velocity[ROTX] = 0;
     velocity[ROTY] = 0;
     velocity[ROTZ] = 0;
   }
   // kill translation
-  if (keyVals[KILLTRANS] == LOW) {
+  if (!fused && keyVals[KILLTRANS] == LOW) {
     velocity[TRANSX] = 0;
     velocity[TRANSY] = 0;
     velocity[TRANSZ] = 0;
   }
 #endif
+  TELEMETRY_TAP(TAP_KILLED, velocity, 6);
 
   // report velocity and keys after possible kill-key feature
   if (debug == 6) debugOutput4(velocity, keyOut);
 
+  if (!fused) {
 #if SWITCHYZ > 0
-  switchYZ(velocity);
+    switchYZ(velocity);
 #endif
 
 #ifdef EXCLUSIVEMODE
-  // exclusive mode
-  // rotation OR translation, but never both at the same time
-  // to avoid issues with classics joysticks
-  exclusiveMode(velocity);
+    // exclusive mode
+    // rotation OR translation, but never both at the same time
+    // to avoid issues with classics joysticks
+    exclusiveMode(velocity);
 #endif
+  }
+
+#if ONE_EURO > 0
+  // adaptive smoothing of the final velocities, a zero passes through without delay
+  PROFILE_BEGIN(PROF_SMOOTHING);
+  velocitySmoother.apply(velocity, frameTimeUs);
+  PROFILE_END(PROF_SMOOTHING);
+#endif
+  TELEMETRY_TAP(TAP_EXCLUSIVE, velocity, 6);
 
   // report velocity and keys after Switch or ExclusiveMode
   if (debug == 61) debugOutput4(velocity, keyOut);
+}
+
+#if TRACE_REPLAY > 0
+/// @brief Replay the trace buffer through the same processing as the loop(), but with the time of the trace and with the HID
+/// reports going into the report log. The state of the processing is reset before and restored afterwards, so the same trace
+/// gives the same reports every time. The calibration values (min/max, sensitivities, matrix, ...) are used as they are.
+/// @param out stream for the report log, or nullptr to report only the CRC-32 and the speed of the replay
+/// @param meter gets the velocities of every frame, if not nullptr
+/// @return false, if there is no trace to replay
+bool replayTrace(Stream* out, ResponseMeter* meter = nullptr) {
+  if (traceBuffer.count == 0 || traceBuffer.resolution != SENSOR_RESOLUTION) {
+    SERIAL.println(F("No trace for this sensor resolution, record (32) or upload (33) one first."));
+    return false;
+  }
+  static AdcEngine traceAdc;  // gets the frames of the trace instead of the sensors
+  traceBuffer.stopRecording();  // don't record the replay itself
+
+  // save the state of the loop() and start from the defaults
+  KalmanBank savedKalman = kalmanBank;
+  int savedCenterPoints[8], savedDeadzones[8];
+  memcpy(savedCenterPoints, centerPoints, sizeof(savedCenterPoints));
+  memcpy(savedDeadzones, deadzones, sizeof(savedDeadzones));
+  int savedDebug = debug;
+  debug = -1;  // no debug outputs during the replay
+#if TELEMETRY > 0
+  uint8_t savedTelemetry = telemetryMask;
+  telemetryMask = 0;  // and no telemetry
+#endif
+  setupkalmanFilters();
+  for (int i = 0; i < 8; i++) {
+    centerPoints[i] = traceBuffer.centers[i];
+    deadzones[i] = DEADZONE * SENSOR_SCALE;
+  }
+  // the keys as well, the debounce timestamps are in the time of the trace during the replay
+  uint8_t savedKeyState[sizeof(keyState)], savedKeyOut[sizeof(keyOut)];
+  memcpy(savedKeyState, keyState, sizeof(keyState));
+  memcpy(savedKeyOut, keyOut, sizeof(keyOut));
+  memset(keyState, 0, sizeof(keyState));
+  memset(keyOut, 0, sizeof(keyOut));
+#if NUMKEYS > 0
+  unsigned long savedTimestamp[NUMKEYS];
+  memcpy(savedTimestamp, timestamp, sizeof(timestamp));
+#endif
+  resetUSBData();
+#if ONE_EURO > 0
+  velocitySmoother.reset();
+#endif
+
+  reportLog.begin(out);
+  reportSink = traceReportSink;
+  clockVirtual = true;
+  unsigned long start = micros();
+  for (uint16_t n = 0; n < traceBuffer.count; n++) {
+    const TraceFrame& frame = traceBuffer.frames[n];
+    clockVirtualUs = frame.timeUs;
+    frameTimeUs = frame.timeUs;
+    traceAdc.pushFrame(frame.adc, frame.timeUs);
+    readAllFromSensors(rawReads, traceAdc);
+    for (int i = 0; i < NUMKEYS; i++) {
+      keyVals[i] = (i < 8) ? ((frame.keys >> i) & 1) : HIGH;  // only the first 8 keys are recorded
+    }
+    for (int i = 0; i < 8; i++) {
+      centered[i] = rawReads[i] - centerPoints[i];
+    }
+    processCentered();
+    if (meter) meter->add(velocity, frame.timeUs);
+
+    // the loop() runs faster than the frames arrive: send the reports for every loop() until the next frame
+    uint32_t next = (n + 1 < traceBuffer.count) ? traceBuffer.frames[n + 1].timeUs : frame.timeUs + TRACE_LOOP_PERIOD_US;
+    uint32_t loops = 0;
+    do {
+      sendUSBData(velocity[ROTX], velocity[ROTY], velocity[ROTZ],
+                  velocity[TRANSX], velocity[TRANSY], velocity[TRANSZ],
+                  keyState, debug);
+      clockVirtualUs += TRACE_LOOP_PERIOD_US;
+    } while ((int32_t)(next - clockVirtualUs) > 0 && ++loops < 1000);  // limit gaps in the trace to 1000 loops
+  }
+  unsigned long elapsed = micros() - start;
+  uint32_t crc = reportLog.end();
+
+  // back to the state of the loop()
+  clockVirtual = false;
+  reportSink = nullptr;
+  resetUSBData();
+#if ONE_EURO > 0
+  velocitySmoother.reset();
+#endif
+  kalmanBank = savedKalman;
+  memcpy(centerPoints, savedCenterPoints, sizeof(savedCenterPoints));
+  memcpy(deadzones, savedDeadzones, sizeof(savedDeadzones));
+  memcpy(keyState, savedKeyState, sizeof(keyState));
+  memcpy(keyOut, savedKeyOut, sizeof(keyOut));
+#if NUMKEYS > 0
+  memcpy(timestamp, savedTimestamp, sizeof(timestamp));
+#endif
+  debug = savedDebug;
+#if TELEMETRY > 0
+  telemetryMask = savedTelemetry;
+#endif
+
+  if (out == nullptr && meter == nullptr) {
+    SERIAL.printf("Replay: %u frames, %lu reports, CRC-32 0x%08lx, %lu us = %lu frames/s\n", (unsigned)traceBuffer.count,
+                  (unsigned long)reportLog.reports, (unsigned long)crc, elapsed,
+                  (unsigned long)((uint64_t)traceBuffer.count * 1000000 / (elapsed ? elapsed : 1)));
+  }
+  return true;
+}
 
+#if ONE_EURO > 0
+/// @brief Replay the trace with and without the velocity smoothing and report the step response latency and jitter (debug mode 37)
+void compareSmoothing() {
+  static ResponseMeter meter;  // too large for the stack
+  const char* names[2] = { "Kalman only", "Kalman + one-euro" };
+  for (int variant = 0; variant < 2; variant++) {
+    velocitySmoother.enabled = (variant == 1);
+    meter.begin();
+    if (!replayTrace(nullptr, &meter)) break;
+    SERIAL.printf("%-18s trans: latency %6.1f ms, jitter %5.2f, peak %3d   rot: latency %6.1f ms, jitter %5.2f, peak %3d\n",
+                  names[variant], meter.latencyMs(0), meter.jitter(0), meter.peak[0], meter.latencyMs(1), meter.jitter(1), meter.peak[1]);
+  }
+  velocitySmoother.enabled = true;
+}
+#endif
+#endif
+
+// parameters, which can be read and changed with the get and set commands
+struct CommandParam {
+  const char* name;
+  char type;  // 'f': float, 'i': int, 'u': uint8_t
+  void* value;
+  float min;
+  float max;
+};
+
+const CommandParam commandParams[] = {
+  { "sens_transx", 'f', &sensitivities[SENS_TRANSX], SENSITIVITY_MIN, SENSITIVITY_MAX },
+  { "sens_transy", 'f', &sensitivities[SENS_TRANSY], SENSITIVITY_MIN, SENSITIVITY_MAX },
+  { "sens_pos_transz", 'f', &sensitivities[SENS_POS_TRANSZ], SENSITIVITY_MIN, SENSITIVITY_MAX },
+  { "sens_neg_transz", 'f', &sensitivities[SENS_NEG_TRANSZ], SENSITIVITY_MIN, SENSITIVITY_MAX },
+  { "sens_rotx", 'f', &sensitivities[SENS_ROTX], SENSITIVITY_MIN, SENSITIVITY_MAX },
+  { "sens_roty", 'f', &sensitivities[SENS_ROTY], SENSITIVITY_MIN, SENSITIVITY_MAX },
+  { "sens_rotz", 'f', &sensitivities[SENS_ROTZ], SENSITIVITY_MIN, SENSITIVITY_MAX },
+  { "gate_neg_transz", 'i', &gates[GATEIDX_NEG_TRANSZ], 0, GATE_MAX },
+  { "gate_rotx", 'i', &gates[GATEIDX_ROTX], 0, GATE_MAX },
+  { "gate_roty", 'i', &gates[GATEIDX_ROTY], 0, GATE_MAX },
+  { "gate_rotz", 'i', &gates[GATEIDX_ROTZ], 0, GATE_MAX },
+  { "modfunc", 'u', &modFunc, 0, NUM_MODIFIER_CURVES - 1 },
+  { "debug", 'i', &debug, -1, 2000 },
+};
+
+CommandParser commandParser;
+
+/// @brief Send the answer to a request in one line
+/// @param ok true: "ok", false: "err"
+/// @param text key=value pairs or the reason of the error, may be empty
+void replyCommand(const Command& cmd, bool ok, const char* text) {
+  if (cmd.id >= 0) SERIAL.printf("#%ld ", (long)cmd.id);
+  SERIAL.printf("%s%s%s\n", ok ? "ok" : "err", *text ? " " : "", text);
+}
+
+/// @brief Print the value of a parameter as key=value
+void formatParam(const CommandParam& param, char* text, size_t size) {
+  if (param.type == 'f') {
+    snprintf(text, size, "%s=%g", param.name, *(float*)param.value);
+  } else if (param.type == 'i') {
+    snprintf(text, size, "%s=%d", param.name, *(int*)param.value);
+  } else {
+    snprintf(text, size, "%s=%u", param.name, *(uint8_t*)param.value);
+  }
+}
+
+/// @brief Execute a command from the serial interface
+void handleCommand(const Command& cmd) {
+  char text[768];  // the "stats" reply with all counters
+  if (cmd.plainNumber) {
+    // compatible to the former parseInt(): a number selects the debug mode
+    debug = cmd.number;
+    if (debug == -1) {
+      SERIAL.println(F("Please enter the debug mode now or while the script is reporting."));
+    }
+    return;
+  }
+  long number;
+  if (strcmp(cmd.name, "debug") == 0) {
+    if (cmd.argc != 1 || !parseNumber(cmd.args[0], number)) return replyCommand(cmd, false, "usage: debug <mode>");
+    debug = number;
+    snprintf(text, sizeof(text), "debug=%d", debug);
+    replyCommand(cmd, true, text);
+  } else if (strcmp(cmd.name, "zero") == 0) {
+    debug = 11;  // the zeroing is done by the loop()
+    replyCommand(cmd, true, "");
+  } else if (strcmp(cmd.name, "stats") == 0) {
+    int n = snprintf(text, sizeof(text), "debug=%d uptime_ms=%lu overflows=%lu", debug, millis(), (unsigned long)commandParser.overflows);
+#if SAMPLING_TASK > 0
+    n += snprintf(text + n, sizeof(text) - n, " frames=%lu skipped=%lu overruns=%lu", (unsigned long)adcEngine.framesFetched,
+                  (unsigned long)adcEngine.framesSkipped, (unsigned long)sensorQueue.overruns());
+#endif
+#if TELEMETRY > 0
+    n += snprintf(text + n, sizeof(text) - n, " telemetry=%lu dropped=%lu", (unsigned long)telemetry.frames, (unsigned long)telemetry.dropped);
+#endif
+#if HID_SCHEDULER > 0
+    n += snprintf(text + n, sizeof(text) - n, " hid_sent=%lu hid_coalesced=%lu hid_dropped=%lu hid_stale=%lu hid_latency_us=%lu/%lu",
+                  (unsigned long)hidScheduler.sent, (unsigned long)hidScheduler.coalesced, (unsigned long)hidScheduler.dropped,
+                  (unsigned long)hidScheduler.stale,
+                  (unsigned long)hidScheduler.latencyMeanUs(), (unsigned long)hidScheduler.latencyMaxUs);
+#endif
+#if HID_TRANSPORT == HID_TRANSPORT_BLE
+    n += snprintf(text + n, sizeof(text) - n, " ble_interval_us=%lu ble_rate=%lu ble_notifications=%lu ble_dropped=%lu",
+                  (unsigned long)bleHidTransport.policy.intervalUs(), (unsigned long)bleHidTransport.batcher.rateHz,
+                  (unsigned long)bleHidTransport.batcher.notifications, (unsigned long)bleHidTransport.batcher.dropped);
+#endif
+#if SCREEN_DIRTY_RENDER > 0
+    n += snprintf(text + n, sizeof(text) - n, " screen_bps=%lu", (unsigned long)screenStats.bytesPerSec);
+#endif
+#if POWER_GOVERNOR > 0
+    n += snprintf(text + n, sizeof(text) - n, " power=%s wakes=%lu wake_us=%lu/%lu", powerGovernor.stateName(),
+                  (unsigned long)powerGovernor.wakes, (unsigned long)powerGovernor.lastWakeUs, (unsigned long)powerGovernor.maxWakeUs);
+#endif
+#if HID_COALESCE > 0
+    n += snprintf(text + n, sizeof(text) - n, " hid_candidates=%lu hid_suppressed=%lu suppression=%.1f%%",
+                  (unsigned long)reportCoalescer.candidates, (unsigned long)reportCoalescer.suppressed, reportCoalescer.suppressionRatio());
+#endif
+    replyCommand(cmd, true, text);
+#if TELEMETRY > 0
+  } else if (strcmp(cmd.name, "telemetry") == 0) {
+    if (cmd.argc != 1 || !parseNumber(cmd.args[0], number) || number < 0 || number >= (1 << NUM_TAPS)) {
+      return replyCommand(cmd, false, "usage: telemetry <mask>");
+    }
+    // the answer comes before the first frame or after the last one
+    snprintf(text, sizeof(text), "telemetry=%ld", number);
+    if (number != 0) {
+      replyCommand(cmd, true, text);
+      debug = -1;  // no text outputs of the debug modes within the stream
+    }
+    telemetry.subscribe(number);
+    if (number == 0) replyCommand(cmd, true, text);
+#endif
+  } else if (strcmp(cmd.name, "get") == 0 || strcmp(cmd.name, "set") == 0) {
+    bool set = cmd.name[0] == 's';
+    if (cmd.argc != (set ? 2 : 1)) return replyCommand(cmd, false, set ? "usage: set <parameter> <value>" : "usage: get <parameter>");
+    for (const CommandParam& param : commandParams) {
+      if (strcmp(cmd.args[0], param.name) != 0) continue;
+      if (set) {
+        char* end;
+        float value = strtof(cmd.args[1], &end);
+        if (*end != '\0' || end == cmd.args[1]) return replyCommand(cmd, false, "invalid value");
+        if (value < param.min || value > param.max) return replyCommand(cmd, false, "value out of range");
+        if (param.type == 'f') {
+          *(float*)param.value = value;
+        } else if (value != (long)value) {
+          return replyCommand(cmd, false, "integer expected");
+        } else if (param.type == 'i') {
+          *(int*)param.value = value;
+        } else {
+          *(uint8_t*)param.value = value;
+        }
+      }
+      formatParam(param, text, sizeof(text));
+      return replyCommand(cmd, true, text);
+    }
+    replyCommand(cmd, false, "unknown parameter");
+  } else {
+    replyCommand(cmd, false, "unknown command");
+  }
+}
+
+/// @brief Take the available bytes from the serial interface and execute a completed line. Never waits for more bytes.
+void pollSerialCommands() {
+  bool complete = false;
+  // stop after a complete line, so the binary data of an upload stays in the buffer for the following debug mode
+  while (!complete && SERIAL.available()) {
+    complete = commandParser.feed(SERIAL.read(), millis());
+  }
+  if (!complete) complete = commandParser.idle(millis());
+  if (!complete) return;
+  char* line = commandParser.line();
+  if (line[strspn(line, " \t")] == '\0') return;  // ignore blank lines
+  Command cmd;
+  bool valid = parseCommand(line, cmd);
+#if TELEMETRY > 0
+  // while the telemetry is streaming, only the telemetry command is taken, so no text gets into the binary frames
+  if (telemetryMask != 0 && !(valid && !cmd.plainNumber && strcmp(cmd.name, "telemetry") == 0)) return;
+#endif
+  if (valid) {
+    handleCommand(cmd);
+  } else {
+    replyCommand(cmd, false, "malformed request");
+  }
+}
+
+#if POWER_GOVERNOR > 0
+/// @brief Apply the sampling period, CPU frequency, display and LED settings of the power governor
+void applyPowerProfile(const PowerProfile& profile) {
+#if SAMPLING_TASK > 0
+  if (samplingTimer) timerAlarm(samplingTimer, profile.samplePeriodUs, true, 0);
+#endif
+  adcEngine.partialFrames.store(profile.partialFrames, std::memory_order_relaxed);
+  setCpuFrequencyMhz(profile.cpuMHz);
+  screenRefreshDelay = profile.screenDelayMs;
+  u8g2.setPowerSave(!profile.displayOn);
+#ifdef LEDpin
+  setLEDbrightness(profile.ledBrightness);
+#endif
+}
+
+/// @brief Let the power governor check the motion of this loop() and apply the profile of a new state
+void updatePowerGovernor() {
+  bool motion = debug > 0;  // the debug modes keep the device active
+#if TELEMETRY > 0
+  motion |= telemetryMask != 0;
+#endif
+  for (int i = 0; i < 6; i++) motion |= abs(velocity[i]) >= POWER_WAKE_THRESHOLD;
+  for (int i = 0; i < NUMKEYS; i++) motion |= keyState[i] != 0;
+  if (powerGovernor.update(micros(), frameFirstScanUs, motion, usbSuspended)) {
+    applyPowerProfile(powerGovernor.profile());
+    if (debug == 7) SERIAL.printf("Power: %s\n", powerGovernor.stateName());
+  }
+}
+#endif
+
+void loop() {
+  PROFILE_BEGIN(PROF_LOOP);
+  // check if the user entered a debug mode or a command via serial interface, without waiting for the rest of the line
+  pollSerialCommands();
+
+  // Joystick values are taken from the newest frame of the ADC. 0-SENSOR_MAX
+  PROFILE_BEGIN(PROF_SENSORS);
+#if SAMPLING_TASK > 0
+  // the sensors are read, filtered and centered by the sampling task, see samplingTask.h
+  updateSamplingCenterPoints();  // e.g. moved by the auto zero or the calibration store
+  static SensorFrame sensorFrame = {};
+  bool newSensorFrame = getNewestSensorFrame(sensorFrame);
+  memcpy(rawReads, sensorFrame.rawReads, sizeof(rawReads));
+  frameTimeUs = sensorFrame.timestampUs;
+  frameFirstScanUs = sensorFrame.firstScanUs;
+#else
+  if (readAllFromSensors(rawReads)) {
+    frameTimeUs = micros();
+    frameFirstScanUs = sensorFirstScanUs;
+  }
+#endif
+
+#if NUMKEYS > 0
+  // LivingTheDream added reading of key presses
+  readAllFromKeys(keyVals);
+#endif
+  PROFILE_END(PROF_SENSORS);
+#if LATENCY_PROBE > 0
+  latencyProbe.loopStart(frameTimeUs);
+#endif
+  TELEMETRY_TAP(TAP_RAW, rawReads, 8);
+  // Report back 0-1023 raw ADC 10-bit values if enabled
+  if (debug == 1) debugOutput1(rawReads, keyVals);
+
+  if (debug == 11 || doOnce) {
+    // calibrate the joystick
+    // As this is called in the debug=11, we average for a longer time.
+#if SAMPLING_TASK > 0
+    pauseSamplingTask();
+#endif
+    busyZeroing(centerPoints, 3000, true);
+#if SAMPLING_TASK > 0
+    resumeSamplingTask();
+#endif
+#if CALIBSTORE > 0
+    // store the new center points, if the zeroing was requested by the user
+    if (debug == 11 && saveCalibration()) {
+      SERIAL.println(F("Center points saved in the calibration store."));
+    }
+#endif
+    debug = -1;  // this only done once
+    doOnce = false;
+  }
+
+#if CALIBSTORE > 0
+  if (debug == 40) {
+    exportCalibration();
+    debug = -1;
+  }
+  if (debug == 41) {
+    importCalibration();
+    debug = -1;
+  }
+  if (debug == 42) {
+    eraseCalibration();
+    SERIAL.println(F("Calibration store erased, config.h is used after the next reset."));
+    debug = -1;
+  }
+#endif
+
+  if (debug == 13) {
+    // run the benchmarks once and report the results
+#if SAMPLING_TASK > 0
+    pauseSamplingTask();  // don't disturb the measurement
+#endif
+    runBenchmarks();
+#if SAMPLING_TASK > 0
+    resumeSamplingTask();
+#endif
+    debug = -1;
+  }
+
+#if FLIGHTRECORDER > 0
+  if (debug == 30) {
+    // freeze the flight recorder and send its content as binary blob
+    dumpFlightRecorder(centerPoints);
+    debug = -1;
+  }
+  if (debug == 31) {
+    flightRecorder.rearm();
+    SERIAL.println(F("Flight recorder rearmed."));
+    debug = -1;
+  }
+#endif
+
+#if TRACE_REPLAY > 0
+  if (debug == 32) {
+    // the frames are captured by readAllFromSensors(), the keys are added here
+    traceBuffer.startRecording(centerPoints);
+    SERIAL.printf("Recording a trace of %d frames...\n", TRACE_MAX_FRAMES);
+    debug = -1;
+  }
+  static bool traceRecording = false;
+  if (traceBuffer.isRecording()) {
+    uint8_t keys = 0;
+    for (int i = 0; i < NUMKEYS && i < 8; i++) {
+      if (keyVals[i]) keys |= 1 << i;
+    }
+    traceBuffer.keys = keys;
+    traceRecording = true;
+  } else if (traceRecording) {
+    SERIAL.printf("Trace with %u frames recorded.\n", (unsigned)traceBuffer.count);
+    traceRecording = false;
+  }
+  if (debug == 33) {
+    uploadTrace();
+    debug = -1;
+  }
+  if (debug == 34 || debug == 35) {
+    // replay the trace without disturbance by the sampling task
+#if SAMPLING_TASK > 0
+    pauseSamplingTask();
+#endif
+    replayTrace(debug == 35 ? &SERIAL : nullptr);
+#if SAMPLING_TASK > 0
+    resumeSamplingTask();
+#endif
+    debug = -1;
+  }
+  if (debug == 36) {
+    downloadTrace();
+    debug = -1;
+  }
+#if ONE_EURO > 0
+  if (debug == 37) {
+#if SAMPLING_TASK > 0
+    pauseSamplingTask();
+#endif
+    compareSmoothing();
+#if SAMPLING_TASK > 0
+    resumeSamplingTask();
+#endif
+    debug = -1;
+  }
+#endif
+#endif
+
+  // Subtract centre position from measured position to determine movement.
+  PROFILE_BEGIN(PROF_CENTERING);
+#if SAMPLING_TASK > 0
+  memcpy(centered, sensorFrame.centered, sizeof(centered));  // already done by the sampling task
+#else
+  for (int i = 0; i < 8; i++) {
+    centered[i] = rawReads[i] - centerPoints[i];
+  }
+#endif
+  PROFILE_END(PROF_CENTERING);
+  TELEMETRY_TAP(TAP_CENTERED, centered, 8);
+
+  if (debug == 12) calcMinMax(centered);  // debug=12 to calibrate MinMax values
+
+  // Report centered joystick values if enabled. Values should be approx -500 to +500 (times SENSOR_SCALE), jitter around 0 at idle
+  if (debug == 2) debugOutput2(centered, keyVals);
+
+#if AUTOZERO > 0
+  // follow the drift of the center points and adapt the deadzones while the knob is idle
+#if SAMPLING_TASK > 0
+  if (newSensorFrame) idleTracker.update(millis(), rawReads, centered, centerPoints, deadzones);
+#else
+  idleTracker.update(millis(), rawReads, centered, centerPoints, deadzones);
+#endif
+  if (debug == 15) debugOutputAutoZero(centerPoints, deadzones);
+#endif
+
+  processCentered();
+
+#if FLIGHTRECORDER > 0
+  // record the sample in the flight recorder, it freezes on a trigger
+#if SAMPLING_TASK > 0
+  if (newSensorFrame) flightRecorder.record(sensorFrame.timestampUs, rawReads, centered, velocity, keyState);
+#else
+  flightRecorder.record(micros(), rawReads, centered, velocity, keyState);
+#endif
+#endif
+
+  PROFILE_BEGIN(PROF_DISPLAY);
   displayScreen(-velocity[ROTX], -velocity[ROTY], velocity[ROTZ],
                 velocity[TRANSX], -velocity[TRANSY], -velocity[TRANSZ],
                 keyState);
+  PROFILE_END(PROF_DISPLAY);
 
   // update and report the at what frequency the loop is running
   if (debug == 7) updateFrequencyReport();
 
 
   // get the values to the USB HID driver to send if necessary
+  PROFILE_BEGIN(PROF_USB);
   if (CheckKey3(keyState[2], debug)) sendUSBData(velocity[ROTX], velocity[ROTY], velocity[ROTZ],
                                                  velocity[TRANSX], velocity[TRANSY], velocity[TRANSZ],
                                                  keyState, debug);
+#if HID_TRANSPORT == HID_TRANSPORT_BLE && HID_SCHEDULER == 0
+  bleHidTransport.service(micros());  // notify the collected reports once per connection event, else by the hidSchedulerTask()
+#endif
+  PROFILE_END(PROF_USB);
 
+  PROFILE_BEGIN(PROF_BATTERY);
   SpaceMouseHID.sendBattery(42, false);
+  PROFILE_END(PROF_BATTERY);
 
 #ifdef LEDpin
+  PROFILE_BEGIN(PROF_LED);
   updateLEDsBasedOnMotion(velocity, SpaceMouseHID.getLed());
+  PROFILE_END(PROF_LED);
+#endif
+  PROFILE_END(PROF_LOOP);
+
+#if PROFILER > 0
+  if (debug == 14) {
+    // report the cycles of all stages since the last report, outside of the measurement
+    profiler.report();
+    debug = -1;
+  }
+#endif
+
+#if POWER_GOVERNOR > 0
+  updatePowerGovernor();
+  // let the CPU sleep until the next scan, while the device is idle
+  if (powerGovernor.profile().loopDelayMs) delay(powerGovernor.profile().loopDelayMs);
 #endif
 }  // end loop()
@@ -0,0 +1,278 @@
+// This file contains the acquisition engine for the hall effect sensors.
+// The ADC scans all channels in the background at a fixed rate and publishes complete frames into a double buffered ring.
+// The loop() only picks up the newest complete frame and is no longer responsible for the timing of the conversions.
+
+#ifndef ADCENGINE_H
+#define ADCENGINE_H
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#define ADC_CHANNELS 8
+
+/// @brief One complete scan over all channels of the PINLIST
+struct AdcFrame {
+  uint32_t seq;                    // running number of the frame, starts with 1 for the first frame
+  uint32_t timestampUs;            // time in micros(), when the frame was completed
+  uint32_t firstScanUs;            // time in micros() of the first scan, which went into the frame
+  uint16_t values[ADC_CHANNELS];  // oversampled ADC values (SENSOR_RESOLUTION bits) in the order of the PINLIST
+};
+
+/// @brief Double buffered frame ring for exactly one producer and one consumer.
+/// The producer always writes into the slot, which is not published as the newest one.
+/// Each slot is guarded by a sequence counter (odd while writing), so the consumer never sees a torn frame,
+/// even if the producer wraps around while the consumer is copying.
+class AdcFrameRing {
+public:
+  /// @brief Publish a complete frame. Must only be called by the single producer.
+  /// @param values pointer to ADC_CHANNELS raw values
+  /// @param timestampUs time of the completion of the scan
+  /// @param firstScanUs time of the first scan of the frame
+  void publish(const uint16_t* values, uint32_t timestampUs, uint32_t firstScanUs) {
+    uint8_t back = newest.load(std::memory_order_relaxed) ^ 1;
+    Slot& slot = slots[back];
+    uint32_t s = slot.guard.load(std::memory_order_relaxed);
+    slot.guard.store(s + 1, std::memory_order_relaxed);  // odd: slot is being written
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.frame.seq = ++published;
+    slot.frame.timestampUs = timestampUs;
+    slot.frame.firstScanUs = firstScanUs;
+    memcpy(slot.frame.values, values, sizeof(slot.frame.values));
+    slot.guard.store(s + 2, std::memory_order_release);  // even: slot is complete
+    newest.store(back, std::memory_order_release);
+  }
+
+  /// @brief Copy the newest complete frame.
+  /// @param frame destination
+  /// @return false, if no frame has been published so far
+  bool read(AdcFrame& frame) const {
+    while (true) {
+      const Slot& slot = slots[newest.load(std::memory_order_acquire)];
+      uint32_t s1 = slot.guard.load(std::memory_order_acquire);
+      if (s1 == 0) return false;  // nothing published yet
+      if (s1 & 1) continue;       // producer is just writing into this slot
+      frame = slot.frame;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.guard.load(std::memory_order_relaxed) == s1) return true;
+    }
+  }
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> guard{ 0 };
+    AdcFrame frame;
+  };
+  Slot slots[2];
+  std::atomic<uint8_t> newest{ 0 };
+  uint32_t published = 0;  // only touched by the producer
+};
+
+/// @brief Boxcar oversampling and decimation stage.
+/// OVERSAMPLING_RATIO = 4^OVERSAMPLING_BITS scans are summed up per channel and the sum is shifted right by OVERSAMPLING_BITS.
+/// The noise of the ADC works as dither, so every factor of four gains one bit of effective resolution.
+class Oversampler {
+public:
+  /// @brief Add one scan
+  /// @param in pointer to ADC_CHANNELS raw values with analogRead_Resolution bits
+  /// @param out pointer to ADC_CHANNELS decimated values with SENSOR_RESOLUTION bits, only written when a frame is complete
+  /// @return true, if OVERSAMPLING_RATIO scans have been accumulated and out has been written
+  bool add(const uint16_t* in, uint16_t* out) {
+    accumulate(in);
+    if (count < OVERSAMPLING_RATIO) return false;
+    for (int i = 0; i < ADC_CHANNELS; i++) {
+      out[i] = sum[i] >> OVERSAMPLING_BITS;
+      sum[i] = 0;
+    }
+    count = 0;
+    return true;
+  }
+
+  /// @brief Add one scan without decimation, the scans are decimated by flush()
+  void accumulate(const uint16_t* in) {
+    for (int i = 0; i < ADC_CHANNELS; i++) {
+      sum[i] += in[i];
+    }
+    count++;
+  }
+
+  /// @brief Decimate the scans, which have been accumulated so far, even if they are less than OVERSAMPLING_RATIO
+  /// @param out pointer to ADC_CHANNELS values with SENSOR_RESOLUTION bits, only written when there was a scan
+  /// @return false, if no scan has been accumulated since the last frame
+  bool flush(uint16_t* out) {
+    if (count == 0) return false;
+    for (int i = 0; i < ADC_CHANNELS; i++) {
+      out[i] = (sum[i] << OVERSAMPLING_BITS) / count;
+      sum[i] = 0;
+    }
+    count = 0;
+    return true;
+  }
+
+  /// @brief number of scans accumulated for the next frame
+  uint16_t pending() const {
+    return count;
+  }
+
+private:
+  uint32_t sum[ADC_CHANNELS] = {};
+  uint16_t count = 0;
+};
+
+/// @brief Interface of the acquisition engine.
+/// A backend (or a host build with synthetic data) feeds complete scans via pushScan(), the consumer calls latest().
+/// The scans are oversampled and decimated, before they are published as a frame.
+class AdcEngine {
+public:
+  virtual ~AdcEngine() {}
+
+  /// @brief Start the background conversions.
+  /// @return false, if the engine can't run with the given pins
+  virtual bool begin(const int* pins) {
+    (void)pins;
+    return true;
+  }
+
+  /// @brief Give the backend the chance to move finished conversions into the ring. Called by the consumer.
+  virtual void service() {}
+
+  /// @brief Feed one complete scan into the oversampler. Called by the backend or by a host build with synthetic frames.
+  /// Every OVERSAMPLING_RATIO scans a new frame is published into the ring, with partialFrames only by flushScans().
+  void pushScan(const uint16_t* values, uint32_t timestampUs) {
+    uint16_t decimated[ADC_CHANNELS];
+    if (oversampler.pending() == 0) firstScanUs = timestampUs;
+    newestScanUs = timestampUs;
+    if (partialFrames.load(std::memory_order_relaxed)) {
+      oversampler.accumulate(values);  // all scans of this fetch go into one frame, see flushScans()
+      return;
+    }
+    if (oversampler.add(values, decimated)) {
+      ring.publish(decimated, timestampUs, firstScanUs);
+    }
+  }
+
+  /// @brief Publish the scans, which are waiting in the oversampler, as a frame without waiting for OVERSAMPLING_RATIO scans.
+  /// Used while the power governor has slowed down the fetches: the ADC driver only buffers a few scans between two
+  /// fetches, so a complete frame would take several fetches and the first motion would be seen that much later.
+  /// @return true, if a frame was published
+  bool flushScans() {
+    uint16_t decimated[ADC_CHANNELS];
+    if (!oversampler.flush(decimated)) return false;
+    ring.publish(decimated, newestScanUs, firstScanUs);
+    return true;
+  }
+
+  /// @brief Publish an already decimated frame without the oversampler, e.g. from a recorded trace, see traceReplay.h
+  /// @param values pointer to ADC_CHANNELS values with SENSOR_RESOLUTION bits
+  void pushFrame(const uint16_t* values, uint32_t timestampUs) {
+    ring.publish(values, timestampUs, timestampUs);
+  }
+
+  /// @brief Fetch the newest complete frame.
+  /// @param frame destination, it is left unchanged if no frame was published so far
+  /// @return true, if this frame has not been fetched before
+  bool latest(AdcFrame& frame) {
+    if (!ring.read(frame)) return false;
+    if (frame.seq == lastSeq) return false;
+    if (lastSeq != 0 && frame.seq - lastSeq > 1) {
+      framesSkipped += frame.seq - lastSeq - 1;  // frames, which were overwritten before the consumer came by
+    }
+    lastSeq = frame.seq;
+    framesFetched++;
+    return true;
+  }
+
+  uint32_t framesFetched = 0;  // number of new frames the consumer got
+  uint32_t framesSkipped = 0;  // number of frames the consumer never saw, because a newer one was available
+  // Set by the power governor: publish a frame of the waiting scans on every fetch by readAllFromSensors(), see flushScans()
+  std::atomic<bool> partialFrames{ false };
+
+protected:
+  Oversampler oversampler;
+  AdcFrameRing ring;
+  uint32_t lastSeq = 0;
+  uint32_t firstScanUs = 0;   // time of the first scan in the oversampler
+  uint32_t newestScanUs = 0;  // time of the newest scan in the oversampler
+};
+
+#ifdef ARDUINO
+// Counted up by the ISR of the continuous ADC driver for every finished scan, which waits in the buffer of the driver
+std::atomic<uint32_t> adcScansReady{ 0 };
+
+void ARDUINO_ISR_ATTR onAdcConversionDone() {
+  adcScansReady.fetch_add(1, std::memory_order_relaxed);
+}
+
+/// @brief Acquisition engine for the ESP32.
+/// Uses the DMA driven continuous mode of the ADC. If the continuous mode can't be started with the pins in the PINLIST,
+/// e.g. because some of them belong to ADC2, it falls back to sequential analogRead() scans in service().
+/// Every call of service() takes all scans, which are ready, so the frame rate doesn't depend on how often it is called.
+class EspAdcEngine : public AdcEngine {
+public:
+  bool begin(const int* pins) override {
+    for (int i = 0; i < ADC_CHANNELS; i++) {
+      adcPins[i] = pins[i];
+    }
+#if ADC_CONTINUOUS > 0
+    analogContinuousSetWidth(analogRead_Resolution);
+    continuous = analogContinuous(adcPins, ADC_CHANNELS, ADC_CONVERSIONS_PER_PIN,
+                                  (uint32_t)ADC_SAMPLE_RATE_HZ * ADC_CHANNELS * ADC_CONVERSIONS_PER_PIN, &onAdcConversionDone)
+                 && analogContinuousStart();
+#endif
+    return continuous;
+  }
+
+  void service() override {
+    uint16_t values[ADC_CHANNELS];
+    if (!continuous) {
+      // fallback: the sequential scans, which are due since the last call, at least one and at most one frame
+      uint32_t now = micros();
+      uint32_t due = (now - lastScanUs) / (1000000 / ADC_SAMPLE_RATE_HZ);
+      if (due < 1) due = 1;
+      if (due > OVERSAMPLING_RATIO) due = OVERSAMPLING_RATIO;
+      for (uint32_t n = 0; n < due; n++) {
+        for (int i = 0; i < ADC_CHANNELS; i++) {
+          values[i] = analogRead(adcPins[i]);
+        }
+        pushScan(values, micros());
+      }
+      lastScanUs = now;
+      return;
+    }
+    // drain all scans in the buffer of the driver, the ISR counts them
+    uint32_t ready = adcScansReady.exchange(0, std::memory_order_relaxed);
+    adc_continuous_data_t* result = NULL;
+    while (ready > 0 && analogContinuousRead(&result, 0)) {
+      ready--;
+      // the driver reports the channels in its own order, sort them back into the order of the PINLIST
+      for (int i = 0; i < ADC_CHANNELS; i++) {
+        values[i] = 0;
+        for (int j = 0; j < ADC_CHANNELS; j++) {
+          if (result[j].pin == adcPins[i]) {
+            values[i] = result[j].avg_read_raw;
+            break;
+          }
+        }
+      }
+      pushScan(values, micros());
+    }
+  }
+
+  bool isContinuous() {
+    return continuous;
+  }
+
+private:
+  uint8_t adcPins[ADC_CHANNELS];
+  bool continuous = false;
+  uint32_t lastScanUs = 0;  // time of the last sequential scans
+};
+
+EspAdcEngine adcEngine;
+#else
+// host build: the tests and benchmarks feed synthetic scans via pushScan()
+AdcEngine adcEngine;
+#endif
+#endif
@@ -0,0 +1,112 @@
+// This file contains the background re-zeroing of the sensors.
+// When the knob is idle for AUTOZERO_IDLE_MS, the center points slowly follow the sensors, which removes thermal drift.
+// While idle, the noise of each sensor is estimated with Welford's method. It is used for a per-sensor adaptive deadzone,
+// so quiet sensors can use a tighter deadzone than the global DEADZONE.
+// The IdleTracker has no dependencies to the Arduino framework, so it can be tested on a host with recorded traces.
+
+#ifndef AUTOZERO_H
+#define AUTOZERO_H
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include <stdint.h>
+#include <math.h>
+
+#define AUTOZERO_LEVEL_SHIFT 3  // the motion is detected on the centered values, smoothed over 2^AUTOZERO_LEVEL_SHIFT frames
+
+class IdleTracker {
+public:
+  /// @brief Feed one frame into the tracker. Call this after centering, but before FilterAnalogReadOuts().
+  /// @param nowMs current time in ms
+  /// @param rawReads pointer to 8 filtered sensor values
+  /// @param centered pointer to 8 centered sensor values, before the deadzone is applied
+  /// @param centerPoints pointer to 8 center points, which are adjusted while idle
+  /// @param deadzones pointer to 8 deadzones, which are used to detect the motion and are adjusted to the noise of each sensor
+  void update(unsigned long nowMs, const int* rawReads, const int* centered, int* centerPoints, int* deadzones) {
+    // The knob is only idle, if no sensor leaves the deadzone, which is used for the output. Otherwise a small, but
+    // intended motion within the global DEADZONE would be taken as drift and zeroed away.
+    // The centered values are smoothed over a few frames, so single noise peaks beyond the adaptive deadzone don't
+    // interrupt the idle period, while the drift is still followed.
+    bool inDeadzone = true;
+    for (int i = 0; i < 8; i++) {
+      levelQ8[i] += ((int32_t)centered[i] * 256 - levelQ8[i]) >> AUTOZERO_LEVEL_SHIFT;
+      if (levelQ8[i] >= (int32_t)deadzones[i] * 256 || levelQ8[i] <= -(int32_t)deadzones[i] * 256) {
+        inDeadzone = false;
+      }
+    }
+    if (!inDeadzone) {
+      lastMotionMs = nowMs;
+      idle = false;
+      return;
+    }
+    if (nowMs - lastMotionMs < AUTOZERO_IDLE_MS) return;
+
+    if (!idle) {
+      // start of a new idle period: start from the actual center points and new statistics
+      idle = true;
+      idlePeriods++;
+      for (int i = 0; i < 8; i++) {
+        centerQ8[i] = (int32_t)centerPoints[i] << 8;
+        n[i] = 0;
+        mean[i] = 0;
+        m2[i] = 0;
+      }
+    }
+
+    for (int i = 0; i < 8; i++) {
+      // slowly move the center point towards the actual value
+      centerQ8[i] += (((int32_t)rawReads[i] << 8) - centerQ8[i]) >> AUTOZERO_SHIFT;
+      centerPoints[i] = (centerQ8[i] + 128) >> 8;
+
+      // Welford's online variance of the difference to the tracked center point, so the drift itself doesn't count as noise
+      float x = rawReads[i] - centerQ8[i] / 256.0f;
+      n[i]++;
+      float delta = x - mean[i];
+      mean[i] += delta / n[i];
+      m2[i] += delta * (x - mean[i]);
+
+      if (n[i] >= AUTOZERO_MIN_SAMPLES) {
+        sigma[i] = sqrtf(m2[i] / (n[i] - 1));
+        int dz = (int)(AUTOZERO_SIGMA * sigma[i] + 0.5f);
+        if (dz < AUTOZERO_MIN_DEADZONE * SENSOR_SCALE) dz = AUTOZERO_MIN_DEADZONE * SENSOR_SCALE;
+        if (dz > DEADZONE * SENSOR_SCALE) dz = DEADZONE * SENSOR_SCALE;
+        deadzones[i] = dz;
+      }
+    }
+  }
+
+  bool isIdle() {
+    return idle;
+  }
+
+  float sigma[8] = {};        // standard deviation of each sensor during the last idle period
+  uint32_t idlePeriods = 0;  // number of detected idle periods since start
+
+private:
+  unsigned long lastMotionMs = 0;
+  bool idle = false;
+  int32_t centerQ8[8];      // center points with 8 fractional bits
+  int32_t levelQ8[8] = {};  // smoothed centered values with 8 fractional bits
+  uint32_t n[8];
+  float mean[8];
+  float m2[8];
+};
+
+IdleTracker idleTracker;
+
+#ifdef ARDUINO
+
+/// @brief Report the noise and the adaptive deadzone of each sensor, debug mode 15
+/// @param centerPoints pointer to the 8 center points
+/// @param deadzones pointer to the 8 deadzones
+void debugOutputAutoZero(int* centerPoints, int* deadzones) {
+  if (isDebugOutputDue()) {
+    SERIAL.printf("%s #%lu  ", idleTracker.isIdle() ? "idle" : "move", (unsigned long)idleTracker.idlePeriods);
+    for (int i = 0; i < 8; i++) {
+      SERIAL.printf("%2.2s: %d s%.1f dz%d  ", axisNames[i], centerPoints[i], idleTracker.sigma[i], deadzones[i]);
+    }
+    SERIAL.print(DEBUG_LINE_END);
+  }
+}
+#endif
+#endif
@@ -0,0 +1,337 @@
+// This file contains benchmarks, which run on the spacemouse itself and report the needed cpu cycles.
+// Start them with debug mode 13. The normal operation is blocked while the benchmarks are running.
+// The benchmarks also work as regression check: run them before and after a change.
+// The core functions are measured on a host as well, see test/bench_core.cpp and CMakeLists.txt.
+
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include "pipelineCheck.h"
+#include <SimpleKalmanFilter.h>
+
+#define BENCHMARK_ITERATIONS 1000
+#define BENCHMARK_FRAMES 16
+
+// sink for the results, so the compiler can't optimize the benchmarked code away
+volatile int benchmarkSink;
+
+/// @brief Fill a table with synthetic, noisy sensor frames around the typical center point
+/// @param frames table of BENCHMARK_FRAMES frames with 8 values each
+void benchmarkFrames(uint16_t frames[][8]) {
+  uint32_t seed = 12345;
+  for (int n = 0; n < BENCHMARK_FRAMES; n++) {
+    for (int i = 0; i < 8; i++) {
+      seed = seed * 1103515245 + 12345;
+      frames[n][i] = 1400 + ((seed >> 16) % 64) - 32;
+    }
+  }
+}
+
+/// @brief Compare the float SimpleKalmanFilter with the fixed point KalmanBank
+void benchmarkKalman() {
+  uint16_t frames[BENCHMARK_FRAMES][8];
+  benchmarkFrames(frames);
+
+  SimpleKalmanFilter floatFilters[8] = {
+    { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 },
+    { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }
+  };
+  static KalmanBank exactBank;
+  static KalmanBank steadyBank;
+  exactBank.init(5.0, 2.0, 0.01, false);
+  steadyBank.init(5.0, 2.0, 0.01, true);
+
+  int floatOut[8];
+  int fixedOut[8];
+  int maxDeviation = 0;
+
+  // reference run to get the deviation, not timed
+  for (int n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    exactBank.update(frames[n % BENCHMARK_FRAMES], fixedOut);
+    for (int i = 0; i < 8; i++) {
+      floatOut[i] = floatFilters[i].updateEstimate(frames[n % BENCHMARK_FRAMES][i]);
+      if (abs(floatOut[i] - fixedOut[i]) > maxDeviation) {
+        maxDeviation = abs(floatOut[i] - fixedOut[i]);
+      }
+    }
+  }
+
+  uint32_t start = ESP.getCycleCount();
+  for (int n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    for (int i = 0; i < 8; i++) {
+      floatOut[i] = floatFilters[i].updateEstimate(frames[n % BENCHMARK_FRAMES][i]);
+    }
+  }
+  uint32_t floatCycles = ESP.getCycleCount() - start;
+  benchmarkSink = floatOut[0];
+
+  start = ESP.getCycleCount();
+  for (int n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    exactBank.update(frames[n % BENCHMARK_FRAMES], fixedOut);
+  }
+  uint32_t fixedCycles = ESP.getCycleCount() - start;
+  benchmarkSink = fixedOut[0];
+
+  // let the steady state bank converge first
+  for (int n = 0; n < 4 * KALMAN_SS_SAMPLES && !steadyBank.isSteady(); n++) {
+    steadyBank.update(frames[n % BENCHMARK_FRAMES], fixedOut);
+  }
+  start = ESP.getCycleCount();
+  for (int n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    steadyBank.update(frames[n % BENCHMARK_FRAMES], fixedOut);
+  }
+  uint32_t steadyCycles = ESP.getCycleCount() - start;
+  benchmarkSink = fixedOut[0];
+
+  SERIAL.println(F("## Kalman filter, cycles per 8-channel update"));
+  SERIAL.printf("float SimpleKalmanFilter: %lu\n", (unsigned long)(floatCycles / BENCHMARK_ITERATIONS));
+  SERIAL.printf("fixed KalmanBank exact:   %lu (max. deviation %d counts)\n", (unsigned long)(fixedCycles / BENCHMARK_ITERATIONS), maxDeviation);
+  SERIAL.printf("fixed KalmanBank steady:  %lu (%s)\n", (unsigned long)(steadyCycles / BENCHMARK_ITERATIONS),
+                steadyBank.isSteady() ? "converged" : "not converged");
+}
+
+/// @brief Compare the double precision modifier function with the lookup tables and check, that both give the same results
+void benchmarkModifier() {
+  uint8_t savedModFunc = modFunc;
+  SERIAL.println(F("## Modifier function, cycles per call over -350 ... 350"));
+  for (uint8_t f = 0; f <= 4; f++) {
+    modFunc = f;
+    int mismatches = 0;
+    for (int x = -350; x <= 350; x++) {
+      if (modifierFunction(x) != modifierFunctionReference(x)) mismatches++;
+    }
+
+    int sum = 0;
+    uint32_t start = ESP.getCycleCount();
+    for (int x = -350; x <= 350; x++) {
+      sum += modifierFunctionReference(x);
+    }
+    uint32_t referenceCycles = ESP.getCycleCount() - start;
+    benchmarkSink = sum;
+
+    sum = 0;
+    start = ESP.getCycleCount();
+    for (int x = -350; x <= 350; x++) {
+      sum += modifierFunction(x);
+    }
+    uint32_t lutCycles = ESP.getCycleCount() - start;
+    benchmarkSink = sum;
+
+    SERIAL.printf("modFunc %d: double %lu, table %lu, %d mismatches\n", f, (unsigned long)(referenceCycles / 701),
+                  (unsigned long)(lutCycles / 701), mismatches);
+  }
+  modFunc = savedModFunc;
+}
+
+/// @brief Compare FilterAnalogReadOuts() and calculateKinematic() with the fixed point pipeline.
+/// Every sensor is swept over its whole range, while the others are zero. Then random frames with all sensors are used.
+void benchmarkFixedPipeline() {
+  int centered[8];
+  PipelineDeviation sweep = {};
+  sweepFixedPipeline(sweep);
+  SERIAL.println(F("## Fixed point pipeline"));
+  sweep.report("sweep: ");
+
+  // random frames within the calibrated range
+  static int frames[BENCHMARK_FRAMES][8];
+  uint32_t seed = 4711;
+  PipelineDeviation random = {};
+  for (int n = 0; n < 10 * BENCHMARK_ITERATIONS; n++) {
+    randomCenteredFrame(seed, centered);
+    compareFixedPipeline(centered, random);
+    if (n < BENCHMARK_FRAMES) memcpy(frames[n], centered, sizeof(centered));
+  }
+  random.report("random:");
+
+  int16_t floatVelocity[6];
+  int16_t fixedVelocity[6];
+  int32_t mapped[8];
+  uint32_t start = ESP.getCycleCount();
+  for (int n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    memcpy(centered, frames[n % BENCHMARK_FRAMES], sizeof(centered));
+    FilterAnalogReadOuts(centered);
+    calculateKinematic(centered, floatVelocity);
+  }
+  uint32_t floatCycles = ESP.getCycleCount() - start;
+  benchmarkSink = floatVelocity[0];
+
+  start = ESP.getCycleCount();
+  for (int n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    memcpy(centered, frames[n % BENCHMARK_FRAMES], sizeof(centered));
+    fixedPipeline.filter(centered, mapped);
+    fixedPipeline.kinematic(mapped, fixedVelocity);
+  }
+  uint32_t fixedCycles = ESP.getCycleCount() - start;
+  benchmarkSink = fixedVelocity[0];
+
+  SERIAL.printf("cycles per frame: float %lu, fixed %lu, saved %ld\n", (unsigned long)(floatCycles / BENCHMARK_ITERATIONS),
+                (unsigned long)(fixedCycles / BENCHMARK_ITERATIONS),
+                ((long)floatCycles - (long)fixedCycles) / BENCHMARK_ITERATIONS);
+}
+
+/// @brief Compare the fused pipeline with the original steps of the loop() (golden output). The deviation must be the same as
+/// the one of the fixed point pipeline, plus the kill-keys and the exclusive mode, which set whole axis to zero.
+void benchmarkFusedPipeline() {
+  int centered[8];
+  int keys[NUMKEYS + 1];
+  int16_t referenceVelocity[6];
+  int16_t fusedVelocity[6];
+  uint32_t seed = 815;
+  PipelineDeviation golden = {};
+  for (int n = 0; n < 10 * BENCHMARK_ITERATIONS; n++) {
+    randomCenteredFrame(seed, centered);
+    for (int k = 0; k < NUMKEYS; k++) {
+      keys[k] = ((seed >> k) & 7) == 0 ? LOW : HIGH;  // the kill-keys are pressed sometimes
+    }
+    compareFusedPipeline(centered, keys, golden);
+  }
+
+  for (int k = 0; k < NUMKEYS; k++) keys[k] = HIGH;
+  uint32_t start = ESP.getCycleCount();
+  for (int n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    randomCenteredFrame(seed, centered);
+    referencePipeline(centered, keys, referenceVelocity);
+  }
+  uint32_t referenceCycles = ESP.getCycleCount() - start;
+  benchmarkSink = referenceVelocity[0];
+
+  start = ESP.getCycleCount();
+  for (int n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    randomCenteredFrame(seed, centered);
+    Pipeline::run(centered, keys, fusedVelocity);
+  }
+  uint32_t fusedCycles = ESP.getCycleCount() - start;
+  benchmarkSink = fusedVelocity[0];
+
+  SERIAL.println(F("## Fused pipeline"));
+  golden.report("golden:");
+  SERIAL.printf("cycles per frame (including the random generator): original %lu, fused %lu\n",
+                (unsigned long)(referenceCycles / BENCHMARK_ITERATIONS), (unsigned long)(fusedCycles / BENCHMARK_ITERATIONS));
+}
+
+/// @brief Measure a function
+/// @param f function to measure, called BENCHMARK_ITERATIONS times with the number of the iteration
+/// @return cpu cycles per call
+template<typename F>
+uint32_t measureCycles(F f) {
+  uint32_t start = ESP.getCycleCount();
+  for (int n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    f(n);
+  }
+  return (ESP.getCycleCount() - start) / BENCHMARK_ITERATIONS;
+}
+
+/// @brief Print one line of the core benchmark in ns
+void reportCycles(const char* name, uint32_t cycles) {
+  SERIAL.printf("%-34s %7lu ns\n", name, (unsigned long)(cycles * 1000UL / getCpuFrequencyMhz()));
+}
+
+/// @brief Microbenchmarks of the core functions of the loop(), to catch regressions before flashing a new version.
+/// The sensors are fed by a mock ADC engine with synthetic scans, so the real acquisition and the filters are not disturbed.
+void benchmarkCore() {
+  static uint16_t scans[BENCHMARK_FRAMES][8];
+  benchmarkFrames(scans);
+  int raw[8];
+  int centeredIn[8];
+  int16_t vel[6];
+  uint32_t seed = 42;
+  uint32_t loopCycles = 0;
+
+  SERIAL.println(F("## Core functions, time per call"));
+
+  // readAllFromSensors() with a mock ADC: one frame needs OVERSAMPLING_RATIO scans
+  static AdcEngine mockAdc;
+  KalmanBank savedKalman = kalmanBank;
+  uint32_t cycles = measureCycles([&](int n) {
+    for (int k = 0; k < OVERSAMPLING_RATIO; k++) {
+      mockAdc.pushScan(scans[(n + k) % BENCHMARK_FRAMES], n);
+    }
+    readAllFromSensors(raw, mockAdc);
+  });
+  kalmanBank = savedKalman;
+  benchmarkSink = raw[0];
+  reportCycles("readAllFromSensors (mock ADC)", cycles);
+  loopCycles += cycles;
+
+  static int frames[BENCHMARK_FRAMES][8];
+  for (int n = 0; n < BENCHMARK_FRAMES; n++) randomCenteredFrame(seed, frames[n]);
+  cycles = measureCycles([&](int n) {
+    memcpy(centeredIn, frames[n % BENCHMARK_FRAMES], sizeof(centeredIn));
+    FilterAnalogReadOuts(centeredIn);
+  });
+  benchmarkSink = centeredIn[0];
+  reportCycles("FilterAnalogReadOuts", cycles);
+  loopCycles += cycles;
+
+  for (int n = 0; n < BENCHMARK_FRAMES; n++) FilterAnalogReadOuts(frames[n]);
+  cycles = measureCycles([&](int n) {
+    memcpy(centeredIn, frames[n % BENCHMARK_FRAMES], sizeof(centeredIn));
+    calculateKinematic(centeredIn, vel);
+  });
+  benchmarkSink = vel[0];
+  reportCycles("calculateKinematic", cycles);
+  loopCycles += cycles;
+
+#if ONE_EURO > 0
+  // the smoother of the loop() is not touched, it gets a new frame on every call
+  static VelocitySmoother smoother;
+  cycles = measureCycles([&](int n) {
+    for (int axis = 0; axis < 6; axis++) vel[axis] = 100 + ((n + axis) & 7);
+    smoother.apply(vel, n * 1000);
+  });
+  benchmarkSink = vel[0];
+  reportCycles("VelocitySmoother (one-euro)", cycles);
+  loopCycles += cycles;
+#endif
+
+  uint8_t savedModFunc = modFunc;
+  for (uint8_t f = 0; f < NUM_MODIFIER_CURVES; f++) {
+    modFunc = f;
+    int sum = 0;
+    cycles = measureCycles([&](int n) {
+      sum += modifierFunction(n % 701 - 350);
+    });
+    benchmarkSink = sum;
+    char name[32];
+    snprintf(name, sizeof(name), "modifierFunction MODFUNC %d", f);
+    reportCycles(name, cycles);
+  }
+  modFunc = savedModFunc;
+
+#if NUMKEYS > 0
+  int keys[NUMKEYS];
+  uint8_t out[NUMKEYS];
+  uint8_t state[NUMKEYS];
+  memset(state, 0, sizeof(state));
+  int noDebug = -1;
+  cycles = measureCycles([&](int n) {
+    for (int k = 0; k < NUMKEYS; k++) keys[k] = ((n >> 4) + k) & 1;  // toggle the keys every 16 calls
+    evalKeys(keys, out, state, noDebug);
+  });
+  benchmarkSink = state[0];
+  reportCycles("evalKeys", cycles);
+  loopCycles += cycles;
+
+  uint8_t keyData[HIDMAXBUTTONS];
+  cycles = measureCycles([&](int n) {
+    state[0] = n & 1;
+    prepareKeyBytes(state, keyData, noDebug);
+  });
+  benchmarkSink = keyData[0];
+  reportCycles("prepareKeyBytes", cycles);
+  loopCycles += cycles;
+#endif
+
+  reportCycles("loop iteration (sum of the above)", loopCycles);
+}
+
+/// @brief Run all benchmarks and report the results over the serial interface
+void runBenchmarks() {
+  SERIAL.println(F("\nRunning benchmarks..."));
+  benchmarkCore();
+  benchmarkKalman();
+  benchmarkModifier();
+  benchmarkFixedPipeline();
+  benchmarkFusedPipeline();
+  SERIAL.println();
+}
@@ -0,0 +1,183 @@
+// This file contains the connection interval policy and the batching of the notifications of the BLE HID, see bluetooth.h
+// A BLE host can only receive reports in the connection events, every 7.5 ms at best. So the reports are collected in
+// one slot per report id (latest value wins) and all pending reports are notified together once per connection event,
+// translation, rotation and buttons in up to BLE_MAX_NOTIFY_PER_EVENT notifications, or in one with HID_COMBINED_REPORT.
+// While there is motion, the shortest interval is requested. After BLE_IDLE_MS without motion, a slower interval is
+// requested to save power on both sides.
+// The GATT server is an interface, so the policy and the batching can be tested on a host with a mock server.
+
+#ifndef BLEHIDPOLICY_H
+#define BLEHIDPOLICY_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define BLE_BATCH_SLOTS 4          // input reports 1, 2, 3 and 23
+#define BLE_BATCH_MAX_REPORT 20    // bytes of a notification with the default MTU
+#define BLE_INTERVAL_UNIT_US 1250  // the connection interval is given in units of 1.25 ms
+
+// the GATT server of the HID service
+class BleGatt {
+public:
+  /// @brief Notify the input report of this id
+  /// @return false, if the notification couldn't be queued, e.g. the stack is congested
+  virtual bool notify(uint8_t id, const uint8_t* data, size_t len) = 0;
+  /// @brief Ask the host for a connection interval between min and max, in units of 1.25 ms
+  virtual void requestInterval(uint16_t minUnits, uint16_t maxUnits) = 0;
+};
+
+class BleIntervalPolicy {
+public:
+  /// @param fastUnits interval while there is motion, 6 = 7.5 ms is the shortest interval of BLE
+  /// @param idleUnits interval after idleMs without motion
+  BleIntervalPolicy(uint16_t fastUnits, uint16_t idleUnits, uint32_t idleMs)
+    : fastUnits(fastUnits), idleUnits(idleUnits), idleMs(idleMs) {}
+
+  /// @brief A new connection starts with the interval of the host
+  void connected(uint32_t nowMs) {
+    state = UNKNOWN;
+    lastMotionMs = nowMs;
+    effectiveUnits = 0;
+  }
+
+  /// @brief Request a new interval, if the motion started or stopped
+  void update(BleGatt& gatt, uint32_t nowMs, bool motion) {
+    if (motion) lastMotionMs = nowMs;
+    bool idle = nowMs - lastMotionMs >= idleMs;
+    if (!idle && state != FAST) {
+      // the host picks the shortest interval it accepts up to twice the requested one
+      gatt.requestInterval(fastUnits, 2 * fastUnits);
+      state = FAST;
+      requests++;
+    } else if (idle && state != IDLE) {
+      gatt.requestInterval(idleUnits, 2 * idleUnits);
+      state = IDLE;
+      requests++;
+    }
+  }
+
+  /// @brief The host set the connection interval
+  void intervalUpdated(uint16_t units) {
+    effectiveUnits = units;
+  }
+
+  /// @brief The time between two connection events in us, the requested one until the host has answered
+  uint32_t intervalUs() const {
+    if (effectiveUnits) return effectiveUnits * BLE_INTERVAL_UNIT_US;
+    return (state == IDLE ? idleUnits : fastUnits) * BLE_INTERVAL_UNIT_US;
+  }
+
+  bool fast() const {
+    return state == FAST;
+  }
+
+  uint16_t effectiveUnits = 0;  // connection interval set by the host, 0 = unknown
+  uint32_t requests = 0;        // requested interval changes
+
+private:
+  enum { UNKNOWN, FAST, IDLE } state = UNKNOWN;
+  uint16_t fastUnits;
+  uint16_t idleUnits;
+  uint32_t idleMs;
+  uint32_t lastMotionMs = 0;
+};
+
+class BleNotifyBatcher {
+public:
+  BleNotifyBatcher() {
+    memset(slots, 0, sizeof(slots));
+  }
+
+  /// @brief Collect a report for the next connection event, a pending report of the same id is replaced
+  /// @return false, if the report was dropped, because it is too long or all slots are in use by other ids
+  bool add(uint8_t id, const uint8_t* data, size_t len) {
+    Slot* slot = findSlot(id);
+    if (slot == nullptr || len > BLE_BATCH_MAX_REPORT) {
+      dropped++;
+      return false;
+    }
+    if (slot->pending) coalesced++;
+    slot->pending = true;
+    slot->len = len;
+    slot->seq = ++seq;
+    memcpy(slot->data, data, len);
+    return true;
+  }
+
+  /// @brief Notify the pending reports, the oldest first. The others wait for the next connection event.
+  /// A report, which the stack doesn't take, stays pending and is notified again in the next connection event.
+  /// @param maxNotifications notifications per connection event
+  /// @return number of notifications
+  int flush(BleGatt& gatt, int maxNotifications, uint32_t nowMs) {
+    int count = 0;
+    while (count < maxNotifications) {
+      Slot* oldest = nullptr;
+      for (int i = 0; i < BLE_BATCH_SLOTS; i++) {
+        if (slots[i].pending && (oldest == nullptr || (int32_t)(slots[i].seq - oldest->seq) < 0)) oldest = &slots[i];
+      }
+      if (oldest == nullptr) break;
+      if (!gatt.notify(oldest->id, oldest->data, oldest->len)) {
+        congested++;  // keep the report, it may be the only one of this state (e.g. a released button)
+        break;
+      }
+      oldest->pending = false;
+      count++;
+    }
+    if (count) events++;
+    notifications += count;
+    windowNotifications += count;
+    if (nowMs - windowStartMs >= 1000) {
+      rateHz = windowNotifications * 1000 / (nowMs - windowStartMs);
+      windowNotifications = 0;
+      windowStartMs = nowMs;
+    }
+    return count;
+  }
+
+  /// @brief number of reports waiting for the next connection event
+  int pending() const {
+    int count = 0;
+    for (int i = 0; i < BLE_BATCH_SLOTS; i++) {
+      if (slots[i].pending) count++;
+    }
+    return count;
+  }
+
+  uint32_t notifications = 0;  // sent notifications
+  uint32_t events = 0;         // connection events with notifications
+  uint32_t coalesced = 0;      // reports replaced by a newer one before they were notified
+  uint32_t dropped = 0;        // reports dropped: too long or no free slot
+  uint32_t congested = 0;      // notifications refused by the stack, the report is notified again in the next event
+  uint32_t rateHz = 0;         // notifications per second within the last second
+
+private:
+  struct Slot {
+    bool used;
+    bool pending;
+    uint8_t id;
+    uint8_t len;
+    uint32_t seq;
+    uint8_t data[BLE_BATCH_MAX_REPORT];
+  };
+
+  /// @brief The slot of the report id, a free slot is assigned on the first use
+  Slot* findSlot(uint8_t id) {
+    for (int i = 0; i < BLE_BATCH_SLOTS; i++) {
+      if (slots[i].used && slots[i].id == id) return &slots[i];
+    }
+    for (int i = 0; i < BLE_BATCH_SLOTS; i++) {
+      if (!slots[i].used) {
+        slots[i].used = true;
+        slots[i].id = id;
+        return &slots[i];
+      }
+    }
+    return nullptr;
+  }
+
+  Slot slots[BLE_BATCH_SLOTS];
+  uint32_t seq = 0;
+  uint32_t windowStartMs = 0;
+  uint32_t windowNotifications = 0;
+};
+#endif
@@ -1,6 +1,181 @@
+// This file contains the transport of the HID reports over Bluetooth LE (HID over GATT), see HID_TRANSPORT in config.h
+// The same report descriptor as for the USB is used. Every input report gets its own characteristic, which is notified.
+// The reports are batched per connection event and the connection interval follows the motion, see bleHidPolicy.h
 #include <BLEDevice.h>
 #include <BLEUtils.h>
 #include <BLEServer.h>
 #include <BLEHIDDevice.h>
 #include <HIDTypes.h>
-#include <HIDKeyboardTypes.h>
\ No newline at end of file
+#include <HIDKeyboardTypes.h>
+#include "bleHidPolicy.h"
+
+#define BLE_APPEARANCE_MULTI_AXIS 0x03C0  // generic HID, there is no appearance for a multi-axis controller
+
+class BleHidTransport : public HidTransport, public BleGatt, public BLEServerCallbacks, public BLECharacteristicCallbacks {
+public:
+  BleHidTransport()
+    : policy(BLE_FAST_INTERVAL, BLE_IDLE_INTERVAL, BLE_IDLE_MS) {}
+
+  bool begin(const uint8_t* descriptor, size_t len) override {
+    BLEDevice::init(USBPRODUCT);
+    server = BLEDevice::createServer();
+    server->setCallbacks(this);
+    BLEDevice::setCustomGapHandler(gapHandler);
+
+    hid = new BLEHIDDevice(server);
+    hid->manufacturer()->setValue(USBMANUFACTURER);
+    hid->pnp(0x02, USBVID, USBPID, 0x0100);  // vendor id from the USB-IF
+    hid->hidInfo(0x00, 0x01);
+    hid->reportMap((uint8_t*)descriptor, len);
+    for (int i = 0; i < BLE_INPUT_REPORTS; i++) inputs[i] = hid->inputReport(inputIds[i]);
+    hid->outputReport(4)->setCallbacks(this);
+#if LATENCY_PROBE > 0
+    hid->outputReport(LATENCY_PROBE_ID)->setCallbacks(this);
+    hid->featureReport(LATENCY_PROBE_ID)->setCallbacks(this);
+#endif
+    hid->startServices();
+
+    BLESecurity* security = new BLESecurity();
+    security->setAuthenticationMode(ESP_LE_AUTH_BOND);
+
+    BLEAdvertising* advertising = server->getAdvertising();
+    advertising->setAppearance(BLE_APPEARANCE_MULTI_AXIS);
+    advertising->addServiceUUID(hid->hidService()->getUUID());
+    advertising->start();
+    return true;
+  }
+
+  bool connected() override {
+    return isConnected;
+  }
+
+  HidCapabilities capabilities() override {
+    // 20 bytes with the default MTU, the reports are paced by the connection events, see service()
+    return { (uint16_t)(1000000UL / BLE_INTERVAL_UNIT_US / BLE_FAST_INTERVAL), BLE_BATCH_MAX_REPORT, true, true };
+  }
+
+  const char* name() override {
+    return "BLE";
+  }
+
+  bool ready() override {
+    return isConnected;
+  }
+
+  /// @brief Collect the report for the next connection event
+  bool send(uint8_t id, const uint8_t* data, size_t len) override {
+    if (!isConnected) return false;
+    if (id == 1 || id == 2) {
+      for (size_t i = 0; i < len; i++) motion |= data[i] != 0;
+    }
+    return batcher.add(id, data, len);
+  }
+
+  /// @brief Adapt the connection interval to the motion and notify the collected reports once per connection event.
+  /// Call it on every loop() or from the HID scheduler task, which also calls send().
+  void service(uint32_t nowUs) override {
+    if (!isConnected) return;
+    uint32_t nowMs = nowUs / 1000;
+    policy.update(*this, nowMs, motion);
+    motion = false;
+    if (nowUs - lastFlushUs < policy.intervalUs()) return;
+    lastFlushUs = nowUs;
+    batcher.flush(*this, BLE_MAX_NOTIFY_PER_EVENT, nowMs);
+  }
+
+  // BleGatt
+  bool notify(uint8_t id, const uint8_t* data, size_t len) override {
+    BLECharacteristic* input = findInput(id);
+    if (input == nullptr) return false;
+    if (esp_ble_get_cur_sendable_packets_num(connId) == 0) return false;  // the buffers of the controller are full
+    input->setValue((uint8_t*)data, len);
+    input->notify();
+    return true;
+  }
+
+  void requestInterval(uint16_t minUnits, uint16_t maxUnits) override {
+    server->updateConnParams(remoteAddress, minUnits, maxUnits, 0, BLE_SUPERVISION_TIMEOUT);
+  }
+
+  void onConnect(BLEServer* server, esp_ble_gatts_cb_param_t* param) override {
+    connId = param->connect.conn_id;
+    memcpy(remoteAddress, param->connect.remote_bda, sizeof(remoteAddress));
+    policy.connected(millis());
+    isConnected = true;
+  }
+
+  void onDisconnect(BLEServer* server) override {
+    isConnected = false;
+    server->getAdvertising()->start();  // allow the next connection
+  }
+
+  // output reports of the host
+  void onWrite(BLECharacteristic* characteristic) override {
+    if (onOutput) onOutput(reportId(characteristic), characteristic->getData(), characteristic->getLength());
+  }
+
+  // feature reports, which are read by the host
+  void onRead(BLECharacteristic* characteristic) override {
+    uint8_t buffer[LATENCY_ECHO_SIZE];
+    uint16_t len = onGetFeature ? onGetFeature(reportId(characteristic), buffer, sizeof(buffer)) : 0;
+    characteristic->setValue(buffer, len);
+  }
+
+private:
+  static const int BLE_INPUT_REPORTS = 4;
+  const uint8_t inputIds[BLE_INPUT_REPORTS] = { 1, 2, 3, 23 };
+
+  BLECharacteristic* findInput(uint8_t id) {
+    for (int i = 0; i < BLE_INPUT_REPORTS; i++) {
+      if (inputIds[i] == id) return inputs[i];
+    }
+    return nullptr;
+  }
+
+  // the report id is the first byte of the report reference descriptor of the characteristic
+  uint8_t reportId(BLECharacteristic* characteristic) {
+    BLEDescriptor* reference = characteristic->getDescriptorByUUID(BLEUUID((uint16_t)0x2908));
+    return reference ? reference->getValue()[0] : 0;
+  }
+
+  static void gapHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param);
+
+  BLEServer* server = nullptr;
+  BLEHIDDevice* hid = nullptr;
+  BLECharacteristic* inputs[BLE_INPUT_REPORTS] = {};
+  volatile bool isConnected = false;
+  uint16_t connId = 0;
+  esp_bd_addr_t remoteAddress = {};
+  bool motion = false;  // a motion report was sent since the last service()
+  uint32_t lastFlushUs = 0;
+
+public:
+  BleIntervalPolicy policy;
+  BleNotifyBatcher batcher;
+};
+
+BleHidTransport bleHidTransport;
+
+// the connection interval, which was set by the host
+void BleHidTransport::gapHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) {
+  if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT && param->update_conn_params.status == 0) {
+    bleHidTransport.policy.intervalUpdated(param->update_conn_params.conn_int);
+  }
+}
+
+/// @brief Report the connection interval and the notifications
+void printBleStats() {
+  SERIAL.printf("BLE: %s, interval %.2f ms (%s), %lu notifications/s, %lu notifications in %lu events, %lu coalesced, %lu dropped, %lu congested\n",
+                bleHidTransport.connected() ? "connected" : "not connected", bleHidTransport.policy.intervalUs() / 1000.0,
+                bleHidTransport.policy.fast() ? "fast" : "idle", (unsigned long)bleHidTransport.batcher.rateHz,
+                (unsigned long)bleHidTransport.batcher.notifications, (unsigned long)bleHidTransport.batcher.events,
+                (unsigned long)bleHidTransport.batcher.coalesced, (unsigned long)bleHidTransport.batcher.dropped,
+                (unsigned long)bleHidTransport.batcher.congested);
+}
+
+/// @brief Start the BLE HID and send the reports over it
+void setupBLE() {
+  bleHidTransport.setHandlers(hidOutput, hidGetFeature);
+  bleHidTransport.begin(report_descriptor, sizeof(report_descriptor));
+  selectTransport(bleHidTransport);
+}
@@ -0,0 +1,298 @@
+// This file contains the persistent calibration store.
+// All calibration values are kept in a versioned, CRC protected binary blob in the NVS (flash) of the ESP32.
+// It is loaded during setup(), so a calibrated unit doesn't need to zero the sensors on every boot.
+// The blob can be exported and imported over the serial interface (debug mode 40 and 41) to clone calibrations,
+// see tools/calibration_tool.py
+//
+// Binary format, all values little endian:
+//   header:  "SMCB", uint16 version, uint16 payload size
+//   payload: int16 minVals[8], int16 maxVals[8], int32 centerPoints[8], float sensitivities[7], int16 gates[4],
+//            uint8 modFunc, uint8 invertList (bit i = sensor i), uint8 sensor resolution of the center points in bits, uint8 flags
+//            version 2 only: int16 kinematicMatrix[6][8] (Q12)
+//   trailer: uint32 CRC-32 over header and payload
+
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include "crc32.h"
+#include "modifierLut.h"
+#include <stdint.h>
+#include <string.h>
+
+#define CALIB_VERSION 2
+#define CALIB_HEADER_SIZE 8
+#define CALIB_PAYLOAD_SIZE_V1 104
+#define CALIB_PAYLOAD_SIZE_V2 (CALIB_PAYLOAD_SIZE_V1 + 96)
+#define CALIB_MAX_SIZE (CALIB_HEADER_SIZE + CALIB_PAYLOAD_SIZE_V2 + 4)
+
+// flags
+#define CALIB_FLAG_CENTERPOINTS 0x01  // the center points are valid and zeroing at startup can be skipped
+#define CALIB_FLAG_MATRIX 0x02        // the kinematic matrix is valid, not set for version 1
+
+struct CalibrationData {
+  int16_t minVals[8];
+  int16_t maxVals[8];
+  int32_t centerPoints[8];  // in units of the oversampled sensors
+  float sensitivities[7];
+  int16_t gates[4];
+  uint8_t modFunc;
+  uint8_t invertMask;
+  uint8_t sensorResolution;  // resolution of the center points in bits
+  uint8_t flags;
+  int16_t kinematicMatrix[6][8];
+};
+
+static uint8_t* calibPut(uint8_t* p, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    *p++ = value >> (8 * i);
+  }
+  return p;
+}
+
+static uint32_t calibGet(const uint8_t*& p, int bytes) {
+  uint32_t value = 0;
+  for (int i = 0; i < bytes; i++) {
+    value |= (uint32_t)(*p++) << (8 * i);
+  }
+  return value;
+}
+
+/// @brief Convert the calibration into the binary blob
+/// @param c calibration data
+/// @param out buffer with at least CALIB_MAX_SIZE bytes
+/// @return number of bytes written
+size_t serializeCalibration(const CalibrationData& c, uint8_t* out) {
+  uint8_t* p = out;
+  memcpy(p, "SMCB", 4);
+  p += 4;
+  p = calibPut(p, CALIB_VERSION, 2);
+  p = calibPut(p, CALIB_PAYLOAD_SIZE_V2, 2);
+  for (int i = 0; i < 8; i++) p = calibPut(p, (uint16_t)c.minVals[i], 2);
+  for (int i = 0; i < 8; i++) p = calibPut(p, (uint16_t)c.maxVals[i], 2);
+  for (int i = 0; i < 8; i++) p = calibPut(p, (uint32_t)c.centerPoints[i], 4);
+  for (int i = 0; i < 7; i++) {
+    uint32_t bits;
+    memcpy(&bits, &c.sensitivities[i], 4);
+    p = calibPut(p, bits, 4);
+  }
+  for (int i = 0; i < 4; i++) p = calibPut(p, (uint16_t)c.gates[i], 2);
+  *p++ = c.modFunc;
+  *p++ = c.invertMask;
+  *p++ = c.sensorResolution;
+  *p++ = c.flags;
+  for (int a = 0; a < 6; a++) {
+    for (int i = 0; i < 8; i++) p = calibPut(p, (uint16_t)c.kinematicMatrix[a][i], 2);
+  }
+  p = calibPut(p, crc32Update(0, out, p - out), 4);
+  return p - out;
+}
+
+/// @brief Check and decode a binary blob
+/// @param in pointer to the blob
+/// @param len number of bytes available
+/// @param c destination, only changed if the blob is valid
+/// @return false, if the blob is invalid (wrong magic, unknown version, wrong size or CRC). Version 1 is still accepted.
+/// The values are not checked, see calibrationError().
+bool deserializeCalibration(const uint8_t* in, size_t len, CalibrationData& c) {
+  if (len < CALIB_HEADER_SIZE || memcmp(in, "SMCB", 4) != 0) return false;
+  const uint8_t* p = in + 4;
+  uint16_t version = calibGet(p, 2);
+  uint16_t payloadSize = calibGet(p, 2);
+  if (!(version == 1 && payloadSize == CALIB_PAYLOAD_SIZE_V1) && !(version == 2 && payloadSize == CALIB_PAYLOAD_SIZE_V2)) return false;
+  if (len < (size_t)CALIB_HEADER_SIZE + payloadSize + 4) return false;
+  const uint8_t* crcPos = in + CALIB_HEADER_SIZE + payloadSize;
+  if (crc32Update(0, in, CALIB_HEADER_SIZE + payloadSize) != calibGet(crcPos, 4)) return false;
+
+  CalibrationData d;
+  for (int i = 0; i < 8; i++) d.minVals[i] = (int16_t)calibGet(p, 2);
+  for (int i = 0; i < 8; i++) d.maxVals[i] = (int16_t)calibGet(p, 2);
+  for (int i = 0; i < 8; i++) d.centerPoints[i] = (int32_t)calibGet(p, 4);
+  for (int i = 0; i < 7; i++) {
+    uint32_t bits = calibGet(p, 4);
+    memcpy(&d.sensitivities[i], &bits, 4);
+  }
+  for (int i = 0; i < 4; i++) d.gates[i] = (int16_t)calibGet(p, 2);
+  d.modFunc = *p++;
+  d.invertMask = *p++;
+  d.sensorResolution = *p++;
+  d.flags = *p++;
+  if (version >= 2) {
+    for (int a = 0; a < 6; a++) {
+      for (int i = 0; i < 8; i++) d.kinematicMatrix[a][i] = (int16_t)calibGet(p, 2);
+    }
+  } else {
+    d.flags &= ~CALIB_FLAG_MATRIX;
+    memset(d.kinematicMatrix, 0, sizeof(d.kinematicMatrix));
+  }
+  c = d;
+  return true;
+}
+
+/// @brief Check the values of a calibration against the limits of the "set" command. A blob with a valid CRC can still
+/// contain values, which break the pipeline, e.g. a division by a sensitivity of 0 or by a range of 0.
+/// @return NULL, if the calibration can be used, otherwise the reason
+const char* calibrationError(const CalibrationData& c) {
+  for (int i = 0; i < 8; i++) {
+    // the centered values must be mapped from [min, 0] and [0, max]
+    if (c.minVals[i] >= 0 || c.maxVals[i] <= 0) return "range of a sensor";
+  }
+  for (int i = 0; i < 7; i++) {
+    // also false for NaN
+    if (!(c.sensitivities[i] >= (float)SENSITIVITY_MIN && c.sensitivities[i] <= (float)SENSITIVITY_MAX)) return "sensitivity";
+  }
+  for (int i = 0; i < 4; i++) {
+    if (c.gates[i] < 0 || c.gates[i] > GATE_MAX) return "gate";
+  }
+  if (c.modFunc >= NUM_MODIFIER_CURVES) return "modfunc";
+  if ((c.flags & CALIB_FLAG_CENTERPOINTS) && (c.sensorResolution < 12 || c.sensorResolution > 24)) return "sensor resolution";
+  return NULL;
+}
+
+#ifdef ARDUINO
+#include <Preferences.h>
+
+int* calibCenterPoints;  // center points of the loop(), registered in loadCalibration()
+
+/// @brief Copy the actual calibration values into the calibration data
+void collectCalibration(CalibrationData& c) {
+  c.invertMask = 0;
+  for (int i = 0; i < 8; i++) {
+    c.minVals[i] = minVals[i];
+    c.maxVals[i] = maxVals[i];
+    c.centerPoints[i] = calibCenterPoints[i];
+    if (invertList[i]) c.invertMask |= (1 << i);
+  }
+  for (int i = 0; i < 7; i++) c.sensitivities[i] = sensitivities[i];
+  for (int i = 0; i < 4; i++) c.gates[i] = gates[i];
+  c.modFunc = modFunc;
+  c.sensorResolution = SENSOR_RESOLUTION;
+  memcpy(c.kinematicMatrix, kinematicMatrix, sizeof(c.kinematicMatrix));
+  c.flags = CALIB_FLAG_CENTERPOINTS | CALIB_FLAG_MATRIX;
+}
+
+/// @brief Use the calibration data from now on. Invalid data is rejected and nothing is changed.
+/// @param centered set to true, if the center points have been taken over
+/// @return false, if the calibration has been rejected, see calibrationError()
+bool applyCalibration(const CalibrationData& c, bool& centered) {
+  centered = false;
+  const char* error = calibrationError(c);
+  if (error) {
+    SERIAL.printf("Calibration rejected: invalid %s.\n", error);
+    return false;
+  }
+  for (int i = 0; i < 8; i++) {
+    minVals[i] = c.minVals[i];
+    maxVals[i] = c.maxVals[i];
+    invertList[i] = (c.invertMask >> i) & 1;
+  }
+  for (int i = 0; i < 7; i++) sensitivities[i] = c.sensitivities[i];
+  for (int i = 0; i < 4; i++) gates[i] = c.gates[i];
+  modFunc = c.modFunc;
+  // a version 1 calibration doesn't have a matrix, use the one from config.h
+  memcpy(kinematicMatrix, (c.flags & CALIB_FLAG_MATRIX) ? c.kinematicMatrix : defaultKinematicMatrix, sizeof(kinematicMatrix));
+  if (!(c.flags & CALIB_FLAG_CENTERPOINTS)) return true;
+  for (int i = 0; i < 8; i++) {
+    // the oversampling might have been changed since the center points were stored
+    if (c.sensorResolution >= SENSOR_RESOLUTION) {
+      calibCenterPoints[i] = c.centerPoints[i] >> (c.sensorResolution - SENSOR_RESOLUTION);
+    } else {
+      calibCenterPoints[i] = c.centerPoints[i] << (SENSOR_RESOLUTION - c.sensorResolution);
+    }
+  }
+  centered = true;
+  return true;
+}
+
+/// @brief Store the actual calibration in the NVS
+/// @return true, if successful
+bool saveCalibration() {
+  CalibrationData c;
+  uint8_t blob[CALIB_MAX_SIZE];
+  collectCalibration(c);
+  size_t len = serializeCalibration(c, blob);
+  Preferences prefs;
+  prefs.begin("spacemouse", false);
+  size_t written = prefs.putBytes("calib", blob, len);
+  prefs.end();
+  return written == len;
+}
+
+/// @brief Load the calibration from the NVS. Call this once during setup(), before the zeroing.
+/// @param centerPoints pointer to the 8 center points of the loop()
+/// @return true, if valid center points have been loaded and the zeroing can be skipped
+bool loadCalibration(int* centerPoints) {
+  calibCenterPoints = centerPoints;
+  uint8_t blob[CALIB_MAX_SIZE];
+  Preferences prefs;
+  prefs.begin("spacemouse", true);
+  size_t len = prefs.getBytes("calib", blob, sizeof(blob));
+  prefs.end();
+
+  CalibrationData c;
+  if (!deserializeCalibration(blob, len, c)) {
+    SERIAL.println(F("No valid calibration stored, using config.h"));
+    return false;
+  }
+  bool centered;
+  if (!applyCalibration(c, centered)) return false;
+  SERIAL.println(F("Calibration loaded from flash."));
+  return centered;
+}
+
+/// @brief Remove the stored calibration. After the next reset, the values from config.h are used again.
+void eraseCalibration() {
+  Preferences prefs;
+  prefs.begin("spacemouse", false);
+  prefs.remove("calib");
+  prefs.end();
+}
+
+/// @brief Send the actual calibration as binary blob over the serial interface (debug mode 40)
+void exportCalibration() {
+  CalibrationData c;
+  uint8_t blob[CALIB_MAX_SIZE];
+  collectCalibration(c);
+  size_t len = serializeCalibration(c, blob);
+  SERIAL.write(blob, len);
+  SERIAL.flush();
+}
+
+/// @brief Receive a binary blob over the serial interface, use it and store it in the NVS (debug mode 41). Blocks until the blob is received.
+/// The center points of the blob are not taken over, the stored center points are the actual ones of this unit.
+/// @return true, if a valid blob was received
+bool importCalibration() {
+  while (SERIAL.available()) SERIAL.read();  // drop the rest of the command line
+  SERIAL.println(F("Send the calibration blob now."));
+  uint8_t blob[CALIB_MAX_SIZE];
+  size_t len = 0;
+  size_t expected = sizeof(blob);
+  unsigned long start = millis();
+  while (len < expected && millis() - start < CALIB_IMPORT_TIMEOUT_MS) {
+    if (SERIAL.available()) {
+      blob[len++] = SERIAL.read();
+      if (len == CALIB_HEADER_SIZE) {
+        // the header tells the size of the blob
+        expected = min((size_t)(CALIB_HEADER_SIZE + (blob[6] | (blob[7] << 8)) + 4), sizeof(blob));
+      }
+    }
+  }
+  CalibrationData c;
+  if (!deserializeCalibration(blob, len, c)) {
+    SERIAL.println(F("Import failed: invalid calibration blob."));
+    return false;
+  }
+  // the center points belong to the hall effect sensors of the exporting unit, this unit keeps its own
+  c.flags &= ~CALIB_FLAG_CENTERPOINTS;
+  bool centered;
+  if (!applyCalibration(c, centered)) {
+    SERIAL.println(F("Import failed: values out of range."));
+    return false;
+  }
+  if (!saveCalibration()) {
+    SERIAL.println(F("Import failed: could not write to flash."));
+    return false;
+  }
+  SERIAL.println(F("Calibration imported and saved."));
+  return true;
+}
+#endif
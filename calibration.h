@@ -1,5 +1,37 @@
 // File for calibration specific functions
+// It is included after the other parts of the sketch. What it uses from them is included or declared here, so it also
+// compiles on its own, e.g. for the host tests.
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
 #include "config.h"
+#include "kinematics.h"
+#if HID_SCHEDULER > 0
+#include "hidScheduler.h"
+extern HidScheduler hidScheduler;  // usbSpaceHID.h
+#endif
+#if HID_COALESCE > 0
+#include "hidCoalescer.h"
+extern ReportCoalescer reportCoalescer;  // usbSpaceHID.h
+#endif
+#if POWER_GOVERNOR > 0
+#include "powerGovernor.h"
+extern PowerGovernor powerGovernor;  // powerGovernor.h, only on the device
+#endif
+#include "telemetry.h"
+
+#if CALIBSTORE > 0
+bool saveCalibration();  // calibStore.h
+#endif
+#if SAMPLING_TASK > 0
+void printSamplingStats();  // samplingTask.h
+#endif
+#if HID_TRANSPORT == HID_TRANSPORT_BLE
+void printBleStats();  // bluetooth.h
+#endif
+#if SCREEN_DIRTY_RENDER > 0
+void printScreenStats();  // main file
+#endif
 
 
 /// @brief Prints an array to the Serial, in order to copy the output again to C-Code. Example output: {-519, -521, -512, -2, -519, -482, -508, -1}
@@ -134,10 +166,15 @@ void calcMinMax(int* centered) {
       }
     } else {
       // 15s are over. go to next state and report via console
-      SERIAL.println(F("\n\nStop moving the spacemouse. These are the result. Copy them in config.h"));
+      SERIAL.println(F("\n\nStop moving the spacemouse. These are the result. Copy them in config.h or keep them in the calibration store."));
       minMaxCalcState = 2;
     }
   } else if (minMaxCalcState == 2) {
+    // convert the oversampled values back into the 12 bit units of the config.h
+    for (int i = 0; i < 8; i++) {
+      minValue[i] /= SENSOR_SCALE;
+      maxValue[i] /= SENSOR_SCALE;
+    }
     SERIAL.print(F("#define MINVALS "));
     printArray(minValue, 8);
     SERIAL.print(F("#define MAXVALS "));
@@ -152,6 +189,16 @@ void calcMinMax(int* centered) {
       max = (abs(maxValue[i]) > max) ? abs(maxValue[i]) : max;
       min = (abs(minValue[i]) > min) ? abs(minValue[i]) : min;
     }
+#if CALIBSTORE > 0
+    // use the new values right away and keep them in the calibration store
+    for (int i = 0; i < 8; i++) {
+      minVals[i] = minValue[i];
+      maxVals[i] = maxValue[i];
+    }
+    if (saveCalibration()) {
+      SERIAL.println(F("The values are used now and saved in the calibration store."));
+    }
+#endif
     SERIAL.print(F("Ranges are: "));
     printArray(minmaxRanges, 8);
     int centerPoint = (max + (min * -1)) / 2;
@@ -171,10 +218,12 @@ void calcMinMax(int* centered) {
 
 /// @brief Calibrate (=zero) the space mouse. The function is blocking other functions of the spacemouse during zeroing.
 /// @param centerPoints
-/// @param numIterations How many readings are taken to calculate the mean. Suggestion: 500 iterations, they take approx. 480ms.
+/// @param durationMs How long the frames are averaged. Every new frame of the ADC is one reading, so the number of readings
+/// is durationMs * ADC_SAMPLE_RATE_HZ / OVERSAMPLING_RATIO / 1000, e.g. 125 readings in 500 ms.
 /// @param debugFlag With debugFlag = true, a suggestion for the dead zone is given on the serial interface to save to the config.h
+/// @param engine acquisition engine to read from, e.g. a mock engine for the tests
 /// @return returns true, if no warnings occured. Warnings are given if the zero positions are very unlikely
-bool busyZeroing(int* centerPoints, uint16_t numIterations, boolean debugFlag) {
+bool busyZeroing(int* centerPoints, uint16_t durationMs, boolean debugFlag, AdcEngine& engine = adcEngine) {
   bool noWarningsOccured = true;
   if (debugFlag == true)
     SERIAL.println(F("\nZeroing HALL Sensors..."));
@@ -184,7 +233,7 @@ bool busyZeroing(int* centerPoints, uint16_t numIterations, boolean debugFlag) {
   int minValue[8];                                // Array to store the minimum values
   int maxValue[8];                                // Array to store the maximum values
   for (int i = 0; i < 8; i++) {
-    minValue[i] = analogMax_Resolution;  // Set the min value to the maximum possible value
+    minValue[i] = SENSOR_MAX;  // Set the min value to the maximum possible value
     maxValue[i] = 0;                     // Set the max value to the minimum possible value
   }
 
@@ -192,10 +241,12 @@ bool busyZeroing(int* centerPoints, uint16_t numIterations, boolean debugFlag) {
   unsigned int long start, end;
   start = millis();
 
-  uint16_t count;
-  readAllFromSensors(act);
-  for (count = 0; count < numIterations; count++) {
-    readAllFromSensors(act);
+  uint32_t count = 0;
+  readAllFromSensors(act, engine);
+  while (millis() - start < durationMs) {
+    // only take fresh frames of the ADC, so every reading is a new measurement
+    if (!readAllFromSensors(act, engine)) continue;
+    count++;
     for (uint8_t i = 0; i < 8; i++) {
       // Add to mean
       mean[i] = mean[i] + act[i];
@@ -209,6 +260,11 @@ bool busyZeroing(int* centerPoints, uint16_t numIterations, boolean debugFlag) {
     }
   }
 
+  if (count == 0) {
+    SERIAL.println(F("No frames of the ADC received, the center points are not changed."));
+    return false;
+  }
+
   int16_t deadZone[8];
   int16_t maxDeadZone = 0;
   // calculating average by dividing the mean by the number of iterations
@@ -220,7 +276,7 @@ bool busyZeroing(int* centerPoints, uint16_t numIterations, boolean debugFlag) {
       maxDeadZone = deadZone[i];
     }
 
-    if (deadZone[i] > DEADZONEWARNING || centerPoints[i] < CENTERPOINTWARNINGMIN || centerPoints[i] > CENTERPOINTWARNINGMAX) {
+    if (deadZone[i] > DEADZONEWARNING * SENSOR_SCALE || centerPoints[i] < CENTERPOINTWARNINGMIN * SENSOR_SCALE || centerPoints[i] > CENTERPOINTWARNINGMAX * SENSOR_SCALE) {
       noWarningsOccured = false;
     }
   }
@@ -230,10 +286,10 @@ bool busyZeroing(int* centerPoints, uint16_t numIterations, boolean debugFlag) {
     SERIAL.println(F("##  Min - Mean - Max -> Dead Zone"));
     for (int i = 0; i < 8; i++) {
       SERIAL.printf("%2.2s: %d - %d - %d - %d  ", axisNames[i], minValue[i], centerPoints[i], maxValue[i], deadZone[i]);
-      if (deadZone[i] > DEADZONEWARNING) {
+      if (deadZone[i] > DEADZONEWARNING * SENSOR_SCALE) {
         SERIAL.print(F(" Attention! Moved axis?"));
       }
-      if (centerPoints[i] < CENTERPOINTWARNINGMIN || centerPoints[i] > CENTERPOINTWARNINGMAX) {
+      if (centerPoints[i] < CENTERPOINTWARNINGMIN * SENSOR_SCALE || centerPoints[i] > CENTERPOINTWARNINGMAX * SENSOR_SCALE) {
         SERIAL.print(F(" Attention! Axis in idle?"));
       }
       SERIAL.println();
@@ -242,12 +298,12 @@ bool busyZeroing(int* centerPoints, uint16_t numIterations, boolean debugFlag) {
     SERIAL.println(F("Using mean as zero position..."));
     SERIAL.print(F("Suggestion for config.h: "));
     SERIAL.print(F("#define DEADZONE "));
-    SERIAL.println(maxDeadZone);
+    SERIAL.println((maxDeadZone + SENSOR_SCALE - 1) / SENSOR_SCALE);  // in units of the 12 bit ADC, rounded up
     SERIAL.print(F("This took "));
     SERIAL.print(end - start);
     SERIAL.print(F(" ms for "));
     SERIAL.print(count);
-    SERIAL.println(F(" iterations.\n"));
+    SERIAL.println(F(" frames.\n"));
   }
   return noWarningsOccured;
 }
@@ -263,7 +319,37 @@ void updateFrequencyReport() {
     SERIAL.print("Frequency: ");
     SERIAL.print(iterationsPerSecond);
     SERIAL.println(" Hz");
+#if SAMPLING_TASK > 0
+    printSamplingStats();
+#endif
+#if HID_SCHEDULER > 0
+    SERIAL.printf("HID: %lu sent, %lu coalesced, %lu dropped, %lu stale, latency mean %lu us, max %lu us\n",
+                  (unsigned long)hidScheduler.sent, (unsigned long)hidScheduler.coalesced, (unsigned long)hidScheduler.dropped,
+                  (unsigned long)hidScheduler.stale,
+                  (unsigned long)hidScheduler.latencyMeanUs(), (unsigned long)hidScheduler.latencyMaxUs);
+#endif
+#if HID_TRANSPORT == HID_TRANSPORT_BLE
+    printBleStats();
+#endif
+#if SCREEN_DIRTY_RENDER > 0
+    printScreenStats();
+#endif
+#if POWER_GOVERNOR > 0
+    SERIAL.printf("Power: %s, %lu wakes, wake latency from the first scan with motion last %lu us, mean %lu us, max %lu us\n",
+                  powerGovernor.stateName(), (unsigned long)powerGovernor.wakes, (unsigned long)powerGovernor.lastWakeUs,
+                  (unsigned long)powerGovernor.meanWakeUs(), (unsigned long)powerGovernor.maxWakeUs);
+#endif
+#if HID_COALESCE > 0
+    SERIAL.printf("HID coalescing: %lu of %lu reports suppressed (%.1f %%)\n",
+                  (unsigned long)reportCoalescer.suppressed, (unsigned long)reportCoalescer.candidates, reportCoalescer.suppressionRatio());
+#endif
+#if TELEMETRY > 0
+    if (telemetryMask) {
+      SERIAL.printf("Telemetry: %lu frames, %lu dropped\n", (unsigned long)telemetry.frames, (unsigned long)telemetry.dropped);
+    }
+#endif
     lastFrequencyUpdate = millis();  // reset timer
     iterationsPerSecond = 0;         // reset iteration counter
   }
-}
\ No newline at end of file
+}
+#endif
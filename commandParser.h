@@ -0,0 +1,128 @@
+// This file contains the parser of the commands, which are received over the serial interface.
+// The parser takes only the bytes, which are available, so the loop() never waits for the rest of a line.
+// It doesn't allocate memory and has no dependencies to the Arduino framework, so it can be tested on a host.
+//
+// A line is either a plain number, which selects the debug mode as before, or a request with an id:
+//   #<id> <command> [<argument> ...]
+// The answer to a request is a single line, starting with the same id:
+//   #<id> ok [<key>=<value> ...]
+//   #<id> err <reason>
+// A line ends with '\n' or '\r', or after COMMAND_IDLE_MS without a new byte (e.g. serial monitor without line ending).
+
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COMMAND_MAX_LINE 64  // longer lines are discarded
+#define COMMAND_MAX_ARGS 3
+
+struct Command {
+  int32_t id;                           // id of the request, -1 for a plain number or a request without id
+  bool plainNumber;                     // the line is only a number: select the debug mode
+  long number;                          // value of the plain number
+  const char* name;                     // command, e.g. "set"
+  const char* args[COMMAND_MAX_ARGS];  // arguments, pointing into the line
+  int argc;
+};
+
+class CommandParser {
+public:
+  /// @brief Process one received byte
+  /// @param c the byte
+  /// @param nowMs current time in ms, for the idle timeout
+  /// @return true, if a line is complete. Get it with line() before the next call.
+  bool feed(char c, uint32_t nowMs) {
+    lastByteMs = nowMs;
+    if (c == '\n' || c == '\r') {
+      return finishLine();
+    }
+    if (c == '\0') return false;  // would cut the line short, e.g. sent by a terminal on a break
+    if (len < COMMAND_MAX_LINE) {
+      buffer[len++] = c;
+    } else {
+      overflow = true;  // keep on discarding until the end of the line
+    }
+    return false;
+  }
+
+  /// @brief Complete a pending line without line ending, if no byte came for COMMAND_IDLE_MS
+  /// @return true, if a line is complete
+  bool idle(uint32_t nowMs) {
+    if (len == 0 && !overflow) return false;
+    if (nowMs - lastByteMs < COMMAND_IDLE_MS) return false;
+    return finishLine();
+  }
+
+  /// @brief The completed line, only valid after feed() or idle() returned true
+  char* line() {
+    return buffer;
+  }
+
+  uint32_t overflows = 0;  // number of discarded lines, which were too long
+
+private:
+  bool finishLine() {
+    bool complete = len > 0 && !overflow;
+    if (overflow) overflows++;
+    buffer[complete ? len : 0] = '\0';
+    len = 0;
+    overflow = false;
+    return complete;
+  }
+
+  char buffer[COMMAND_MAX_LINE + 1];
+  int len = 0;
+  bool overflow = false;
+  uint32_t lastByteMs = 0;
+};
+
+/// @brief Parse a number, the whole token must be a number
+/// @return false, if the token is not a number
+inline bool parseNumber(const char* token, long& value) {
+  if (token == nullptr || *token == '\0') return false;
+  char* end;
+  value = strtol(token, &end, 10);
+  return *end == '\0';
+}
+
+/// @brief Split a line into a command. The line is changed in place, the command points into it.
+/// @return false, if the line is empty, has a malformed id or too many arguments
+inline bool parseCommand(char* line, Command& cmd) {
+  cmd.id = -1;
+  cmd.plainNumber = false;
+  cmd.number = 0;
+  cmd.name = nullptr;
+  cmd.argc = 0;
+
+  const char* tokens[COMMAND_MAX_ARGS + 2];
+  int count = 0;
+  char* p = line;
+  while (*p != '\0') {
+    while (*p == ' ' || *p == '\t') *p++ = '\0';
+    if (*p == '\0') break;
+    if (count == COMMAND_MAX_ARGS + 2) return false;  // too many tokens
+    tokens[count++] = p;
+    while (*p != '\0' && *p != ' ' && *p != '\t') p++;
+  }
+  if (count == 0) return false;
+
+  int first = 0;
+  if (tokens[0][0] == '#') {
+    long id;
+    if (!parseNumber(tokens[0] + 1, id) || id < 0) return false;
+    cmd.id = id;
+    first = 1;
+    if (count == 1) return false;  // id without a command
+  }
+  if (first == 0 && count == 1 && parseNumber(tokens[0], cmd.number)) {
+    cmd.plainNumber = true;
+    return true;
+  }
+  if (count - first - 1 > COMMAND_MAX_ARGS) return false;  // too many arguments
+  cmd.name = tokens[first];
+  for (int i = first + 1; i < count; i++) cmd.args[cmd.argc++] = tokens[i];
+  return true;
+}
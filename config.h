@@ -10,14 +10,38 @@ To activate one of the following debugging modes, you can either:
 - Change STARTDEBUG here in the code and compile again or
 - Compile and upload your program. Change to the serial monitor and type the number and hit enter to select the debug mode.
 
+Besides the plain number of the debug mode, requests with an id are understood and answered in one line, see commandParser.h:
+  #<id> debug <mode>        select the debug mode
+  #<id> zero                zero the spacemouse, like debug mode 11
+  #<id> stats               report the statistics of the sampling, the telemetry and the serial interface
+  #<id> get <parameter>     report a parameter, e.g. sens_rotx, gate_rotz or modfunc
+  #<id> set <parameter> <value>   change a parameter until the next reset
+  #<id> telemetry <mask>    stream the telemetry taps of the bit mask as binary frames, 0 stops it, see TELEMETRY
+The answer is "#<id> ok ..." or "#<id> err <reason>".
+
 Debug Modes:
 ------------
 -1: Debugging off. Set to this once everything is working.
 0:  Nothing...
 
-1:  Output raw joystick values. 0-analogMax_Resolution raw ADC 10-bit values
+1:  Output raw joystick values. 0-SENSOR_MAX oversampled ADC values
 11: Calibrate / Zero the Spacemouse and get a dead-zone suggestion (This is also done on every startup in the setup())
 12: semi-automatic min-max calibration. (Replug/reset the mouse, to enable the semi-automatic calibration for a second time.)
+13: Run the benchmarks and report the cycles needed by the different implementations, see benchmark.h
+14: Report min, mean, p99 and max time of every stage of the loop() since the last report, see PROFILER
+15: Report the center points, the noise (standard deviation) and the adaptive deadzone of each sensor
+16: Guided calibration of the decoupling matrix, see KINEMATIC_MATRIX
+30: Dump the flight recorder as binary blob. Convert it with tools/flightrecorder_decode.py
+31: Clear and rearm the flight recorder
+32: Record a trace of the sensors and keys for the replay, see TRACE_REPLAY
+33: Upload a trace, see tools/trace_tool.py
+34: Replay the trace and report the CRC-32 of the HID reports and the replay speed
+35: Replay the trace and send the log of the HID reports as binary blob
+36: Send the trace as binary blob
+37: Replay the trace with and without ONE_EURO and report the step response latency and jitter (needs ONE_EURO 1)
+40: Export the calibration as binary blob, see tools/calibration_tool.py
+41: Import a calibration blob and save it in the calibration store
+42: Erase the calibration store, the values of this file are used after the next reset
 20: print send usb Payload (trans and rot)
 21: print send usb Payload (trans)
 22: print send usb Payload (rot)
@@ -99,6 +123,65 @@ If you have mounted the magnets upside-down, the values will be inverted.
 #define analogRead_Resolution 12
 #define analogMax_Resolution 4096
 
+/* ADC acquisition
+==================
+The hall effect sensors are scanned in the background by the ADC, independent of how long the rest of the loop() takes.
+The loop() only picks up the newest complete frame of all eight sensors.
+ADC_CONTINUOUS 1 uses the DMA driven continuous mode of the ESP32. This only works, if all pins of the PINLIST belong to ADC1.
+If the continuous mode can't be started, the sensors are read one after another with analogRead(). Every read of the sensors
+then takes all scans, which are due at ADC_SAMPLE_RATE_HZ since the last read, but at most OVERSAMPLING_RATIO. Therefore,
+the frame rate stays the same, but without the SAMPLING_TASK, the loop() is blocked by up to OVERSAMPLING_RATIO scans.
+*/
+#define ADC_CONTINUOUS 1
+#define ADC_SAMPLE_RATE_HZ 4000      // complete scans of all eight sensors per second (max. approx 10000 on the ESP32-S3)
+#define ADC_CONVERSIONS_PER_PIN 1    // conversions per sensor, which are averaged by the driver into one scan
+
+/* Oversampling
+===============
+OVERSAMPLING_RATIO = 4^OVERSAMPLING_BITS scans are summed up and decimated into one frame, which gains
+OVERSAMPLING_BITS of effective resolution. With 12 bit ADC values and OVERSAMPLING_BITS 2, the sensors deliver 14 bit values.
+All calibration values in this file (DEADZONE, MINVALS, MAXVALS, ...) stay in the units of the 12 bit ADC,
+they are scaled automatically with SENSOR_SCALE.
+The rate of the frames is ADC_SAMPLE_RATE_HZ / OVERSAMPLING_RATIO.
+*/
+#define OVERSAMPLING_BITS 2  // 0 ... 4
+
+#define OVERSAMPLING_RATIO (1 << (2 * OVERSAMPLING_BITS))
+#define SENSOR_RESOLUTION (analogRead_Resolution + OVERSAMPLING_BITS)
+#define SENSOR_SCALE (1 << OVERSAMPLING_BITS)
+#define SENSOR_MAX (analogMax_Resolution * SENSOR_SCALE)
+#if (SENSOR_RESOLUTION > 16)
+#error "The oversampled sensor values must not exceed 16 bit"
+#endif
+
+/* Sampling task
+================
+With SAMPLING_TASK 1 the sensors are read, filtered and centered in a separate high priority task on SAMPLING_CORE.
+The task is triggered by a hardware timer every SAMPLING_PERIOD_US and hands the frames over to the loop() via a lock-free queue.
+Therefore, blocking display, LED or serial output in the loop() doesn't disturb the timing of the sensors anymore.
+The loop() runs on core 1, so the sampling task should run on core 0.
+Use debug mode 7 to see the number of frames and overruns of the queue.
+*/
+#define SAMPLING_TASK 1
+#define SAMPLING_CORE 0
+#define SAMPLING_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+#define SAMPLING_TASK_STACK 4096
+#define SAMPLING_PERIOD_US (1000000 / ADC_SAMPLE_RATE_HZ)  // one period per scan of the ADC
+#define SENSORQUEUE_LENGTH 16                              // frames, must be a power of two
+
+/* Kalman filter
+================
+All sensors are smoothed by a fixed point Kalman filter, see kalmanBank.h.
+With KALMAN_STEADYSTATE 1 the gain of each sensor is frozen, once it has converged. This saves a lot of computation,
+but the filter doesn't become slower and slower while the knob is not moved, like the original filter does.
+The gain only freezes on quiet sensors: with a noise of about +/-8 counts and more, it keeps moving by more than KALMAN_SS_EPSILON.
+Use debug mode 13 to compare the speed of the filters.
+*/
+#define KALMAN_STEADYSTATE 0
+#define KALMAN_SS_EPSILON 1      // max. change of the gain (in 1/32768) to be regarded as converged
+#define KALMAN_SS_SAMPLES 500    // number of updates, the gain has to be converged before it is frozen
+#define KALMAN_SS_MIN_GAIN 0.05  // the frozen gain is never smaller than this value
+
 // AX, AY, BX, BY, CX, CY, DX, DY
 #define PINLIST \
   { HES1_PIN, HES2_PIN, HES3_PIN, HES4_PIN, HES5_PIN, HES6_PIN, HES7_PIN, HES8_PIN }
@@ -136,6 +219,34 @@ Manual:         Set debug = 2.  Don't touch the mouse but observe the values. Th
 #define MINMAX_MINWARNING (100 - centerPoint)
 #define MINMAX_MAXWARNING (100 + centerPoint)
 
+/* Calibration store
+====================
+With CALIBSTORE 1, all calibration values (MINVALS, MAXVALS, sensitivities, gates, MODFUNC, INVERTLIST and the center points)
+are stored in the flash of the ESP32 and loaded during startup. The values in this file are only used as long as nothing has been stored.
+The store is updated by the zeroing (debug mode 11) and by the min-max calibration (debug mode 12).
+When the center points are loaded from the store, the zeroing during startup is skipped.
+Use debug mode 40/41 to export/import the calibration and 42 to erase it. The import keeps the own center points of the unit.
+*/
+#define CALIBSTORE 1
+#define CALIB_IMPORT_TIMEOUT_MS 5000  // time to wait for the blob in debug mode 41
+
+/* Idle re-zeroing and adaptive deadzone
+========================================
+If all sensors stay within their deadzone for AUTOZERO_IDLE_MS, the knob is regarded as idle. This is the adaptive deadzone
+of each sensor, which is also applied to the output, so any motion, which reaches the host, prevents the re-zeroing.
+While idle, the center points slowly follow the sensors to remove thermal drift without replugging.
+Additionally, the noise of every sensor is measured and the deadzone of each sensor is set to AUTOZERO_SIGMA times
+its standard deviation, but never larger than DEADZONE and never smaller than AUTOZERO_MIN_DEADZONE.
+A push below the adaptive deadzone looks like drift and is zeroed away, test/auto_zero.cpp measures how often this happens.
+Use debug mode 15 to observe it.
+*/
+#define AUTOZERO 1
+#define AUTOZERO_IDLE_MS 2000      // time without motion, before the knob is regarded as idle
+#define AUTOZERO_SHIFT 10          // every idle frame moves the center point by 1/2^AUTOZERO_SHIFT of the difference
+#define AUTOZERO_MIN_SAMPLES 500   // idle frames needed, before the deadzone is adapted
+#define AUTOZERO_SIGMA 4.0         // adaptive deadzone in multiples of the standard deviation
+#define AUTOZERO_MIN_DEADZONE 5    // lower limit of the adaptive deadzone
+
 /* Third calibration: Getting MIN and MAX values
 ================================================
 Can be done manual (debug = 2) or semi-automatic (debug = 20)
@@ -223,6 +334,10 @@ Recommended calibration procedure for sensitivity
 #define ROTX_SENSITIVITY 1.0
 #define ROTY_SENSITIVITY 1.0
 #define ROTZ_SENSITIVITY 1.0
+// limits of the sensitivities and gates, which are accepted by the "set" command and from a stored calibration
+#define SENSITIVITY_MIN 0.01
+#define SENSITIVITY_MAX 100
+#define GATE_MAX 350
 
 /* Fifth calibration: Modifier Function
 =======================================
@@ -237,10 +352,19 @@ This should be at level 0 when starting the calibration!
 2: tangent function: y = tan(x) [Results in a linear curve near zero but increases the more you are away from zero]
 3: squared tangent function: y = tan(x^2*sign(X)) [Results in a flatter curve near zero but increases a lot the more you are away from zero]
 4: cubed tangent function: y = tan(x^3) [Results in a very flat curve near zero but increases drastically the more you are away from zero]
+5: user defined cubic Bezier curve from (0,0) to (1,1) with the control points MODFUNC_BEZIER {x1, y1, x2, y2}, like the CSS cubic-bezier()
+6: user defined spline through the points MODFUNC_SPLINE, which are equally spaced between x = 0 and x = 1 (first point at x = 0, last point at x = 1)
+
+All curves are calculated by the compiler as lookup tables (see modifierLut.h), so the choice has no influence on the speed.
+The curves are mirrored for negative values. For TRANSZ, the positive half is always linear.
 
 Recommendation after tuning: MODFUNC 3
 */
 #define MODFUNC 2  // Used as default value as long as the data hasn't been saved in the EEPROM
+#define MODFUNC_BEZIER \
+  { 0.5, 0.0, 0.8, 0.5 }
+#define MODFUNC_SPLINE \
+  { 0.0, 0.1, 0.25, 0.5, 1.0 }
 
 /* Sixth Calibration: Direction
 ===============================
@@ -260,6 +384,73 @@ The suggestion in the comments for "3Dc" are often needed on windows PCs with 3d
 // Switch Zoom direction with Up/Down Movement
 #define SWITCHYZ 0  // change to 1 to switch Y and Z axis
 
+/* Seventh (optional) Calibration: Decoupling matrix
+====================================================
+The six velocities are calculated from the eight sensors by a 6x8 matrix in fixed point (Q12, 4096 = 1.0).
+Rows: TRANSX, TRANSY, TRANSZ, ROTX, ROTY, ROTZ. Columns: HES0, HES1, HES2, HES3, HES6, HES7, HES8, HES9.
+The default matrix gives exactly the same result as the sum/difference formula in kinematics.h.
+
+On real units, a movement along one axis often leaks into the other axes. Instead of fighting this with the GATE_ values,
+you can fit the matrix to your unit with debug mode 16:
+1. Type 16 and follow the instructions on the serial interface. The knob is moved through all movements of the
+   movement table in kinematics.h: every movement is announced, then you have KINEMATIC_FIT_PREPARE_MS to move the knob
+   and hold it for KINEMATIC_FIT_COLLECT_MS. Move the knob as far as possible and as clean as possible.
+2. The matrix is fitted by least squares and used immediately. It is printed, so you can copy it in here, and kept in the calibration store.
+KINEMATIC_FIT_RIDGE pulls the fitted matrix towards the matrix below, which makes the fit robust against sloppy movements.
+
+KINEMATIC_MATRIX 0 uses the hardcoded formula instead.
+*/
+#define KINEMATIC_MATRIX 1
+#define KINEMATIC_MATRIX_VALUES \
+  { { -2048, 2048, 0, 0, 2048, -2048, 0, 0 }, \
+    { 0, 0, 2048, -2048, 0, 0, -2048, 2048 }, \
+    { 1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024 }, \
+    { 2048, 2048, 0, 0, -2048, -2048, 0, 0 }, \
+    { 0, 0, -2048, -2048, 0, 0, 2048, 2048 }, \
+    { 1024, -1024, 1024, -1024, 1024, -1024, 1024, -1024 } }
+#define KINEMATIC_FIT_PREPARE_MS 3000  // time to move the knob into the announced position
+#define KINEMATIC_FIT_COLLECT_MS 2000  // time to hold the position, while the samples are collected
+#define KINEMATIC_FIT_RIDGE 0.01       // regularization towards KINEMATIC_MATRIX_VALUES, relative to the mean sensor energy
+
+/* Fixed point pipeline
+=======================
+FIXED_PIPELINE 1 calculates the deadzone, the mapping, the matrix, the sensitivities and the modifier function in one fixed point
+pipeline (Q16.16, see fixedPipeline.h). The fractions are kept until the final HID value, instead of truncating after every step,
+and there are no divisions left. The results differ from FIXED_PIPELINE 0 by up to one step of the modifier curve, because the
+original steps truncate the input of the curve: 1 count with the linear curve, up to 5 counts with the steep ones.
+The deviations are checked on the host by test/fixed_sweep.cpp, the cycles of both pipelines are reported by the benchmarks (debug mode 13).
+*/
+#define FIXED_PIPELINE 0
+
+/* Fused pipeline
+=================
+FUSED_PIPELINE 1 does all steps from the deadzone to the exclusive mode (including the kill-keys and SWITCHYZ) in a single sweep,
+see fusedPipeline.h. The results are exactly the same as with FIXED_PIPELINE alone. While the debug modes 4, 5 and 6 are active,
+the single steps are used instead, so these modes still show the velocities between the steps.
+The deviation from the original steps (golden output) is reported by the benchmarks (debug mode 13). Needs FIXED_PIPELINE 1.
+Every variant of SWITCHYZ, EXCLUSIVEMODE and the kill-keys is checked on the host by test/fixed_sweep.cpp.
+*/
+#define FUSED_PIPELINE 0
+#if (FUSED_PIPELINE > 0 && FIXED_PIPELINE == 0)
+#error "FUSED_PIPELINE needs FIXED_PIPELINE 1"
+#endif
+
+/* Velocity smoothing
+=====================
+ONE_EURO 1 smooths the final velocities with an adaptive low pass (one-euro filter, see oneEuro.h): the cutoff frequency rises
+from ONE_EURO_MINCUTOFF with the speed of the change (times ONE_EURO_BETA). A held or slowly moved knob is smoothed strongly
+against jitter, a fast movement only a little against lag. A velocity of zero is passed through without delay.
+Lower MINCUTOFF: less jitter at rest. Higher BETA: less lag at speed.
+Compare the settings with debug mode 37 on a recorded trace (step response latency and jitter, see TRACE_REPLAY), before
+using the smoothing: it changes the HID output. Debug mode 37 needs ONE_EURO 1, it replays the trace with and without it.
+*/
+#define ONE_EURO 0
+#define ONE_EURO_MINCUTOFF_TRANS 5.0  // Hz
+#define ONE_EURO_BETA_TRANS 0.05      // Hz per velocity count/s
+#define ONE_EURO_MINCUTOFF_ROT 5.0    // Hz
+#define ONE_EURO_BETA_ROT 0.05        // Hz per velocity count/s
+#define ONE_EURO_DCUTOFF 1.0          // Hz, cutoff for the speed of the change
+
 
 
 
@@ -321,6 +512,86 @@ How many keys reported? Classical + ROTARY_KEYS in total.
 #define BUTTONLIST \
   { SM_LEFT, SM_RIGHT }
 
+/* Combined HID report
+======================
+By default, the translation is sent in report 1 and the rotation in report 2, each in its own HIDUPDATERATE_MS slot, like the
+older SpaceMouse devices. So a full update of all six axis needs two slots and translation and rotation are from different times.
+HID_COMBINED_REPORT 1 sends all six axis in one report 1 with 12 bytes, like the newer 3Dconnexion devices. This halves the
+number of reports and the latency. Use the split mode (0) for older versions of 3DxWare, which don't understand it.
+HID_COMBINED_BUTTONS 1 also puts the buttons into report 1 (14 bytes), instead of sending them in report 3.
+Both can be overridden by the compiler, e.g. -DHID_COMBINED_REPORT=1, so the host tests check every mode.
+*/
+#ifndef HID_COMBINED_REPORT
+#define HID_COMBINED_REPORT 0
+#endif
+#ifndef HID_COMBINED_BUTTONS
+#define HID_COMBINED_BUTTONS 0
+#endif
+
+/* HID transport
+================
+HID_TRANSPORT selects, how the HID reports are sent to the host:
+HID_TRANSPORT_USB: USB HID (default)
+HID_TRANSPORT_BLE: Bluetooth LE, HID over GATT, see bluetooth.h. The serial interface stays on the USB.
+The reports are built independent of the transport, see hidTransport.h
+*/
+#define HID_TRANSPORT_USB 0
+#define HID_TRANSPORT_BLE 1
+#define HID_TRANSPORT HID_TRANSPORT_USB
+
+// BLE: While there is motion, the shortest connection interval BLE_FAST_INTERVAL is requested from the host, after BLE_IDLE_MS
+// without motion the slower BLE_IDLE_INTERVAL. Both in units of 1.25 ms, the host may choose up to twice the value.
+// The reports are collected and sent with up to BLE_MAX_NOTIFY_PER_EVENT notifications per connection event.
+// HID_COMBINED_REPORT 1 and HID_COMBINED_BUTTONS 1 need only one notification for translation, rotation and buttons.
+// The interval, the rate and the dropped and congested notifications are reported by debug mode 7 and the "stats" command.
+#define BLE_FAST_INTERVAL 6          // 7.5 ms, the shortest interval of BLE
+#define BLE_IDLE_INTERVAL 24         // 30 ms
+#define BLE_IDLE_MS 2000
+#define BLE_MAX_NOTIFY_PER_EVENT 3
+#define BLE_SUPERVISION_TIMEOUT 400  // 4 s, in units of 10 ms
+
+/* HID transmit scheduler
+=========================
+HID.SendReport() waits until the host has fetched the report, so a slow or suspended host stalls the loop().
+HID_SCHEDULER 1 posts the reports instead into one slot per report id, a newer report replaces the pending one (latest value wins).
+The scheduler sends the oldest pending report as soon as the previous one is completed and HID_MIN_INTERVAL_US have passed.
+It runs in its own task with HID_SCHEDULER_TASK_PRIORITY on HID_SCHEDULER_CORE, which is woken by every posted report
+and checks the endpoint once per ms while reports are pending, so a long loop() (e.g. the display) doesn't delay the reports.
+So the host always gets the freshest values. The interval can be lowered down to 1000 us (1 ms, the fastest USB full speed polling).
+A pending report is kept until the endpoint takes it, even if the host is suspended, so the last state always reaches the host.
+Reports, which were pending longer than HID_MAX_AGE_US, are counted as stale.
+The counters for sent, coalesced, dropped and stale reports and the latency are reported by debug mode 7 and the "stats" command.
+*/
+#define HID_SCHEDULER 1
+#define HID_MIN_INTERVAL_US (HIDUPDATERATE_MS * 1000)
+#define HID_MAX_AGE_US 100000
+#define HID_SCHEDULER_CORE 1
+#define HID_SCHEDULER_TASK_PRIORITY (configMAX_PRIORITIES - 3)  // below the sampling task
+#define HID_SCHEDULER_TASK_STACK 3072
+
+/* HID report coalescing
+========================
+Without coalescing, the reports are sent whenever any axis is not zero, even if the values didn't change.
+HID_COALESCE 1 compares every report with the last sent one of the same id and suppresses it, unless
+- the change of an axis reaches its threshold in HID_SIGNIFICANCE (x, y, z, rx, ry, rz in HID counts, 1 = every change), or
+- the last sent report is older than HID_MAX_STALE_MS, or
+- it is the first zero report after a motion or the first report with motion after the zeros.
+Changed buttons are always sent. This cuts the bus traffic and the interrupts of the host during slow and steady motion.
+The share of suppressed reports is reported by debug mode 7 and the "stats" command.
+Some drivers move by a fixed step per received report: if the motion gets slower with it, use 0.
+*/
+#define HID_COALESCE 0
+#define HID_SIGNIFICANCE \
+  { 1, 1, 1, 1, 1, 1 }
+#define HID_MAX_STALE_MS 50
+
+/* Latency probe
+================
+LATENCY_PROBE 1 adds a vendor specific output and feature report 5 to measure the latency from the sensors to the host.
+The host writes a probe id and reads the echo with the timestamps of the device, see latencyProbe.h and tools/latency_probe.py
+*/
+#define LATENCY_PROBE 1
+
 /* Exclusive mode
 =================
 Exclusive mode only permit to send translation OR rotation, but never both at the same time.
@@ -394,6 +665,40 @@ How many kill keys are there? (disabled: 0; enabled: 2)
 
 // how often shall the LEDs be updated
 #define LEDUPDATERATE_MS 20
+
+/* Power governor
+=================
+POWER_GOVERNOR 1 saves power, while the spacemouse is not used, see powerGovernor.h
+After POWER_IDLE_MS without motion (a velocity of at least POWER_WAKE_THRESHOLD or a pressed key), the device is idle:
+the sensors are only scanned every POWER_IDLE_SCAN_US, the CPU runs with POWER_IDLE_CPU_MHZ, the display is refreshed
+every POWER_IDLE_SCREEN_DELAY ms and the LEDs are dimmed to POWER_IDLE_LED_BRIGHTNESS. Every idle scan publishes a frame
+of the ADC scans since the last one, without waiting for OVERSAMPLING_RATIO scans, so the first scan with motion switches
+back to full rate. The wake latency is measured from the first ADC scan of that frame and is at most about one idle scan.
+While the host has suspended the USB, the device scans every POWER_SUSPENDED_SCAN_US and the display and LEDs are off.
+Debug modes and the telemetry keep the device active.
+The state and the wake latency are reported by debug mode 7 and the "stats" command.
+*/
+#define POWER_GOVERNOR 1
+#define POWER_IDLE_MS 5000
+#define POWER_WAKE_THRESHOLD 1
+#define POWER_ACTIVE_CPU_MHZ 240
+#define POWER_ACTIVE_LED_BRIGHTNESS 200
+#define POWER_IDLE_SCAN_US 20000        // 50 Hz
+#define POWER_IDLE_CPU_MHZ 80           // the USB needs at least 80 MHz
+#define POWER_IDLE_SCREEN_DELAY 500
+#define POWER_IDLE_LED_BRIGHTNESS 40
+#define POWER_SUSPENDED_SCAN_US 100000  // 10 Hz
+
+/* Display renderer
+===================
+SCREEN_DIRTY_RENDER 1 keeps the values on the display and redraws only the characters, which have changed, see screenDirty.h
+Only the changed tiles (8x8 pixels) are sent over the I2C, instead of the whole 512 byte frame on every refresh.
+The transfer of a frame stops after SCREEN_FRAME_BUDGET_US, the remaining tiles are sent with the next refresh.
+The bytes sent per second are reported by debug mode 7 and the "stats" command.
+SCREEN_DIRTY_RENDER 0 redraws and sends the whole frame on every refresh.
+*/
+#define SCREEN_DIRTY_RENDER 1
+#define SCREEN_FRAME_BUDGET_US 2000
 /* Advanced debug output settings
 =================================
 The following settings allow customization of debug output behavior 
@@ -402,11 +707,63 @@ The following settings allow customization of debug output behavior
 // Generate a debug line only every DEBUGDELAY ms
 #define DEBUGDELAY 100
 
+// A command line without line ending is complete after COMMAND_IDLE_MS without a new byte, see commandParser.h
+#define COMMAND_IDLE_MS 50
+
 // The standard behavior "\r" for the debug output is, that the values are always written into the same line to get a clean output. Easy readable for the human.
 // #define DEBUG_LINE_END "\r"
 // If you need to report some debug outputs to trace errors, you can change the debug output to "\r\n" to get a newline with each debug output. (old behavior)
 #define DEBUG_LINE_END "\r\n"
 
+/* Profiler
+===========
+PROFILER 1 measures the cpu cycles of every stage of the loop() (sensors, centering, filter, kinematics, keys, smoothing,
+display, sendUSBData, sendBattery, LEDs) and collects them in histograms, see profiler.h.
+Debug mode 14 reports min, mean, p99 and max of every stage as table and starts a new measurement.
+With PROFILER 0 the measurement is not compiled at all. It costs cycles and about 9 KB of RAM, so it is off by default.
+*/
+#define PROFILER 0
+
+/* Telemetry
+============
+TELEMETRY 1 adds taps to the processing, which stream their values at the full loop rate as compact binary frames
+(difference and varint encoded, COBS framed), see telemetry.h. Subscribe with the command "telemetry <mask>", the mask is the sum of the taps:
+  1: raw, 2: centered, 4: deadzoned, 8: velocity, 16: after the kill-keys, 32: after the exclusive mode, 64: HID reports
+e.g. "telemetry 34" for the centered values and the final velocities. "telemetry 0" stops the stream.
+The answer is sent before the stream starts. While the stream is running, the debug mode is off and all other commands are
+ignored, so no text gets into the binary frames.
+tools/telemetry_decode.py subscribes and converts the stream into CSV. A tap, which is not subscribed, costs one branch.
+Every tap sends a keyframe with absolute values every TELEMETRY_KEYFRAME_INTERVAL frames.
+*/
+#define TELEMETRY 1
+#define TELEMETRY_KEYFRAME_INTERVAL 256
+
+/* Flight recorder
+==================
+The flight recorder keeps the last FLIGHTRECORDER_DEPTH samples of rawReads, centered, velocity and keys in the RAM.
+It is triggered by pressing both HID keys, by a jump of any velocity larger than FLIGHTRECORDER_JUMP between two samples,
+or manually with debug mode 30. After a trigger, FLIGHTRECORDER_POSTTRIGGER samples are recorded and then it freezes.
+Use debug mode 30 to get the content and debug mode 31 to rearm it.
+*/
+#define FLIGHTRECORDER 1
+#define FLIGHTRECORDER_DEPTH 512        // samples, 52 bytes of RAM each, dumped as 50 bytes
+#define FLIGHTRECORDER_POSTTRIGGER 128  // samples recorded after the trigger
+#define FLIGHTRECORDER_JUMP 200         // velocity jump between two samples, which is regarded as anomaly
+
+/* Trace replay
+===============
+A trace holds TRACE_MAX_FRAMES frames of the ADC with their timestamps and the raw keys. It is recorded with debug mode 32,
+or uploaded with debug mode 33. Debug mode 34 replays the trace through the complete processing (filters, pipeline, keys and
+sendUSBData()) with the time of the trace instead of the real time. The HID reports are not sent, but collected in a report log.
+Debug mode 34 reports the CRC-32 of this log and the replay speed, debug mode 35 sends the whole log to compare it bit by bit
+against a golden output. Debug mode 36 sends the trace. See tools/trace_tool.py
+The sendUSBData() is called every TRACE_LOOP_PERIOD_US of the trace time, like the loop() would do.
+*/
+#define TRACE_REPLAY 1
+#define TRACE_MAX_FRAMES 1024         // frames, 24 bytes of RAM each
+#define TRACE_LOOP_PERIOD_US 1000     // virtual period of the loop() during the replay
+#define TRACE_UPLOAD_TIMEOUT_MS 2000  // the upload is aborted, if no byte is received for this time
+
 
 
 
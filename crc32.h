@@ -0,0 +1,23 @@
+// CRC-32 (IEEE 802.3, as used by zlib), used to protect binary data sent over the serial interface or stored in the flash.
+// Bitwise implementation without table to save memory, it is not used in the hot path.
+#ifndef CRC32_H
+#define CRC32_H
+#include <stdint.h>
+#include <stddef.h>
+
+/// @brief Continue a CRC-32 over a block of data
+/// @param crc result of the previous block, or 0 for the first block
+/// @param data pointer to the data
+/// @param len number of bytes
+/// @return CRC-32 of all blocks so far
+inline uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+#endif
@@ -0,0 +1,150 @@
+// This file contains the fixed point processing pipeline from the centered sensor values to the HID values, see FIXED_PIPELINE in config.h
+// It replaces FilterAnalogReadOuts() and calculateKinematic(), which mix long map() divisions, float divisions by the sensitivities
+// and truncations after every step.
+// All values are kept in Q16.16 with saturating arithmetic until the final int16 HID value is rounded, so the fractions of the
+// mapping, the matrix and the sensitivities are not lost. The modifier curve is interpolated between its table entries.
+// The slopes of the mapping and the reciprocals of the sensitivities are precalculated, so there is no division in the hot path.
+// They are calculated again automatically, when the deadzones, min/max values or sensitivities have been changed.
+
+#ifndef FIXEDPIPELINE_H
+#define FIXEDPIPELINE_H
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include "kinematics.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define FP_SHIFT 16
+#define FP_MAX INT32_MAX
+#define FP_MIN (-INT32_MAX)  // symmetric, so every value can be negated
+
+/// @brief Limit a 64 bit intermediate result to Q16.16
+static inline int32_t fpSaturate(int64_t x) {
+  return (x > FP_MAX) ? FP_MAX : ((x < FP_MIN) ? FP_MIN : (int32_t)x);
+}
+
+/// @brief Round a Q16.16 value to the nearest integer, halves away from zero
+static inline int32_t fpRound(int32_t x) {
+  return (x >= 0) ? ((x + 0x8000) >> FP_SHIFT) : -((-x + 0x8000) >> FP_SHIFT);
+}
+
+/// @brief Convert a double into Q16.16, used only for the precalculation
+static inline int32_t fpFromDouble(double x) {
+  return fpSaturate((int64_t)llround(x * (1 << FP_SHIFT)));
+}
+
+class FixedPipeline {
+public:
+  /// @brief Apply the deadzone of each sensor and map the values to +/- TOTALSENSITIVITY, like FilterAnalogReadOuts()
+  /// @param centered pointer to 8 centered values. They are replaced by the rounded result for the debug outputs.
+  /// @param mapped pointer to 8 results in Q16.16 for calculateKinematic()
+  void filter(int* centered, int32_t* mapped) {
+    prepareIfChanged();
+    for (int i = 0; i < 8; i++) {
+      mapped[i] = mapSensor(i, centered[i]);
+      centered[i] = fpRound(mapped[i]);
+    }
+  }
+
+  /// @brief Calculate the velocities from the mapped values, like calculateKinematic()
+  /// @param mapped pointer to 8 values in Q16.16 from filter()
+  /// @param velocity resulting translational and rotational motions
+  void kinematic(const int32_t* mapped, int16_t* velocity) {
+    for (int axis = 0; axis < 6; axis++) {
+      // decoupling matrix in Q12
+      int64_t sum = 0;
+      for (int i = 0; i < 8; i++) {
+        sum += (int64_t)matrix()[axis][i] * mapped[i];
+      }
+      velocity[axis] = finishAxis(axis, sum);
+    }
+  }
+
+  // The single steps of the pipeline, which are also used by the fused pipeline, see fusedPipeline.h
+
+  /// @brief Apply the deadzone and map one sensor. Call prepareIfChanged() once before.
+  /// @param i number of the sensor
+  /// @param c centered value
+  /// @return mapped value in Q16.16
+  inline int32_t mapSensor(int i, int32_t c) const {
+    if (c < deadzone[i] && c > -deadzone[i]) {
+      return 0;
+    } else if (c < 0) {
+      return fpSaturate((int64_t)(c + deadzone[i]) * slopeNeg[i]);
+    } else {
+      return fpSaturate((int64_t)(c - deadzone[i]) * slopePos[i]);
+    }
+  }
+
+  /// @brief Apply the sensitivity, the modifier function, the gate and the direction of one axis
+  /// @param axis TRANSX ... ROTZ
+  /// @param sum sum of the matrix products in Q16.16 * Q12
+  /// @return HID value of the axis
+  inline int16_t finishAxis(int axis, int64_t sum) const {
+    int32_t v = fpSaturate(sum >> KINEMATIC_Q);
+    int32_t out;
+    if (axis == TRANSZ) {
+      v = fpSaturate(((int64_t)v * reciprocal[(v < 0) ? SENS_NEG_TRANSZ : SENS_POS_TRANSZ]) >> FP_SHIFT);
+      out = fpRound(getModifierCurve(modFunc, true).applyQ16(v));
+      if (out < 0 && -out < gates[GATEIDX_NEG_TRANSZ]) out = 0;
+    } else {
+      v = fpSaturate(((int64_t)v * reciprocal[axisSensitivity[axis]]) >> FP_SHIFT);
+      out = fpRound(getModifierCurve(modFunc, false).applyQ16(v));
+      if (axisGate[axis] >= 0 && abs(out) < gates[axisGate[axis]]) out = 0;
+    }
+    return out * axisDirection[axis];
+  }
+
+  static const int16_t (*matrix())[8] {
+#if KINEMATIC_MATRIX > 0
+    return kinematicMatrix;
+#else
+    return defaultKinematicMatrix;
+#endif
+  }
+
+  /// @brief Precalculate the slopes and reciprocals, if the settings have been changed since the last call
+  void prepareIfChanged() {
+    if (prepared && memcmp(deadzone, deadzones, sizeof(deadzone)) == 0 && memcmp(minSnapshot, minVals, sizeof(minSnapshot)) == 0
+        && memcmp(maxSnapshot, maxVals, sizeof(maxSnapshot)) == 0 && memcmp(sensSnapshot, sensitivities, sizeof(sensSnapshot)) == 0) {
+      return;
+    }
+    memcpy(deadzone, deadzones, sizeof(deadzone));
+    memcpy(minSnapshot, minVals, sizeof(minSnapshot));
+    memcpy(maxSnapshot, maxVals, sizeof(maxSnapshot));
+    memcpy(sensSnapshot, sensitivities, sizeof(sensSnapshot));
+    for (int i = 0; i < 8; i++) {
+      // map [min, -deadzone] to [-TOTALSENSITIVITY, 0] and [deadzone, max] to [0, TOTALSENSITIVITY]
+      int32_t negRange = -deadzone[i] - minVals[i] * SENSOR_SCALE;
+      int32_t posRange = maxVals[i] * SENSOR_SCALE - deadzone[i];
+      slopeNeg[i] = (negRange > 0) ? fpFromDouble((double)TOTALSENSITIVITY / negRange) : 0;
+      slopePos[i] = (posRange > 0) ? fpFromDouble((double)TOTALSENSITIVITY / posRange) : 0;
+    }
+    for (int i = 0; i < 7; i++) {
+      reciprocal[i] = (sensitivities[i] > 0) ? fpFromDouble(1.0 / (sensitivities[i] * SENSOR_SCALE)) : 0;
+    }
+    prepared = true;
+  }
+
+private:
+  // sensitivity, gate and direction of each axis
+  static constexpr uint8_t axisSensitivity[6] = { SENS_TRANSX, SENS_TRANSY, SENS_POS_TRANSZ, SENS_ROTX, SENS_ROTY, SENS_ROTZ };
+  static constexpr int8_t axisGate[6] = { -1, -1, GATEIDX_NEG_TRANSZ, GATEIDX_ROTX, GATEIDX_ROTY, GATEIDX_ROTZ };
+  static constexpr int8_t axisDirection[6] = { INVX > 0 ? -1 : 1, INVY > 0 ? -1 : 1, INVZ > 0 ? -1 : 1,
+                                               INVRX > 0 ? -1 : 1, INVRY > 0 ? -1 : 1, INVRZ > 0 ? -1 : 1 };
+
+  bool prepared = false;
+  int32_t slopeNeg[8];    // TOTALSENSITIVITY per count in Q16.16
+  int32_t slopePos[8];    // TOTALSENSITIVITY per count in Q16.16
+  int32_t reciprocal[7];  // 1 / (sensitivity * SENSOR_SCALE) in Q16.16
+  int deadzone[8];        // snapshot of the settings used for the precalculation
+  int minSnapshot[8];
+  int maxSnapshot[8];
+  float sensSnapshot[7];
+};
+
+FixedPipeline fixedPipeline;
+#endif
@@ -0,0 +1,180 @@
+// This file contains the flight recorder.
+// It records the sensor values, velocities and keys of every loop() into a ring buffer in the RAM.
+// When triggered (serial command, key combo or an anomaly), it records FLIGHTRECORDER_POSTTRIGGER more samples and freezes.
+// The content can be dumped as a binary blob over the serial interface and converted to CSV with tools/flightrecorder_decode.py
+//
+// Binary format, all values little endian:
+//   header:  "SMFR", uint8 version, uint8 trigger reason, uint16 record size, uint16 number of records,
+//            uint8 sensor resolution in bits, uint8 reserved, int32 centerPoints[8]
+//   records: uint32 timestamp in us, uint16 rawReads[8], int16 centered[8], int16 velocity[6], uint8 keys, uint8 flags
+//   trailer: uint32 CRC-32 over header and records
+
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include "crc32.h"
+
+#define FLIGHTRECORDER_VERSION 1
+#define FLIGHTRECORDER_HEADER_SIZE 44
+#define FLIGHTRECORDER_RECORD_SIZE 50
+
+// reasons for the trigger
+#define FR_TRIGGER_NONE 0
+#define FR_TRIGGER_SERIAL 1
+#define FR_TRIGGER_KEYS 2
+#define FR_TRIGGER_ANOMALY 3
+
+// flags of a record
+#define FR_FLAG_TRIGGER 0x01  // this record caused the trigger
+
+struct FlightRecord {
+  uint32_t timeUs;
+  uint16_t rawReads[8];
+  int16_t centered[8];
+  int16_t velocity[6];
+  uint8_t keys;  // bit i is keyState[i]
+  uint8_t flags;
+};  // padded to 52 bytes in the RAM, the dump has FLIGHTRECORDER_RECORD_SIZE bytes per record
+
+class FlightRecorder {
+public:
+  /// @brief Store one sample. Does nothing while the recorder is frozen.
+  void record(uint32_t timeUs, const int* rawReads, const int* centered, const int16_t* velocity, const uint8_t* keyState) {
+    if (frozen) return;
+    FlightRecord& r = records[head];
+    r.timeUs = timeUs;
+    for (int i = 0; i < 8; i++) {
+      r.rawReads[i] = constrain(rawReads[i], 0, 65535);
+      r.centered[i] = constrain(centered[i], -32768, 32767);
+    }
+    for (int i = 0; i < 6; i++) {
+      r.velocity[i] = velocity[i];
+    }
+    r.keys = 0;
+    for (int i = 0; i < NUMKEYS && i < 8; i++) {
+      if (keyState[i]) r.keys |= (1 << i);
+    }
+    r.flags = 0;
+
+    // check the automatic triggers
+    if (reason == FR_TRIGGER_NONE) {
+#if NUMHIDKEYS >= 2
+      if (keyState[0] && keyState[1]) {
+        trigger(FR_TRIGGER_KEYS);
+      }
+#endif
+      if (count > 0) {
+        const FlightRecord& prev = records[(head + FLIGHTRECORDER_DEPTH - 1) % FLIGHTRECORDER_DEPTH];
+        for (int i = 0; i < 6; i++) {
+          if (abs(r.velocity[i] - prev.velocity[i]) > FLIGHTRECORDER_JUMP) {
+            trigger(FR_TRIGGER_ANOMALY);
+            break;
+          }
+        }
+      }
+      if (reason != FR_TRIGGER_NONE) r.flags |= FR_FLAG_TRIGGER;
+    }
+
+    head = (head + 1) % FLIGHTRECORDER_DEPTH;
+    if (count < FLIGHTRECORDER_DEPTH) count++;
+    if (reason != FR_TRIGGER_NONE) {
+      if (remaining == 0) {
+        frozen = true;
+      } else {
+        remaining--;
+      }
+    }
+  }
+
+  /// @brief Trigger the recorder. It keeps on recording FLIGHTRECORDER_POSTTRIGGER samples and freezes afterwards.
+  /// @param why reason for the trigger, FR_TRIGGER_xxx
+  void trigger(uint8_t why) {
+    if (reason != FR_TRIGGER_NONE) return;  // only the first trigger counts
+    reason = why;
+    remaining = FLIGHTRECORDER_POSTTRIGGER;
+  }
+
+  /// @brief Freeze the recorder immediately, e.g. for a manual dump
+  void freeze() {
+    if (reason == FR_TRIGGER_NONE) reason = FR_TRIGGER_SERIAL;
+    frozen = true;
+  }
+
+  /// @brief Clear the buffer and start recording again
+  void rearm() {
+    head = 0;
+    count = 0;
+    remaining = 0;
+    reason = FR_TRIGGER_NONE;
+    frozen = false;
+  }
+
+  bool isFrozen() {
+    return frozen;
+  }
+
+  /// @brief Send the frozen content as binary blob, see the format at the top of this file
+  /// @param out stream to write to, usually SERIAL
+  /// @param centerPoints pointer to the 8 center points, which are stored in the header
+  void dump(Stream& out, const int* centerPoints) {
+    uint8_t buf[FLIGHTRECORDER_RECORD_SIZE > FLIGHTRECORDER_HEADER_SIZE ? FLIGHTRECORDER_RECORD_SIZE : FLIGHTRECORDER_HEADER_SIZE];
+    uint8_t* p = buf;
+    *p++ = 'S';
+    *p++ = 'M';
+    *p++ = 'F';
+    *p++ = 'R';
+    *p++ = FLIGHTRECORDER_VERSION;
+    *p++ = reason;
+    p = putLE(p, FLIGHTRECORDER_RECORD_SIZE, 2);
+    p = putLE(p, count, 2);
+    *p++ = SENSOR_RESOLUTION;
+    *p++ = 0;
+    for (int i = 0; i < 8; i++) {
+      p = putLE(p, (uint32_t)centerPoints[i], 4);
+    }
+    uint32_t crc = crc32Update(0, buf, FLIGHTRECORDER_HEADER_SIZE);
+    out.write(buf, FLIGHTRECORDER_HEADER_SIZE);
+
+    // oldest record first
+    uint16_t index = (head + FLIGHTRECORDER_DEPTH - count) % FLIGHTRECORDER_DEPTH;
+    for (uint16_t n = 0; n < count; n++) {
+      const FlightRecord& r = records[index];
+      p = putLE(buf, r.timeUs, 4);
+      for (int i = 0; i < 8; i++) p = putLE(p, r.rawReads[i], 2);
+      for (int i = 0; i < 8; i++) p = putLE(p, (uint16_t)r.centered[i], 2);
+      for (int i = 0; i < 6; i++) p = putLE(p, (uint16_t)r.velocity[i], 2);
+      *p++ = r.keys;
+      *p++ = r.flags;
+      crc = crc32Update(crc, buf, FLIGHTRECORDER_RECORD_SIZE);
+      out.write(buf, FLIGHTRECORDER_RECORD_SIZE);
+      index = (index + 1) % FLIGHTRECORDER_DEPTH;
+    }
+    putLE(buf, crc, 4);
+    out.write(buf, 4);
+    out.flush();
+  }
+
+private:
+  static uint8_t* putLE(uint8_t* p, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+      *p++ = value >> (8 * i);
+    }
+    return p;
+  }
+
+  FlightRecord records[FLIGHTRECORDER_DEPTH];
+  uint16_t head = 0;       // next record to write
+  uint16_t count = 0;      // number of valid records
+  uint16_t remaining = 0;  // samples to record after the trigger
+  uint8_t reason = FR_TRIGGER_NONE;
+  bool frozen = false;
+};
+
+FlightRecorder flightRecorder;
+
+/// @brief Serial command to dump the flight recorder (debug mode 30): freeze it, if not done yet, and send the content.
+/// @param centerPoints pointer to the 8 center points for the header
+void dumpFlightRecorder(const int* centerPoints) {
+  flightRecorder.freeze();
+  flightRecorder.dump(SERIAL, centerPoints);
+}
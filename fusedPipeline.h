@@ -0,0 +1,122 @@
+// This file contains the fused processing pipeline, see FUSED_PIPELINE in config.h
+// The stages after the centering (deadzone and mapping, decoupling matrix, sensitivity, modifier function, gates, direction,
+// kill-keys, switch of Y and Z and the exclusive mode) are done in a single sweep over the eight sensors and the six axis.
+// The build variants SWITCHYZ, EXCLUSIVEMODE and NUMKILLKEYS are policy types, which are composed into the pipeline template.
+// Therefore, the compiler removes all stages, which are not used, and there are no branches left for them at runtime.
+// The arithmetic is the one of the fixed point pipeline (fixedPipeline.h), so both give exactly the same results.
+
+#ifndef FUSEDPIPELINE_H
+#define FUSEDPIPELINE_H
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include "kinematics.h"
+#include "fixedPipeline.h"
+
+// SECTION POLICIES
+
+// Order of the axis in the output
+struct NoAxisSwap {
+  static constexpr int target(int axis) {
+    return axis;
+  }
+};
+
+// Switch position of Y and Z values, like switchYZ()
+struct SwapYZ {
+  static constexpr int target(int axis) {
+    return (axis == TRANSY) ? TRANSZ : (axis == TRANSZ) ? TRANSY
+                                     : (axis == ROTY)   ? ROTZ
+                                     : (axis == ROTZ)   ? ROTY
+                                                        : axis;
+  }
+};
+
+// Rotation and translation at the same time
+struct NoExclusive {
+  static void apply(int16_t*) {}
+};
+
+// Rotation OR translation, like exclusiveMode()
+struct ExclusiveTransRot {
+  static void apply(int16_t* velocity) {
+    exclusiveMode(velocity);
+  }
+};
+
+// No kill-keys
+struct NoKillKeys {
+  static bool killRot(const int*) {
+    return false;
+  }
+  static bool killTrans(const int*) {
+    return false;
+  }
+};
+
+// Two kill-keys, which set the rotations or the translations to zero. The keys have inverse logic due to the pull-ups.
+template<int ROT, int TRANS>
+struct KillKeys {
+  static bool killRot(const int* keyVals) {
+    return keyVals[ROT] == LOW;
+  }
+  static bool killTrans(const int* keyVals) {
+    return keyVals[TRANS] == LOW;
+  }
+};
+// !SECTION POLICIES
+
+template<class AxisSwap, class Exclusive, class Kill>
+class FusedPipeline {
+public:
+  /// @brief Calculate the velocities from the centered values in one sweep
+  /// @param centered pointer to 8 centered values. They are replaced by the mapped values for the debug outputs.
+  /// @param keyVals pointer to the raw key values for the kill-keys
+  /// @param velocity resulting translational and rotational motions, ready for the HID
+  static void run(int* centered, const int* keyVals, int16_t* velocity) {
+    fixedPipeline.prepareIfChanged();
+    const int16_t(*matrix)[8] = FixedPipeline::matrix();
+
+    // deadzone, mapping and the matrix product in one pass over the sensors
+    int64_t sum[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < 8; i++) {
+      int32_t mapped = fixedPipeline.mapSensor(i, centered[i]);
+      centered[i] = fpRound(mapped);
+      if (mapped == 0) continue;  // sensor within its deadzone, nothing to add
+      for (int axis = 0; axis < 6; axis++) {
+        sum[axis] += (int64_t)matrix[axis][i] * mapped;
+      }
+    }
+
+    // sensitivity, modifier, gate and direction in one pass over the axis. Killed axis are not calculated at all.
+    const bool killTrans = Kill::killTrans(keyVals);
+    const bool killRot = Kill::killRot(keyVals);
+    for (int axis = 0; axis < 6; axis++) {
+      bool killed = (axis < ROTX) ? killTrans : killRot;
+      velocity[AxisSwap::target(axis)] = killed ? 0 : fixedPipeline.finishAxis(axis, sum[axis]);
+    }
+    Exclusive::apply(velocity);
+  }
+};
+
+// compose the pipeline of this build
+#if SWITCHYZ > 0
+typedef SwapYZ AxisSwapPolicy;
+#else
+typedef NoAxisSwap AxisSwapPolicy;
+#endif
+
+#ifdef EXCLUSIVEMODE
+typedef ExclusiveTransRot ExclusivePolicy;
+#else
+typedef NoExclusive ExclusivePolicy;
+#endif
+
+#if (NUMKILLKEYS == 2)
+typedef KillKeys<KILLROT, KILLTRANS> KillKeyPolicy;
+#else
+typedef NoKillKeys KillKeyPolicy;
+#endif
+
+typedef FusedPipeline<AxisSwapPolicy, ExclusivePolicy, KillKeyPolicy> Pipeline;
+#endif
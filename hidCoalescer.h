@@ -0,0 +1,104 @@
+// This file contains the coalescing of the HID reports with the axis, see HID_COALESCE in config.h
+// Every candidate report is compared with the last sent report of the same id. It is only sent, if
+// - the change of at least one value reaches its significance threshold, or
+// - the last sent report is older than the max staleness, or
+// - it is the first zero report after a motion, or the first report with motion after the zeros.
+// Repeated zero reports are always suppressed. This cuts the reports during slow and steady motion.
+// There are no dependencies to the Arduino framework, so the coalescing can be tested on a host.
+
+#ifndef HIDCOALESCER_H
+#define HIDCOALESCER_H
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HID_COALESCE_SLOTS 3       // number of different report ids
+#define HID_COALESCE_MAX_VALUES 8  // six axis and two bytes of buttons
+
+class ReportCoalescer {
+public:
+  /// @param maxStaleMs a report is sent at the latest after this time, while there is motion
+  ReportCoalescer(uint32_t maxStaleMs)
+    : maxStaleMs(maxStaleMs) {
+    reset();
+  }
+
+  /// @brief Forget the last sent reports, the next report of every id is sent
+  void reset() {
+    memset(slots, 0, sizeof(slots));
+  }
+
+  /// @brief Decide, if the candidate report is sent. If so, it is remembered as last sent report.
+  /// @param id report id
+  /// @param values values of the report
+  /// @param thresholds minimum change of each value to be significant, 0 or 1 means every change
+  /// @param count number of values, at most HID_COALESCE_MAX_VALUES
+  /// @param nowMs current time in ms
+  /// @return true, if the report shall be sent
+  bool admit(uint8_t id, const int16_t* values, const int16_t* thresholds, int count, uint32_t nowMs) {
+    candidates++;
+    Slot* slot = findSlot(id);
+    if (slot == nullptr || count > HID_COALESCE_MAX_VALUES) return true;  // can't compare it, send it
+
+    bool zero = true;
+    bool significant = !slot->sent || count != slot->count;
+    for (int i = 0; i < count; i++) {
+      if (values[i] != 0) zero = false;
+      if (abs(values[i] - slot->values[i]) >= (thresholds[i] > 1 ? thresholds[i] : 1)) significant = true;
+    }
+    bool send;
+    if (zero) {
+      send = !slot->zero || !slot->sent;  // the first zero after a motion
+    } else {
+      send = significant || slot->zero || nowMs - slot->sentMs >= maxStaleMs;
+    }
+    if (!send) {
+      suppressed++;
+      return false;
+    }
+    slot->sent = true;
+    slot->zero = zero;
+    slot->count = count;
+    slot->sentMs = nowMs;
+    memcpy(slot->values, values, count * sizeof(int16_t));
+    return true;
+  }
+
+  /// @brief Share of the suppressed candidates in percent
+  float suppressionRatio() const {
+    return candidates ? 100.0f * suppressed / candidates : 0.0f;
+  }
+
+  uint32_t maxStaleMs;
+  uint32_t candidates = 0;  // reports offered to admit()
+  uint32_t suppressed = 0;  // reports, which were not sent
+
+private:
+  struct Slot {
+    bool used;
+    bool sent;  // values contains the last sent report
+    bool zero;  // the last sent report was all zero
+    uint8_t id;
+    uint8_t count;
+    uint32_t sentMs;
+    int16_t values[HID_COALESCE_MAX_VALUES];
+  };
+
+  /// @brief The slot of the report id, a free slot is assigned on the first use
+  Slot* findSlot(uint8_t id) {
+    for (int i = 0; i < HID_COALESCE_SLOTS; i++) {
+      if (slots[i].used && slots[i].id == id) return &slots[i];
+    }
+    for (int i = 0; i < HID_COALESCE_SLOTS; i++) {
+      if (!slots[i].used) {
+        slots[i].used = true;
+        slots[i].id = id;
+        return &slots[i];
+      }
+    }
+    return nullptr;
+  }
+
+  Slot slots[HID_COALESCE_SLOTS];
+};
+#endif
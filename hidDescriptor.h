@@ -0,0 +1,90 @@
+// This file contains the report descriptor of the spacemouse, which is shared by all transports, see hidTransport.h
+// There are no dependencies to the Arduino framework, so the descriptor can be used on a host, e.g. by uhidTransport.h
+
+#ifndef HIDDESCRIPTOR_H
+#define HIDDESCRIPTOR_H
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include <stdint.h>
+#include "latencyProbe.h"
+
+static const uint8_t report_descriptor[] = {
+  // --- Global Items ---
+  0x05, 0x01,  // Usage Page (Generic Desktop)
+  0x09, 0x08,  // Usage (Multi-axis Controller)
+  0xA1, 0x01,  // Collection (Application)
+
+#if HID_COMBINED_REPORT > 0
+  // --- Combined Translation and Rotation Report (ID 1) ---
+  0xA1, 0x00, 0x85, 0x01,
+  0x16, 0xA2, 0xFE, 0x26, 0x5E, 0x01,
+  0x09, 0x30, 0x09, 0x31, 0x09, 0x32,
+  0x09, 0x33, 0x09, 0x34, 0x09, 0x35,
+  0x75, 0x10, 0x95, 0x06, 0x81, 0x02,
+#if HID_COMBINED_BUTTONS > 0
+  // buttons in the same report
+  0x05, 0x09, 0x19, 0x01, 0x29, 0x02,
+  0x15, 0x00, 0x25, 0x01,
+  0x75, 0x01, 0x95, 0x02, 0x81, 0x02,
+  0x75, 0x01, 0x95, 0x0E, 0x81, 0x03,
+#endif
+  0xC0,
+#else
+  // --- Translation Report (ID 1) ---
+  0xA1, 0x00, 0x85, 0x01,
+  0x16, 0xA2, 0xFE, 0x26, 0x5E, 0x01,
+  0x09, 0x30, 0x09, 0x31, 0x09, 0x32,
+  0x75, 0x10, 0x95, 0x03, 0x81, 0x02,
+  0xC0,
+
+  // --- Rotation Report (ID 2) ---
+  0xA1, 0x00, 0x85, 0x02,
+  0x16, 0xA2, 0xFE, 0x26, 0x5E, 0x01,
+  0x09, 0x33, 0x09, 0x34, 0x09, 0x35,
+  0x75, 0x10, 0x95, 0x03, 0x81, 0x02,
+  0xC0,
+#endif
+
+#if !(HID_COMBINED_REPORT > 0 && HID_COMBINED_BUTTONS > 0)
+  // --- Button Report (ID 3) ---
+  0xA1, 0x00, 0x85, 0x03,
+  0x05, 0x09, 0x19, 0x01, 0x29, 0x02,
+  0x15, 0x00, 0x25, 0x01,
+  0x75, 0x01, 0x95, 0x02, 0x81, 0x02,
+  0x75, 0x01, 0x95, 0x0E, 0x81, 0x03,
+  0xC0,
+#endif
+
+  // --- LED Control Report (ID 4) ---
+  0xA1, 0x02, 0x85, 0x04,
+  0x05, 0x08, 0x09, 0x4B,
+  0x15, 0x00, 0x25, 0x01,
+  0x95, 0x01, 0x75, 0x01, 0x91, 0x02,
+  0x95, 0x01, 0x75, 0x07, 0x91, 0x03,
+  0xC0,
+
+  // --- Power Status Report (ID 23) ---
+  0x06, 0x00, 0xFF,
+  0x85, 0x17,
+  0x09, 0x01,
+  0x15, 0x00, 0x25, 0x64,
+  0x75, 0x08, 0x95, 0x01,
+  0x81, 0x02,
+  0x09, 0x02,
+  0x25, 0x01, 0x95, 0x01,
+  0x81, 0x02,
+
+#if LATENCY_PROBE > 0
+  // --- Latency Probe (ID 5): the host writes a probe id, the feature report echoes it, see latencyProbe.h ---
+  0x06, 0x00, 0xFF,
+  0x85, LATENCY_PROBE_ID,
+  0x15, 0x00, 0x26, 0xFF, 0x00,
+  0x75, 0x08,
+  0x09, 0x03, 0x95, LATENCY_PROBE_SIZE, 0x91, 0x02,  // Output: probe id
+  0x09, 0x04, 0x95, LATENCY_ECHO_SIZE, 0xB1, 0x02,   // Feature: echo
+#endif
+
+  0xC0  // End Application Collection
+};
+#endif
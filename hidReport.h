@@ -0,0 +1,41 @@
+// This file contains the packing of the HID reports with the axis, see HID_COMBINED_REPORT in config.h
+// The values are written explicitly as little endian int16, like the report descriptor in usbSpaceHID.h expects them.
+// There are no dependencies to the Arduino framework, so the packing can be tested on a host.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HID_AXES_REPORT_SIZE 6     // split mode: three axis in report 1 (translation) or report 2 (rotation)
+#define HID_COMBINED_AXES_SIZE 12  // combined mode: all six axis in report 1
+#define HID_COMBINED_MAX_SIZE 16   // six axis and up to 4 bytes of buttons
+
+/// @brief Write an int16 as little endian
+inline uint8_t* putInt16LE(uint8_t* p, int16_t value) {
+  *p++ = (uint16_t)value & 0xFF;
+  *p++ = (uint16_t)value >> 8;
+  return p;
+}
+
+/// @brief Pack three axis for the split reports 1 or 2
+/// @return size of the payload
+inline size_t packAxesReport(uint8_t* payload, int16_t a, int16_t b, int16_t c) {
+  uint8_t* p = putInt16LE(payload, a);
+  p = putInt16LE(p, b);
+  putInt16LE(p, c);
+  return HID_AXES_REPORT_SIZE;
+}
+
+/// @brief Pack all six axis and optionally the buttons into the combined report 1: X, Y, Z, Rx, Ry, Rz, buttons
+/// @param buttons bits of the buttons, or nullptr if the buttons are sent in their own report
+/// @param buttonBytes number of bytes of the buttons, at most HID_COMBINED_MAX_SIZE - HID_COMBINED_AXES_SIZE
+/// @return size of the payload
+inline size_t packCombinedReport(uint8_t* payload, int16_t x, int16_t y, int16_t z, int16_t rx, int16_t ry, int16_t rz,
+                                 const uint8_t* buttons, size_t buttonBytes) {
+  packAxesReport(payload, x, y, z);
+  packAxesReport(payload + HID_AXES_REPORT_SIZE, rx, ry, rz);
+  if (buttons == nullptr) return HID_COMBINED_AXES_SIZE;
+  if (buttonBytes > HID_COMBINED_MAX_SIZE - HID_COMBINED_AXES_SIZE) buttonBytes = HID_COMBINED_MAX_SIZE - HID_COMBINED_AXES_SIZE;
+  memcpy(payload + HID_COMBINED_AXES_SIZE, buttons, buttonBytes);
+  return HID_COMBINED_AXES_SIZE + buttonBytes;
+}
@@ -0,0 +1,148 @@
+// This file contains the transmit scheduler of the HID reports, see HID_SCHEDULER in config.h
+// Sending a report directly waits until the host has fetched it. If the host doesn't poll (suspend, busy host), the loop() stalls.
+// Instead, the reports are posted into one slot per report id. A newer report replaces the pending one of the same id
+// (latest value wins), so the queue is bounded and posting never blocks.
+// The scheduler sends the oldest pending report as soon as the endpoint is free again (the previous report was completed)
+// and at least HID_MIN_INTERVAL_US have passed since the last one. A pending report is only ever replaced by a newer one of
+// the same id, never dropped because of its age: it may be the only copy of a state (e.g. a released button or the zero
+// velocity), which the host must get. Reports, which were pending longer than HID_MAX_AGE_US, are counted as stale.
+// The endpoint is an interface, so the scheduler can be tested on a host with a mock endpoint.
+
+#ifndef HIDSCHEDULER_H
+#define HIDSCHEDULER_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HID_SCHEDULER_SLOTS 6         // number of different report ids
+#define HID_SCHEDULER_MAX_REPORT 16  // bytes per report
+
+// the interrupt IN endpoint of the HID
+class HidEndpoint {
+public:
+  /// @brief true, if the previous report has been completed and a new one can be sent
+  virtual bool ready() = 0;
+  /// @brief Hand a report to the endpoint without waiting
+  virtual bool send(uint8_t id, const uint8_t* data, size_t len) = 0;
+};
+
+class HidScheduler {
+public:
+  /// @param endpoint the endpoint to send the reports to
+  /// @param minIntervalUs minimum time between two reports in us
+  /// @param maxAgeUs reports, which were pending longer than this, are counted as stale
+  HidScheduler(HidEndpoint& endpoint, uint32_t minIntervalUs, uint32_t maxAgeUs)
+    : minIntervalUs(minIntervalUs), endpoint(&endpoint), maxAgeUs(maxAgeUs) {
+    memset(slots, 0, sizeof(slots));
+  }
+
+  /// @brief Send the reports to another endpoint from now on
+  void setEndpoint(HidEndpoint& endpoint) {
+    this->endpoint = &endpoint;
+  }
+
+  /// @brief Queue a report, never blocks. A pending report of the same id is replaced.
+  /// @return false, if the report was dropped, because it is too long or all slots are in use by other ids
+  bool post(uint8_t id, const void* data, size_t len, uint32_t nowUs) {
+    Slot* slot = findSlot(id);
+    if (slot == nullptr || len > HID_SCHEDULER_MAX_REPORT) {
+      dropped++;
+      return false;
+    }
+    if (slot->pending) coalesced++;
+    slot->pending = true;
+    slot->len = len;
+    slot->postedUs = nowUs;
+    memcpy(slot->data, data, len);
+    posted++;
+    return true;
+  }
+
+  /// @brief Send the oldest pending report, if the endpoint is free and the minimum interval has passed.
+  /// Call it on every loop() and when a report has been completed.
+  /// @return true, if a report was sent
+  bool service(uint32_t nowUs) {
+    Slot* oldest = nullptr;
+    for (int i = 0; i < HID_SCHEDULER_SLOTS; i++) {
+      Slot& slot = slots[i];
+      if (!slot.pending) continue;
+      if (oldest == nullptr || (int32_t)(slot.postedUs - oldest->postedUs) < 0) oldest = &slot;
+    }
+    if (oldest == nullptr) return false;
+    if (sentOnce && nowUs - lastSentUs < minIntervalUs) return false;
+    if (!endpoint->ready()) return false;
+    if (!endpoint->send(oldest->id, oldest->data, oldest->len)) return false;  // keep the report and try again on the next call
+    if (onSent) onSent(oldest->id, nowUs);
+
+    oldest->pending = false;
+    uint32_t latency = nowUs - oldest->postedUs;
+    latencySumUs += latency;
+    if (latency > latencyMaxUs) latencyMaxUs = latency;
+    if (latency > maxAgeUs) stale++;  // e.g. the host was suspended
+    lastSentUs = nowUs;
+    sentOnce = true;
+    sent++;
+    return true;
+  }
+
+  /// @brief number of reports waiting to be sent
+  int pending() const {
+    int count = 0;
+    for (int i = 0; i < HID_SCHEDULER_SLOTS; i++) {
+      if (slots[i].pending) count++;
+    }
+    return count;
+  }
+
+  /// @brief true, if no report is waiting
+  bool idle() const {
+    return pending() == 0;
+  }
+
+  /// @brief mean time from posting to sending of the sent reports in us
+  uint32_t latencyMeanUs() const {
+    return sent ? latencySumUs / sent : 0;
+  }
+
+  uint32_t minIntervalUs;
+  void (*onSent)(uint8_t id, uint32_t nowUs) = nullptr;  // called for every report, which was handed to the endpoint
+  uint32_t posted = 0;     // posted reports
+  uint32_t sent = 0;       // reports handed to the endpoint
+  uint32_t coalesced = 0;  // reports replaced by a newer one of the same id before they were sent
+  uint32_t dropped = 0;    // reports dropped: too long or no free slot
+  uint32_t stale = 0;      // reports sent after more than maxAgeUs
+  uint64_t latencySumUs = 0;
+  uint32_t latencyMaxUs = 0;
+
+private:
+  struct Slot {
+    bool used;
+    bool pending;
+    uint8_t id;
+    uint8_t len;
+    uint32_t postedUs;
+    uint8_t data[HID_SCHEDULER_MAX_REPORT];
+  };
+
+  /// @brief The slot of the report id, a free slot is assigned on the first use
+  Slot* findSlot(uint8_t id) {
+    for (int i = 0; i < HID_SCHEDULER_SLOTS; i++) {
+      if (slots[i].used && slots[i].id == id) return &slots[i];
+    }
+    for (int i = 0; i < HID_SCHEDULER_SLOTS; i++) {
+      if (!slots[i].used) {
+        slots[i].used = true;
+        slots[i].id = id;
+        return &slots[i];
+      }
+    }
+    return nullptr;
+  }
+
+  HidEndpoint* endpoint;
+  uint32_t maxAgeUs;
+  Slot slots[HID_SCHEDULER_SLOTS];
+  uint32_t lastSentUs = 0;
+  bool sentOnce = false;
+};
+#endif
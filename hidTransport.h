@@ -0,0 +1,48 @@
+// This file contains the interface of the transports of the HID reports, see HID_TRANSPORT in config.h
+// The reports are built independent of the transport by sendUSBData() and packed by hidReport.h.
+// A transport only hands the ready built reports to the host: USB (usbSpaceHID.h), BLE (bluetooth.h) or
+// the Linux uhid (uhidTransport.h, to run a virtual spacemouse on a Linux box).
+// Every transport announces its capabilities, e.g. the hidScheduler doesn't send faster than the transport allows.
+// There are no dependencies to the Arduino framework, so the backends can be used on a host.
+
+#ifndef HIDTRANSPORT_H
+#define HIDTRANSPORT_H
+#include <stdint.h>
+#include <stddef.h>
+#include "hidScheduler.h"
+
+struct HidCapabilities {
+  uint16_t maxReportRateHz;  // reports per second, the transport can deliver
+  uint8_t maxReportSize;     // bytes of the payload of one report
+  bool combinedReport;       // the host side understands the combined report 1 with all six axis, see HID_COMBINED_REPORT
+  bool paced;                // the transport paces the reports itself, the hidScheduler hands them over immediately
+};
+
+// Called with the output reports of the host, e.g. the LED or a latency probe
+typedef void (*HidOutputHandler)(uint8_t id, const uint8_t* data, uint16_t len);
+// Called, if the host reads a feature report. Returns the size of the report, 0 if it is unknown.
+typedef uint16_t (*HidFeatureHandler)(uint8_t id, uint8_t* buffer, uint16_t len);
+
+class HidTransport : public HidEndpoint {
+public:
+  /// @brief Start the transport with the report descriptor
+  virtual bool begin(const uint8_t* descriptor, size_t len) = 0;
+  /// @brief true, if a host is connected
+  virtual bool connected() = 0;
+  virtual HidCapabilities capabilities() = 0;
+  virtual const char* name() = 0;
+  /// @brief Hand the collected reports to the host, for transports, which pace the reports themselves.
+  /// Called by the sender of the reports, see hidSchedulerTask() in usbSpaceHID.h
+  virtual void service(uint32_t nowUs) {}
+
+  /// @brief Set the handlers for the reports from the host
+  void setHandlers(HidOutputHandler output, HidFeatureHandler feature) {
+    onOutput = output;
+    onGetFeature = feature;
+  }
+
+protected:
+  HidOutputHandler onOutput = nullptr;
+  HidFeatureHandler onGetFeature = nullptr;
+};
+#endif
@@ -0,0 +1,116 @@
+// This file contains a fixed point implementation of the SimpleKalmanFilter for all eight sensors at once.
+// The state of all channels is stored in one statically allocated block (structure of arrays) and updated with integer math only.
+//
+// Number formats:
+//   estimate:    Q16.15 in int32_t  -> inputs up to 16 bit are possible
+//   errEstimate: Q11.21 in uint32_t -> the estimation error stays below errMeasure + q * 65535
+//   gain:        Q15 in uint16_t    -> 0 ... 32768 represents 0.0 ... 1.0
+//
+// Exact mode: the output matches the float SimpleKalmanFilter within +/-1 count.
+// Steady-state mode: once the gain of a channel changes less than KALMAN_SS_EPSILON for KALMAN_SS_SAMPLES updates,
+// the gain of this channel is frozen (but never below KALMAN_SS_MIN_GAIN). When all channels are frozen,
+// the update is reduced to one multiply-add per channel. This is a deliberate deviation from the float filter,
+// whose gain slowly approaches zero while the knob is not moved.
+
+#ifndef KALMANBANK_H
+#define KALMANBANK_H
+#include "config.h"
+#include <stdint.h>
+
+#define KALMAN_CHANNELS 8
+#define KALMAN_EST_FRAC 15
+#define KALMAN_ERR_FRAC 21
+#define KALMAN_GAIN_ONE 32768
+
+/// @brief State of all channels in one contiguous block
+struct KalmanBankState {
+  int32_t estimate[KALMAN_CHANNELS];
+  uint32_t errEstimate[KALMAN_CHANNELS];
+  uint16_t gain[KALMAN_CHANNELS];
+  uint16_t stableCount[KALMAN_CHANNELS];
+};
+
+class KalmanBank {
+public:
+  /// @brief Initialize all channels with the same parameters as the SimpleKalmanFilter
+  /// @param measurementError measurement error
+  /// @param estimationError initial estimation error
+  /// @param processNoise process noise (Q)
+  /// @param steadyState allow to freeze the gain, once it has converged
+  void init(float measurementError, float estimationError, float processNoise, bool steadyState) {
+    errMeasure = (uint32_t)(measurementError * (1UL << KALMAN_ERR_FRAC) + 0.5f);
+    q = (uint32_t)(processNoise * 65536.0f + 0.5f);
+    allowSteadyState = steadyState;
+    frozenChannels = 0;
+    for (int i = 0; i < KALMAN_CHANNELS; i++) {
+      s.estimate[i] = 0;
+      s.errEstimate[i] = (uint32_t)(estimationError * (1UL << KALMAN_ERR_FRAC) + 0.5f);
+      s.gain[i] = 0;
+      s.stableCount[i] = 0;
+    }
+  }
+
+  /// @brief Feed one new measurement per channel into the filters
+  /// @param in pointer to KALMAN_CHANNELS raw values
+  /// @param out pointer to KALMAN_CHANNELS filtered values, truncated like the float filter
+  void update(const uint16_t* in, int* out) {
+    if (frozenChannels == KALMAN_CHANNELS) {
+      // steady state: one multiply-add per channel
+      for (int i = 0; i < KALMAN_CHANNELS; i++) {
+        int32_t innovation = ((int32_t)in[i] << KALMAN_EST_FRAC) - s.estimate[i];
+        s.estimate[i] += (int32_t)(((int64_t)s.gain[i] * innovation) >> 15);
+        out[i] = s.estimate[i] >> KALMAN_EST_FRAC;
+      }
+      return;
+    }
+    for (int i = 0; i < KALMAN_CHANNELS; i++) {
+      int32_t innovation = ((int32_t)in[i] << KALMAN_EST_FRAC) - s.estimate[i];
+      if (s.stableCount[i] < KALMAN_SS_SAMPLES) {
+        updateChannel(i, innovation);
+      } else {
+        s.estimate[i] += (int32_t)(((int64_t)s.gain[i] * innovation) >> 15);
+      }
+      out[i] = s.estimate[i] >> KALMAN_EST_FRAC;
+    }
+  }
+
+  /// @return true, if all channels run with a frozen gain
+  bool isSteady() const {
+    return frozenChannels == KALMAN_CHANNELS;
+  }
+
+private:
+  /// @brief full Kalman update of one channel, identical to SimpleKalmanFilter::updateEstimate()
+  void updateChannel(int i, int32_t innovation) {
+    uint32_t err = s.errEstimate[i];
+    // rounded, a truncated gain lets the estimate drift up to 2 counts from the float filter after large steps
+    uint16_t gain = (uint16_t)(((((uint64_t)err) << 15) + (err + errMeasure) / 2) / (err + errMeasure));
+    int32_t delta = (int32_t)(((int64_t)gain * innovation) >> 15);
+    s.estimate[i] += delta;
+    uint32_t absDelta = delta < 0 ? -delta : delta;
+    // err = (1 - gain) * err + |delta| * q, the delta is converted from Q15 to Q21 and q is Q16
+    s.errEstimate[i] = (uint32_t)((((uint64_t)(KALMAN_GAIN_ONE - gain)) * err) >> 15)
+                       + (uint32_t)(((uint64_t)absDelta * q) >> (16 - (KALMAN_ERR_FRAC - KALMAN_EST_FRAC)));
+
+    if (allowSteadyState) {
+      int gainChange = (int)gain - (int)s.gain[i];
+      if (gainChange <= KALMAN_SS_EPSILON && gainChange >= -KALMAN_SS_EPSILON) {
+        if (++s.stableCount[i] >= KALMAN_SS_SAMPLES) {
+          uint16_t minGain = (uint16_t)(KALMAN_SS_MIN_GAIN * KALMAN_GAIN_ONE);
+          if (gain < minGain) gain = minGain;
+          frozenChannels++;
+        }
+      } else {
+        s.stableCount[i] = 0;
+      }
+    }
+    s.gain[i] = gain;
+  }
+
+  KalmanBankState s;
+  uint32_t errMeasure;  // Q11.21
+  uint32_t q;           // Q16
+  bool allowSteadyState;
+  uint8_t frozenChannels;
+};
+#endif
@@ -0,0 +1,195 @@
+// This file contains the guided calibration of the decoupling matrix, see KINEMATIC_MATRIX in config.h
+// The knob is moved through the movements of the movement table at the bottom of kinematics.h.
+// For every movement, the intended velocity is the axis of the movement as calculated by the default matrix, all other axis are zero.
+// The matrix is fitted by a ridge regularized least squares fit: minimize |X M' - Y|^2 + lambda |M - M0|^2
+// Only the sums X'X and X'Y are accumulated, so no samples need to be stored.
+
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include <stdint.h>
+#include <math.h>
+
+class KinematicFit {
+public:
+  void reset() {
+    for (int i = 0; i < 8; i++) {
+      for (int j = 0; j < 8; j++) xx[i][j] = 0;
+      for (int a = 0; a < 6; a++) xy[a][i] = 0;
+    }
+    samples = 0;
+  }
+
+  /// @brief Add one sample
+  /// @param x 8 sensor values
+  /// @param y 6 intended velocities
+  void addSample(const int* x, const float* y) {
+    for (int i = 0; i < 8; i++) {
+      for (int j = i; j < 8; j++) xx[i][j] += (double)x[i] * x[j];
+      for (int a = 0; a < 6; a++) xy[a][i] += (double)x[i] * y[a];
+    }
+    samples++;
+  }
+
+  /// @brief Fit the matrix to all samples
+  /// @param prior matrix in Q12, which the fit is pulled to by the regularization
+  /// @param ridge strength of the regularization, relative to the mean energy of the sensors
+  /// @param out fitted matrix in Q12, only changed if successful
+  /// @return false, if there are no samples or the equations can't be solved
+  bool solve(const int16_t prior[6][8], float ridge, int16_t out[6][8]) {
+    if (samples == 0) return false;
+    double trace = 0;
+    for (int i = 0; i < 8; i++) trace += xx[i][i];
+    double lambda = ridge * trace / 8;
+    if (lambda <= 0) lambda = 1e-9;
+
+    int16_t result[6][8];
+    for (int axis = 0; axis < 6; axis++) {
+      // normal equations (X'X + lambda I) m = X'y + lambda m0
+      double a[8][9];
+      for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) a[i][j] = (i <= j) ? xx[i][j] : xx[j][i];
+        a[i][i] += lambda;
+        a[i][8] = xy[axis][i] + lambda * prior[axis][i] / 4096.0;
+      }
+      double m[8];
+      if (!gaussSolve(a, m)) return false;
+      for (int i = 0; i < 8; i++) {
+        double q = round(m[i] * 4096.0);
+        result[axis][i] = (int16_t)(q > 32767 ? 32767 : (q < -32768 ? -32768 : q));
+      }
+    }
+    for (int axis = 0; axis < 6; axis++) {
+      for (int i = 0; i < 8; i++) out[axis][i] = result[axis][i];
+    }
+    return true;
+  }
+
+  uint32_t samples = 0;
+
+private:
+  /// @brief Gaussian elimination with partial pivoting of an 8x8 system with the right side in column 8
+  static bool gaussSolve(double a[8][9], double* x) {
+    for (int col = 0; col < 8; col++) {
+      int pivot = col;
+      for (int row = col + 1; row < 8; row++) {
+        if (fabs(a[row][col]) > fabs(a[pivot][col])) pivot = row;
+      }
+      if (fabs(a[pivot][col]) < 1e-12) return false;
+      if (pivot != col) {
+        for (int k = 0; k < 9; k++) {
+          double tmp = a[col][k];
+          a[col][k] = a[pivot][k];
+          a[pivot][k] = tmp;
+        }
+      }
+      for (int row = col + 1; row < 8; row++) {
+        double f = a[row][col] / a[col][col];
+        for (int k = col; k < 9; k++) a[row][k] -= f * a[col][k];
+      }
+    }
+    for (int row = 7; row >= 0; row--) {
+      double sum = a[row][8];
+      for (int k = row + 1; k < 8; k++) sum -= a[row][k] * x[k];
+      x[row] = sum / a[row][row];
+    }
+    return true;
+  }
+
+  double xx[8][8];  // X'X, upper triangle
+  double xy[6][8];  // X'Y
+};
+
+#ifdef ARDUINO
+
+// movements of the guided calibration, see the movement table in kinematics.h
+struct KinematicPose {
+  const char* name;
+  int8_t axis;
+};
+
+const KinematicPose kinematicPoses[] = {
+  { "West: move left", TRANSX },
+  { "East: move right", TRANSX },
+  { "North: move backwards", TRANSY },
+  { "South: move forwards", TRANSY },
+  { "Top: pull up", TRANSZ },
+  { "Bottom: push down", TRANSZ },
+  { "Rotx-fw: tilt forwards", ROTX },
+  { "Rotx-bw: tilt backwards", ROTX },
+  { "Roty-left: tilt left", ROTY },
+  { "Roty-right: tilt right", ROTY },
+  { "Rotz-clock: twist clockwise", ROTZ },
+  { "Rotz-cclock: twist counter clockwise", ROTZ },
+};
+#define NUM_KINEMATIC_POSES (sizeof(kinematicPoses) / sizeof(kinematicPoses[0]))
+
+KinematicFit kinematicFit;
+int kinematicFitState = 0;  // little state machine -> setup in 0 -> announce and wait in 1 -> collect in 2
+unsigned int kinematicFitPose;
+unsigned long kinematicFitStart;
+
+/// @brief Print a matrix, in order to copy the output to KINEMATIC_MATRIX_VALUES in config.h
+void printKinematicMatrix(const int16_t matrix[6][8]) {
+  SERIAL.println(F("#define KINEMATIC_MATRIX_VALUES \\"));
+  for (int axis = 0; axis < 6; axis++) {
+    SERIAL.print(axis == 0 ? "  { { " : "    { ");
+    for (int i = 0; i < 8; i++) {
+      SERIAL.print(matrix[axis][i]);
+      if (i < 7) SERIAL.print(", ");
+    }
+    SERIAL.println(axis == 5 ? " } }" : " }, \\");
+  }
+}
+
+/// @brief Guided calibration of the decoupling matrix, debug mode 16. Call it on every loop() with the filtered values.
+/// @param centered pointer to the 8 centered values after FilterAnalogReadOuts()
+/// @return true, when the calibration is finished
+bool kinematicCalibration(const int* centered) {
+  if (kinematicFitState == 0) {
+    kinematicFit.reset();
+    kinematicFitPose = 0;
+    kinematicFitState = 1;
+    kinematicFitStart = millis();
+    SERIAL.println(F("Guided calibration of the decoupling matrix. Hold every movement as far and as clean as possible."));
+    SERIAL.printf("%s\n", kinematicPoses[0].name);
+  } else if (kinematicFitState == 1) {
+    if (millis() - kinematicFitStart > KINEMATIC_FIT_PREPARE_MS) {
+      SERIAL.println(F("...hold it"));
+      kinematicFitState = 2;
+      kinematicFitStart = millis();
+    }
+  } else if (kinematicFitState == 2) {
+    // the intended velocity: the axis of the movement as seen by the default matrix
+    float y[6] = { 0, 0, 0, 0, 0, 0 };
+    int8_t axis = kinematicPoses[kinematicFitPose].axis;
+    int32_t sum = 0;
+    for (int i = 0; i < 8; i++) sum += (int32_t)defaultKinematicMatrix[axis][i] * centered[i];
+    y[axis] = sum / 4096.0f;
+    kinematicFit.addSample(centered, y);
+
+    if (millis() - kinematicFitStart > KINEMATIC_FIT_COLLECT_MS) {
+      kinematicFitPose++;
+      kinematicFitState = 1;
+      kinematicFitStart = millis();
+      if (kinematicFitPose < NUM_KINEMATIC_POSES) {
+        SERIAL.printf("%s\n", kinematicPoses[kinematicFitPose].name);
+      } else {
+        kinematicFitState = 0;
+        SERIAL.println(F("Release the knob. Fitting..."));
+        if (!kinematicFit.solve(defaultKinematicMatrix, KINEMATIC_FIT_RIDGE, kinematicMatrix)) {
+          SERIAL.println(F("Fit failed, the matrix is not changed."));
+          return true;
+        }
+        SERIAL.printf("Fitted from %lu samples. Copy this into config.h:\n", (unsigned long)kinematicFit.samples);
+        printKinematicMatrix(kinematicMatrix);
+#if CALIBSTORE > 0
+        if (saveCalibration()) SERIAL.println(F("Matrix saved in the calibration store."));
+#endif
+        return true;
+      }
+    }
+  }
+  return false;
+}
+#endif
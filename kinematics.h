@@ -1,10 +1,17 @@
 // This file contains all functions to calculate the kinematics
 
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
 // The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
 // Please open config_sample.h, adjust your settings and save it as config.h
 #include "config.h"
 #include <math.h>
-#include <SimpleKalmanFilter.h>
+#include "kalmanBank.h"
+#include "adcEngine.h"
+#include "modifierLut.h"
+#if TRACE_REPLAY > 0
+#include "traceBuffer.h"
+#endif
 #define sign(x) ((x) < 0 ? -1 : ((x) > 0 ? 1 : 0))  // Define Signum Function
 
 
@@ -34,61 +41,123 @@ int pinList[8] = PINLIST;
 int invertList[8] = INVERTLIST;
 
 
-SimpleKalmanFilter *kalmanFilters[8];
+// fixed point Kalman filters for all eight sensors, see kalmanBank.h
+KalmanBank kalmanBank;
 
 void setupkalmanFilters() {
-  float KalmanFilterValues[3] = { 5.0, 2.0, 0.01 };
+  // Parameters: measurement error, estimation error, process noise (Q)
+  kalmanBank.init(5.0, 2.0, 0.01, KALMAN_STEADYSTATE > 0);
+}
+
+
+// deadzone of each sensor in units of the oversampled sensors. Starts with DEADZONE and is adapted to the noise, see autoZero.h
+int deadzones[8];
+
+/// @brief Start the background acquisition of all joystick axis. Call this once during setup()
+void setupSensors() {
   for (int i = 0; i < 8; i++) {
-    // Parameters: Kalman gain for position, Kalman gain for velocity, measurement error
-    kalmanFilters[i] = new SimpleKalmanFilter(
-      KalmanFilterValues[0],  // measurement error
-      KalmanFilterValues[1],  // estimation error
-      KalmanFilterValues[2]   // process noise (Q)
-    );
+    deadzones[i] = DEADZONE * SENSOR_SCALE;
+  }
+  if (!adcEngine.begin(pinList)) {
+    SERIAL.println(F("ADC continuous mode not available, reading the sensors sequentially."));
   }
 }
 
+// time in micros() of the first ADC scan of the newest frame, see readAllFromSensors(). Motion can't be older than this.
+uint32_t sensorFirstScanUs = 0;
 
 /// @brief Function to read and store analogue voltages for each joystick axis.
+/// The values are taken from the newest complete frame of the acquisition engine, see adcEngine.h
 /// @param rawReads pointer to 8 analog values
-void readAllFromSensors(int *rawReads) {
+/// @param engine acquisition engine to read from, e.g. a mock engine for the benchmarks
+/// @return true, if a new frame has been read. Otherwise the values of the last frame are repeated.
+bool readAllFromSensors(int *rawReads, AdcEngine &engine = adcEngine) {
+  static AdcFrame frame = {};
+  static int filteredValues[8];
+  engine.service();
+  if (engine.partialFrames.load(std::memory_order_relaxed)) engine.flushScans();  // slowed down by the power governor
+  bool newFrame = engine.latest(frame);
+  if (newFrame) {
+    sensorFirstScanUs = frame.firstScanUs;
+    // only feed new frames into the filters, so the filter dynamics depend on the sample rate and not on the loop rate
+    kalmanBank.update(frame.values, filteredValues);
+#if TRACE_REPLAY > 0
+    traceBuffer.capture(frame.values, frame.timestampUs);  // only while recording a trace
+#endif
+  }
   for (int i = 0; i < 8; i++) {
-    int filteredValue = kalmanFilters[i]->updateEstimate(analogRead(pinList[i]));
-
     if (invertList[i] == 1) {
-      rawReads[i] = analogMax_Resolution - filteredValue;  // invert the reading
+      rawReads[i] = SENSOR_MAX - filteredValues[i];  // invert the reading
     } else {
-      rawReads[i] = filteredValue;
+      rawReads[i] = filteredValues[i];
     }
   }
+  return newFrame;
 }
 
 // set the min and maxvals from the config.h into real variables
+// They are given in units of the 12 bit ADC and are scaled with SENSOR_SCALE to the resolution of the oversampled sensors.
 int minVals[8] = MINVALS;
 int maxVals[8] = MAXVALS;
 // Please do not change this anymore. Use indipendent sensitivity multiplier.
-#define TOTALSENSITIVITY 350
+// The mapped values keep the additional resolution of the oversampling until the sensitivities are applied.
+#define TOTALSENSITIVITY (350 * SENSOR_SCALE)
 
-/// @brief Takes the centered joystick values, applies a deadzone and maps the values to +/- 350.
+/// @brief Takes the centered joystick values, applies the deadzone of each sensor and maps the values to +/- TOTALSENSITIVITY.
 /// @param centered pointer to array with 8 centered analog values
 void FilterAnalogReadOuts(int *centered) {
   // Filter movement values. Set to zero if movement is below deadzone threshold.
   for (int i = 0; i < 8; i++) {
-    if (centered[i] < DEADZONE && centered[i] > -DEADZONE) {
+    const int deadzone = deadzones[i];
+    if (centered[i] < deadzone && centered[i] > -deadzone) {
       centered[i] = 0;
     } else {
       if (centered[i] < 0) {  // if the value is smaller 0 ...
-        // ... map the value from the [min,-DEADZONE] to [-350,0]
-        centered[i] = map(centered[i], minVals[i], -DEADZONE, -TOTALSENSITIVITY, 0);
+        // ... map the value from the [min,-DEADZONE] to [-TOTALSENSITIVITY,0]
+        centered[i] = map(centered[i], minVals[i] * SENSOR_SCALE, -deadzone, -TOTALSENSITIVITY, 0);
       } else {  // if the value is > 0 ...
-        // ... map the values from the [DEADZONE,max] to [0,+350]
-        centered[i] = map(centered[i], DEADZONE, maxVals[i], 0, TOTALSENSITIVITY);
+        // ... map the values from the [DEADZONE,max] to [0,+TOTALSENSITIVITY]
+        centered[i] = map(centered[i], deadzone, maxVals[i] * SENSOR_SCALE, 0, TOTALSENSITIVITY);
       }
     }
   }
 }
 
+// set the sensitivities, gates and the modifier function from the config.h into real variables,
+// so they can be replaced by the calibration store, see calibStore.h
+#define SENS_TRANSX 0
+#define SENS_TRANSY 1
+#define SENS_POS_TRANSZ 2
+#define SENS_NEG_TRANSZ 3
+#define SENS_ROTX 4
+#define SENS_ROTY 5
+#define SENS_ROTZ 6
+float sensitivities[7] = { TRANSX_SENSITIVITY, TRANSY_SENSITIVITY, POS_TRANSZ_SENSITIVITY, NEG_TRANSZ_SENSITIVITY,
+                           ROTX_SENSITIVITY, ROTY_SENSITIVITY, ROTZ_SENSITIVITY };
+#define GATEIDX_NEG_TRANSZ 0
+#define GATEIDX_ROTX 1
+#define GATEIDX_ROTY 2
+#define GATEIDX_ROTZ 3
+int gates[4] = { GATE_NEG_TRANSZ, GATE_ROTX, GATE_ROTY, GATE_ROTZ };
+uint8_t modFunc = MODFUNC;
+
+// decoupling matrix, which calculates the six velocities from the eight sensors, see KINEMATIC_MATRIX in config.h
+// The fixed point format is Q12. The matrix can be fitted by debug mode 16 (kinematicFit.h) and is kept in the calibration store.
+#define KINEMATIC_Q 12
+const int16_t defaultKinematicMatrix[6][8] = KINEMATIC_MATRIX_VALUES;
+int16_t kinematicMatrix[6][8] = KINEMATIC_MATRIX_VALUES;
+
 void _calculateKinematicSensors(int *centered, int16_t *velocity) {
+#if KINEMATIC_MATRIX > 0
+  for (int axis = 0; axis < 6; axis++) {
+    int32_t sum = 0;
+    for (int i = 0; i < 8; i++) {
+      sum += (int32_t)kinematicMatrix[axis][i] * centered[i];
+    }
+    // divide with truncation, like the formula below, so the default matrix gives exactly the same result
+    velocity[axis] = sum / (1 << KINEMATIC_Q);
+  }
+#else
 
   // calculate sensors transX
   velocity[TRANSX] = (centered[HES1] - centered[HES0] + centered[HES6] - centered[HES7]) / 2;
@@ -107,32 +176,40 @@ void _calculateKinematicSensors(int *centered, int16_t *velocity) {
 
   // rotZ
   velocity[ROTZ] = (centered[HES0] + centered[HES2] + centered[HES6] + centered[HES8] - centered[HES1] - centered[HES3] - centered[HES7] - centered[HES9]) / 4;
+#endif
 }
 
-/// @brief Function to modify the input value according to different mathematic modes. Choose the mathematical function in config.h as modFunc
+/// @brief Calculation of the modifier function in double precision, as it was done before the lookup tables.
+/// Only used as reference for the benchmark (debug mode 13) and test/modifier_lut.cpp, knows only the curves 0 ... 4.
 /// @param x input between -350 and +350
 /// @return output between -350 and +350
-int modifierFunction(int x) {
+int modifierFunctionReference(int x) {
   // making sure function input never exedes range of -350 to 350
   x = constrain(x, -350, 350);
   double result;
-#if (MODFUNC == 1)
-  // using squared function y = x^2*sign(x)
-  result = 350 * pow(x / 350.0, 2) * sign(x);  // sign putting out -1 or 1 depending on sign of value. (Is needed because x^2 will always be positive)
-#elif (MODFUNC == 2)
-  // using tan function: tan(x)
-  result = 350 * tan(x / 350.0);
-#elif (MODFUNC == 3)
-  // using squared tan function: tan(x^2*sign(x))
-  result = 350 * tan(pow(x / 350.0, 2) * sign(x));  // sign putting out -1 or 1 depending on sign of value. (Is needed because x^2 will always be positive)
-#elif (MODFUNC == 4)
-  // using cubed tan function: tan(x^3)
-  result = 350 * tan(pow(x / 350.0, 3));
-#else
-  // MODFUNC == 0 or others...
-  // no modification
-  result = x;
-#endif
+  switch (modFunc) {
+    case 1:
+      // using squared function y = x^2*sign(x)
+      result = 350 * pow(x / 350.0, 2) * sign(x);  // sign putting out -1 or 1 depending on sign of value. (Is needed because x^2 will always be positive)
+      break;
+    case 2:
+      // using tan function: tan(x)
+      result = 350 * tan(x / 350.0);
+      break;
+    case 3:
+      // using squared tan function: tan(x^2*sign(x))
+      result = 350 * tan(pow(x / 350.0, 2) * sign(x));  // sign putting out -1 or 1 depending on sign of value. (Is needed because x^2 will always be positive)
+      break;
+    case 4:
+      // using cubed tan function: tan(x^3)
+      result = 350 * tan(pow(x / 350.0, 3));
+      break;
+    default:
+      // modFunc == 0 or others...
+      // no modification
+      result = x;
+      break;
+  }
 
   // make sure values between-350 and 350 are allowed
   result = constrain(result, -350, 350);
@@ -140,6 +217,22 @@ int modifierFunction(int x) {
   return (int)round(result);
 }
 
+/// @brief Function to modify the input value according to different mathematic modes. Choose the mathematical function in config.h as MODFUNC
+/// The curves are precalculated lookup tables, see modifierLut.h
+/// @param x input between -350 and +350
+/// @return output between -350 and +350
+int modifierFunction(int x) {
+  return getModifierCurve(modFunc, false).apply(x);
+}
+
+/// @brief Modifier function for TRANSZ: the negative half uses the curve of modFunc, the positive half is linear,
+/// because pulling the knob upwards is much heavier.
+/// @param x input, limited to -350 ... +350
+/// @return output between -350 and +350
+int modifierTransZ(int x) {
+  return getModifierCurve(modFunc, true).apply(x);
+}
+
 /// @brief Calculate the kinematic of the three axis from the eight joysticks
 /// @param centered eight values from the four joysticks
 /// @param velocity resulting translational and rotational motions
@@ -148,40 +241,40 @@ void calculateKinematic(int *centered, int16_t *velocity) {
   _calculateKinematicSensors(centered, velocity);
 
   // transX
-  velocity[TRANSX] = velocity[TRANSX] / ((float)TRANSX_SENSITIVITY);
+  velocity[TRANSX] = velocity[TRANSX] / (sensitivities[SENS_TRANSX] * SENSOR_SCALE);
   velocity[TRANSX] = modifierFunction(velocity[TRANSX]);  // recalculate with modifier function
 
   // transY
-  velocity[TRANSY] = velocity[TRANSY] / ((float)TRANSY_SENSITIVITY);
+  velocity[TRANSY] = velocity[TRANSY] / (sensitivities[SENS_TRANSY] * SENSOR_SCALE);
   velocity[TRANSY] = modifierFunction(velocity[TRANSY]);  // recalculate with modifier function
 
   if (velocity[TRANSZ] < 0) {
-    velocity[TRANSZ] = modifierFunction(velocity[TRANSZ] / ((float)NEG_TRANSZ_SENSITIVITY));  // recalculate with modifier function
-    if (abs(velocity[TRANSZ]) < GATE_NEG_TRANSZ) {
+    velocity[TRANSZ] = modifierTransZ(velocity[TRANSZ] / (sensitivities[SENS_NEG_TRANSZ] * SENSOR_SCALE));  // recalculate with modifier function
+    if (abs(velocity[TRANSZ]) < gates[GATEIDX_NEG_TRANSZ]) {
       velocity[TRANSZ] = 0;
     }
-  } else {                                                                                        // pulling the knob upwards is much heavier... smaller factor
-    velocity[TRANSZ] = constrain(velocity[TRANSZ] / ((float)POS_TRANSZ_SENSITIVITY), -350, 350);  // no modifier function, just constrain linear!
+  } else {                                                                                     // pulling the knob upwards is much heavier... smaller factor
+    velocity[TRANSZ] = modifierTransZ(velocity[TRANSZ] / (sensitivities[SENS_POS_TRANSZ] * SENSOR_SCALE));  // linear positive half of modifierTransZ, constrained
   }
 
   // rotX
-  velocity[ROTX] = velocity[ROTX] / ((float)ROTX_SENSITIVITY);
+  velocity[ROTX] = velocity[ROTX] / (sensitivities[SENS_ROTX] * SENSOR_SCALE);
   velocity[ROTX] = modifierFunction(velocity[ROTX]);  // recalculate with modifier function
-  if (abs(velocity[ROTX]) < GATE_ROTX) {
+  if (abs(velocity[ROTX]) < gates[GATEIDX_ROTX]) {
     velocity[ROTX] = 0;
   }
 
   // rotY
-  velocity[ROTY] = velocity[ROTY] / ((float)ROTY_SENSITIVITY);
+  velocity[ROTY] = velocity[ROTY] / (sensitivities[SENS_ROTY] * SENSOR_SCALE);
   velocity[ROTY] = modifierFunction(velocity[ROTY]);  // recalculate with modifier function
-  if (abs(velocity[ROTY]) < GATE_ROTY) {
+  if (abs(velocity[ROTY]) < gates[GATEIDX_ROTY]) {
     velocity[ROTY] = 0;
   }
 
   // rotZ
-  velocity[ROTZ] = velocity[ROTZ] / ((float)ROTZ_SENSITIVITY);
+  velocity[ROTZ] = velocity[ROTZ] / (sensitivities[SENS_ROTZ] * SENSOR_SCALE);
   velocity[ROTZ] = modifierFunction(velocity[ROTZ]);  // recalculate with modifier function
-  if (abs(velocity[ROTZ]) < GATE_ROTZ) {
+  if (abs(velocity[ROTZ]) < gates[GATEIDX_ROTZ]) {
     velocity[ROTZ] = 0;
   }
 
@@ -282,3 +375,4 @@ void exclusiveMode(int16_t *velocity) {
  * Rotz-cclock  Horizontal      +   0   +   0   +   0   +   0   ||  -   +   -   +   -   +   -   +
  *
  */
+#endif
@@ -0,0 +1,84 @@
+// This file contains the echo of the latency probes of the host, see LATENCY_PROBE in config.h
+// The host writes a probe id with the output report 5 and reads the feature report 5 right after it.
+// The feature report echoes the probe id together with the timestamps of the device, so the host can calculate
+// - the round trip time: from writing the probe to receiving the echo, measured by the host
+// - sample to send: from the sensor frame behind the latest motion report to the moment it was handed to the USB
+// See tools/latency_probe.py
+//
+// Feature report 5, little endian:
+//   uint32  probe id, as written by the host
+//   uint32  time in us, when the probe was received
+//   uint32  time in us, when the echo was requested
+//   uint32  time in us of the sensor frame behind the latest motion report
+//   uint32  time in us, when the latest motion report was handed to the USB
+//   uint32  loop sequence number
+//   uint8   queue depth: pending reports in the hidScheduler
+// The probe and the echo are handled by the USB task, while the loop() updates the timestamps. Each value is a single
+// aligned word, but the values may come from two consecutive loops.
+// There are no dependencies to the Arduino framework, so the echo can be tested on a host.
+
+#ifndef LATENCYPROBE_H
+#define LATENCYPROBE_H
+#include <stdint.h>
+#include <stddef.h>
+
+#define LATENCY_PROBE_ID 5    // report id of the output and the feature report
+#define LATENCY_PROBE_SIZE 4  // output report: probe id
+#define LATENCY_ECHO_SIZE 25  // feature report
+
+class LatencyProbe {
+public:
+  /// @brief Call it once per loop() with the time of the current sensor frame
+  void loopStart(uint32_t frameUs) {
+    currentFrameUs = frameUs;
+    loopSeq++;
+  }
+
+  /// @brief A motion report with the values of the current sensor frame was posted
+  void motionPosted() {
+    pendingFrameUs = currentFrameUs;
+  }
+
+  /// @brief The latest posted motion report was handed to the USB
+  void motionSent(uint32_t nowUs) {
+    frameUs = pendingFrameUs;
+    sentUs = nowUs;
+  }
+
+  /// @brief Store the probe id of the output report
+  void probe(const uint8_t* buffer, uint16_t len, uint32_t nowUs) {
+    if (len < LATENCY_PROBE_SIZE) return;
+    probeId = buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+    probeUs = nowUs;
+  }
+
+  /// @brief Fill the feature report with the echo
+  /// @return size of the report, 0 if the buffer is too small
+  uint16_t echo(uint8_t* buffer, uint16_t len, uint32_t nowUs, uint8_t queueDepth) {
+    if (len < LATENCY_ECHO_SIZE) return 0;
+    uint8_t* p = buffer;
+    p = putUint32LE(p, probeId);
+    p = putUint32LE(p, probeUs);
+    p = putUint32LE(p, nowUs);
+    p = putUint32LE(p, frameUs);
+    p = putUint32LE(p, sentUs);
+    p = putUint32LE(p, loopSeq);
+    *p = queueDepth;
+    return LATENCY_ECHO_SIZE;
+  }
+
+private:
+  static uint8_t* putUint32LE(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) *p++ = value >> (8 * i);
+    return p;
+  }
+
+  volatile uint32_t probeId = 0;
+  volatile uint32_t probeUs = 0;
+  volatile uint32_t currentFrameUs = 0;
+  volatile uint32_t pendingFrameUs = 0;
+  volatile uint32_t frameUs = 0;
+  volatile uint32_t sentUs = 0;
+  volatile uint32_t loopSeq = 0;
+};
+#endif
@@ -41,6 +41,12 @@ void initLEDring() {
 
 
 
+/// @brief Set the brightness of the LED ring, e.g. by the power governor
+void setLEDbrightness(uint8_t brightness) {
+  FastLED.setBrightness(brightness);
+  FastLED.show();
+}
+
 void updateLEDsBasedOnMotion(int16_t *velocity, bool State) {
   unsigned long now = millis();
   static unsigned long lastLEDupdate = now;
@@ -0,0 +1,199 @@
+// This file contains the lookup tables for the modifier function, see modifierFunction() in kinematics.h
+// The tables are generated by the compiler (constexpr) over the whole domain of -350 ... 350 and stored in the flash.
+// Therefore, no pow(), tan() or round() in double precision is needed at runtime anymore.
+//
+// Every curve consists of a positive and a negative half, so asymmetric curves are possible, e.g. for TRANSZ,
+// where the positive half is always linear.
+// Curves 0 ... 4 are bit-exact with the former calculation, curve 5 is a cubic Bezier curve (MODFUNC_BEZIER)
+// and curve 6 is a Catmull-Rom spline through the points in MODFUNC_SPLINE.
+// There are no dependencies to the Arduino framework, so the curves can be tested on a host.
+
+#ifndef MODIFIERLUT_H
+#define MODIFIERLUT_H
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include <stdint.h>
+
+#define MODIFIER_RANGE 350
+#define NUM_MODIFIER_CURVES 7
+
+// SECTION CONSTEXPR MATH
+// The standard math functions are not constexpr, therefore they are replaced by series, which are exact enough
+// to give the same result as the double functions after rounding.
+
+constexpr double lutSin(double x) {
+  double term = x;
+  double sum = x;
+  for (int n = 1; n < 20; n++) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double lutCos(double x) {
+  double term = 1;
+  double sum = 1;
+  for (int n = 1; n < 20; n++) {
+    term *= -x * x / ((2 * n - 1) * (2 * n));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double lutTan(double x) {
+  return lutSin(x) / lutCos(x);
+}
+
+constexpr double lutSign(double x) {
+  return (x < 0) ? -1 : ((x > 0) ? 1 : 0);
+}
+
+/// @brief round half away from zero and limit to the modifier range, like constrain() and round() did before
+constexpr int16_t lutRound(double x) {
+  if (x > MODIFIER_RANGE) x = MODIFIER_RANGE;
+  if (x < -MODIFIER_RANGE) x = -MODIFIER_RANGE;
+  return (x < 0) ? -(int16_t)(-x + 0.5) : (int16_t)(x + 0.5);
+}
+// !SECTION CONSTEXPR MATH
+
+// SECTION CURVES
+// every curve gets the input x between -350 and 350
+
+constexpr double curveLinear(int x) {
+  return x;
+}
+
+// squared function y = x^2*sign(x)
+constexpr double curveSquared(int x) {
+  return 350 * ((x / 350.0) * (x / 350.0)) * lutSign(x);
+}
+
+// tan function: tan(x)
+constexpr double curveTan(int x) {
+  return 350 * lutTan(x / 350.0);
+}
+
+// squared tan function: tan(x^2*sign(x))
+constexpr double curveSquaredTan(int x) {
+  return 350 * lutTan((x / 350.0) * (x / 350.0) * lutSign(x));
+}
+
+// cubed tan function: tan(x^3)
+constexpr double curveCubedTan(int x) {
+  return 350 * lutTan((x / 350.0) * (x / 350.0) * (x / 350.0));
+}
+
+// cubic Bezier curve from (0,0) to (1,1) with the control points MODFUNC_BEZIER = { x1, y1, x2, y2 }, mirrored for x < 0
+constexpr double curveBezier(int x) {
+  constexpr double p[4] = MODFUNC_BEZIER;
+  double u = (x < 0 ? -x : x) / 350.0;
+  // find the curve parameter t for u by bisection, x(t) is monotonic for control points within [0,1]
+  double lo = 0, hi = 1, t = 0.5;
+  for (int i = 0; i < 60; i++) {
+    t = (lo + hi) / 2;
+    double bx = 3 * (1 - t) * (1 - t) * t * p[0] + 3 * (1 - t) * t * t * p[2] + t * t * t;
+    if (bx < u) {
+      lo = t;
+    } else {
+      hi = t;
+    }
+  }
+  double by = 3 * (1 - t) * (1 - t) * t * p[1] + 3 * (1 - t) * t * t * p[3] + t * t * t;
+  return 350 * by * lutSign(x);
+}
+
+// Catmull-Rom spline through the points MODFUNC_SPLINE, which are equally spaced between x = 0 and x = 1, mirrored for x < 0
+constexpr double curveSpline(int x) {
+  constexpr double p[] = MODFUNC_SPLINE;
+  constexpr int n = sizeof(p) / sizeof(p[0]);
+  double u = (x < 0 ? -x : x) / 350.0 * (n - 1);
+  int k = (int)u;
+  if (k > n - 2) k = n - 2;
+  double t = u - k;
+  double p0 = (k > 0) ? p[k - 1] : 2 * p[0] - p[1];
+  double p1 = p[k];
+  double p2 = p[k + 1];
+  double p3 = (k + 2 < n) ? p[k + 2] : 2 * p[n - 1] - p[n - 2];
+  double y = 0.5 * (2 * p1 + (-p0 + p2) * t + (2 * p0 - 5 * p1 + 4 * p2 - p3) * t * t + (-p0 + 3 * p1 - 3 * p2 + p3) * t * t * t);
+  return 350 * y * lutSign(x);
+}
+// !SECTION CURVES
+
+/// @brief One half of a curve, index is abs(x)
+struct ModifierHalf {
+  int16_t v[MODIFIER_RANGE + 1];
+};
+
+/// @brief Generate one half of a curve at compile time
+/// @param curve function of the curve
+/// @param sign 1 for the positive half, -1 for the negative half
+constexpr ModifierHalf makeModifierHalf(double (*curve)(int), int sign) {
+  ModifierHalf half = {};
+  for (int i = 0; i <= MODIFIER_RANGE; i++) {
+    half.v[i] = lutRound(curve(sign * i));
+  }
+  return half;
+}
+
+#define MODIFIER_HALVES(name, curve) \
+  constexpr ModifierHalf name##Pos = makeModifierHalf(curve, 1); \
+  constexpr ModifierHalf name##Neg = makeModifierHalf(curve, -1);
+
+MODIFIER_HALVES(lutLinear, curveLinear)
+MODIFIER_HALVES(lutSquared, curveSquared)
+MODIFIER_HALVES(lutTan, curveTan)
+MODIFIER_HALVES(lutSquaredTan, curveSquaredTan)
+MODIFIER_HALVES(lutCubedTan, curveCubedTan)
+MODIFIER_HALVES(lutBezier, curveBezier)
+MODIFIER_HALVES(lutSpline, curveSpline)
+
+/// @brief A curve made of two halves
+struct ModifierCurve {
+  const int16_t* pos;
+  const int16_t* neg;
+
+  int apply(int x) const {
+    if (x > MODIFIER_RANGE) x = MODIFIER_RANGE;
+    if (x < -MODIFIER_RANGE) x = -MODIFIER_RANGE;
+    return (x >= 0) ? pos[x] : neg[-x];
+  }
+
+  /// @brief Apply the curve to a Q16.16 value and interpolate linearly between the table entries, see fixedPipeline.h
+  /// @param x input in Q16.16
+  /// @return output in Q16.16 between -350 and +350
+  int32_t applyQ16(int32_t x) const {
+    const int32_t limit = (int32_t)MODIFIER_RANGE << 16;
+    if (x > limit) x = limit;
+    if (x < -limit) x = -limit;
+    const int16_t* half = (x >= 0) ? pos : neg;
+    uint32_t ax = (x >= 0) ? x : -x;
+    uint32_t i = ax >> 16;
+    int32_t frac = ax & 0xFFFF;
+    int32_t y = (int32_t)half[i] * 65536;
+    if (i < MODIFIER_RANGE) y += (half[i + 1] - half[i]) * frac;
+    return y;
+  }
+};
+
+// all curves, selected by modFunc
+const ModifierCurve modifierCurves[NUM_MODIFIER_CURVES] = {
+  { lutLinearPos.v, lutLinearNeg.v },
+  { lutSquaredPos.v, lutSquaredNeg.v },
+  { lutTanPos.v, lutTanNeg.v },
+  { lutSquaredTanPos.v, lutSquaredTanNeg.v },
+  { lutCubedTanPos.v, lutCubedTanNeg.v },
+  { lutBezierPos.v, lutBezierNeg.v },
+  { lutSplinePos.v, lutSplineNeg.v },
+};
+
+/// @brief Get the curve for modFunc. Unknown values fall back to linear, like before.
+/// @param modFunc number of the curve, see MODFUNC in config.h
+/// @param linearPositive use a linear positive half (asymmetric curve for TRANSZ)
+inline ModifierCurve getModifierCurve(uint8_t modFunc, bool linearPositive) {
+  ModifierCurve curve = (modFunc < NUM_MODIFIER_CURVES) ? modifierCurves[modFunc] : modifierCurves[0];
+  if (linearPositive) curve.pos = lutLinearPos.v;
+  return curve;
+}
+#endif
@@ -0,0 +1,113 @@
+// This file contains the adaptive smoothing of the velocities, see ONE_EURO in config.h
+// The Kalman filters of the sensors smooth with the same strength, whether the knob is almost still or moved fast.
+// The one-euro filter (Casiez et al., CHI 2012) is a first order low pass, whose cutoff frequency rises with the speed of the change:
+//   cutoff = minCutoff + beta * |dx/dt|
+// A slowly moving or held knob gets a low cutoff against the jitter, a fast movement a high cutoff against the lag.
+// The derivative itself is smoothed with the fixed cutoff dCutoff.
+//
+// A velocity of exactly zero (knob within the deadzone, killed axis, exclusive mode) is passed through immediately and resets
+// the filter of this axis, so the knob stops without delay and the next movement starts from zero again.
+
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include <stdint.h>
+#include <math.h>
+
+class OneEuroFilter {
+public:
+  /// @brief Set the parameters of the filter
+  /// @param minCutoff cutoff frequency in Hz at rest
+  /// @param beta increase of the cutoff frequency in Hz per unit/s of the derivative
+  /// @param dCutoff cutoff frequency in Hz of the derivative
+  void configure(float minCutoff, float beta, float dCutoff) {
+    this->minCutoff = minCutoff;
+    this->beta = beta;
+    this->dCutoff = dCutoff;
+  }
+
+  /// @brief Start at rest
+  void reset() {
+    x = 0;
+    dx = 0;
+  }
+
+  /// @brief Filter the next value
+  /// @param value new value
+  /// @param dt time since the last value in s, > 0
+  /// @return filtered value
+  float filter(float value, float dt) {
+    dx += alpha(dCutoff, dt) * ((value - x) / dt - dx);
+    x += alpha(minCutoff + beta * fabsf(dx), dt) * (value - x);
+    return x;
+  }
+
+private:
+  /// @brief Smoothing factor of an exponential low pass with the given cutoff frequency
+  static float alpha(float cutoff, float dt) {
+    float tau = 1.0f / (2.0f * (float)M_PI * cutoff);
+    return 1.0f / (1.0f + tau / dt);
+  }
+
+  float minCutoff = 1.0f;
+  float beta = 0.0f;
+  float dCutoff = 1.0f;
+  float x = 0;   // filtered value
+  float dx = 0;  // filtered derivative in units/s
+};
+
+class VelocitySmoother {
+public:
+  VelocitySmoother() {
+    for (int axis = 0; axis < 6; axis++) {
+      if (axis < 3) {
+        filters[axis].configure(ONE_EURO_MINCUTOFF_TRANS, ONE_EURO_BETA_TRANS, ONE_EURO_DCUTOFF);
+      } else {
+        filters[axis].configure(ONE_EURO_MINCUTOFF_ROT, ONE_EURO_BETA_ROT, ONE_EURO_DCUTOFF);
+      }
+    }
+    reset();
+  }
+
+  /// @brief Start all axis at rest
+  void reset() {
+    for (int axis = 0; axis < 6; axis++) {
+      filters[axis].reset();
+      out[axis] = 0;
+    }
+    started = false;
+  }
+
+  /// @brief Smooth the velocities. The filters are only updated, when the time has changed, i.e. for a new sensor frame.
+  /// @param velocity the six velocities, replaced by the smoothed values
+  /// @param timeUs timestamp of the sensor frame, the velocities are calculated from
+  void apply(int16_t* velocity, uint32_t timeUs) {
+    if (!enabled) return;
+    bool newFrame = !started || timeUs != lastTimeUs;
+    // the time since the last frame, limited to catch the start and long pauses of the loop()
+    float dt = started ? (uint32_t)(timeUs - lastTimeUs) * 1e-6f : 0.001f;
+    if (dt > 0.1f) dt = 0.1f;
+    started = true;
+    lastTimeUs = timeUs;
+
+    for (int axis = 0; axis < 6; axis++) {
+      if (velocity[axis] == 0) {
+        filters[axis].reset();
+        out[axis] = 0;
+      } else if (newFrame) {
+        out[axis] = (int16_t)lroundf(filters[axis].filter(velocity[axis], dt));
+      }
+      velocity[axis] = out[axis];
+    }
+  }
+
+  bool enabled = true;  // switched off to compare the responses, see debug mode 37
+
+private:
+  OneEuroFilter filters[6];
+  int16_t out[6];  // last smoothed velocities
+  uint32_t lastTimeUs;
+  bool started;
+};
+
+VelocitySmoother velocitySmoother;
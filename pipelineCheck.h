@@ -0,0 +1,188 @@
+// This file contains the comparison of the fixed point and the fused pipeline with the original processing of the loop(),
+// i.e. FilterAnalogReadOuts(), calculateKinematic(), the kill-keys, switchYZ() and exclusiveMode().
+// It is used by the benchmarks on the spacemouse (debug mode 13) and by the host harness test/fixed_sweep.cpp.
+
+#ifndef PIPELINECHECK_H
+#define PIPELINECHECK_H
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include "kinematics.h"
+#include "fixedPipeline.h"
+#include "fusedPipeline.h"
+
+/// @brief Generate a random frame of centered values within the calibrated range of each sensor
+/// @param seed state of the random generator
+/// @param centered pointer to 8 values
+void randomCenteredFrame(uint32_t& seed, int* centered) {
+  for (int i = 0; i < 8; i++) {
+    seed = seed * 1103515245 + 12345;
+    int range = (maxVals[i] - minVals[i]) * SENSOR_SCALE;
+    centered[i] = minVals[i] * SENSOR_SCALE + (int)((seed >> 8) % (range > 0 ? range : 1));
+  }
+}
+
+// deviation between the original and the fixed point pipeline
+struct PipelineDeviation {
+  int maxDeviation;     // maximum difference of a velocity, without the gate edges
+  uint32_t deviations;  // number of differing velocities
+  uint32_t gateEdges;   // number of velocities, which are set to zero by only one of the pipelines at a gate
+  uint32_t groupFlips;  // number of frames, in which the exclusive mode of the pipelines zeroed different groups
+  int maxFlipMargin;    // largest difference of the totals of the two reported groups in such a frame, 0 = exact tie
+  uint32_t comparisons;
+
+  /// @brief Track the deviation of one frame
+  /// @param reference velocities of the original pipeline
+  /// @param velocity velocities of the pipeline under test
+  void add(const int16_t* reference, const int16_t* velocity) {
+    bool referenceTrans = isZero(reference + TRANSX);
+    bool referenceRot = isZero(reference + ROTX);
+    bool trans = isZero(velocity + TRANSX);
+    bool rot = isZero(velocity + ROTX);
+    if ((referenceTrans && !referenceRot && !trans && rot) || (referenceRot && !referenceTrans && !rot && trans)) {
+      // not a matter of rounding: the whole other group is reported. Only allowed, if the totals were (almost) equal.
+      groupFlips++;
+      comparisons += 6;
+      int margin = abs(total(reference + (referenceTrans ? ROTX : TRANSX)) - total(velocity + (trans ? ROTX : TRANSX)));
+      if (margin > maxFlipMargin) maxFlipMargin = margin;
+      return;
+    }
+    for (int i = 0; i < 6; i++) {
+      int d = abs(reference[i] - velocity[i]);
+      comparisons++;
+      if (d == 0) continue;
+      deviations++;
+      if ((reference[i] == 0) != (velocity[i] == 0)) {
+        // the value is close to a gate and rounded up by the fixed point pipeline, but truncated by the original one
+        gateEdges++;
+      } else if (d > maxDeviation) {
+        maxDeviation = d;
+      }
+    }
+  }
+
+  void report(const char* name) {
+    SERIAL.printf("%s max. deviation %d counts, %lu of %lu velocities differ, %lu at the edge of a gate, %lu group flips (margin %d)\n",
+                  name, maxDeviation, (unsigned long)deviations, (unsigned long)comparisons, (unsigned long)gateEdges,
+                  (unsigned long)groupFlips, maxFlipMargin);
+  }
+
+private:
+  static bool isZero(const int16_t* group) {
+    return group[0] == 0 && group[1] == 0 && group[2] == 0;
+  }
+
+  static int total(const int16_t* group) {
+    return abs(group[0]) + abs(group[1]) + abs(group[2]);
+  }
+};
+
+/// @brief The single steps of the loop() one after another, as reference for the fused pipeline.
+/// The build variants are template parameters, so the host harness can check every variant, not only the one of this build.
+/// @tparam FIXED steps of the fixed point pipeline instead of FilterAnalogReadOuts() and calculateKinematic()
+/// @tparam SWAP_YZ like SWITCHYZ 1
+/// @tparam EXCLUSIVE like EXCLUSIVEMODE
+/// @tparam KILL_ROT key of the kill-key of the rotations, -1 without kill-keys
+/// @tparam KILL_TRANS key of the kill-key of the translations, -1 without kill-keys
+template<bool FIXED, bool SWAP_YZ, bool EXCLUSIVE, int KILL_ROT, int KILL_TRANS>
+void referenceSteps(int* centered, const int* keyVals, int16_t* velocity) {
+  if (FIXED) {
+    int32_t mapped[8];
+    fixedPipeline.filter(centered, mapped);
+    fixedPipeline.kinematic(mapped, velocity);
+  } else {
+    FilterAnalogReadOuts(centered);
+    calculateKinematic(centered, velocity);
+  }
+  if (KILL_ROT >= 0 && keyVals[KILL_ROT] == LOW) {
+    velocity[ROTX] = 0;
+    velocity[ROTY] = 0;
+    velocity[ROTZ] = 0;
+  }
+  if (KILL_TRANS >= 0 && keyVals[KILL_TRANS] == LOW) {
+    velocity[TRANSX] = 0;
+    velocity[TRANSY] = 0;
+    velocity[TRANSZ] = 0;
+  }
+  if (SWAP_YZ) switchYZ(velocity);
+  if (EXCLUSIVE) exclusiveMode(velocity);
+}
+
+// the variants of this build for referenceSteps()
+#ifdef EXCLUSIVEMODE
+#define REFERENCE_EXCLUSIVE true
+#else
+#define REFERENCE_EXCLUSIVE false
+#endif
+#if (NUMKILLKEYS == 2)
+#define REFERENCE_KILLROT KILLROT
+#define REFERENCE_KILLTRANS KILLTRANS
+#else
+#define REFERENCE_KILLROT -1
+#define REFERENCE_KILLTRANS -1
+#endif
+
+/// @brief The original steps of the loop() of this build one after another, as reference for the fused pipeline
+void referencePipeline(int* centered, const int* keyVals, int16_t* velocity) {
+  referenceSteps<false, (SWITCHYZ > 0), REFERENCE_EXCLUSIVE, REFERENCE_KILLROT, REFERENCE_KILLTRANS>(centered, keyVals, velocity);
+}
+
+/// @brief Run the original and the fixed point pipeline on the same input and track the deviation of the velocities
+/// @param centered 8 centered values, not changed
+/// @param deviation statistics, is updated
+void compareFixedPipeline(const int* centered, PipelineDeviation& deviation) {
+  int referenceIn[8];
+  int fixedIn[8];
+  int32_t mapped[8];
+  int16_t referenceVelocity[6];
+  int16_t fixedVelocity[6];
+  memcpy(referenceIn, centered, sizeof(referenceIn));
+  memcpy(fixedIn, centered, sizeof(fixedIn));
+  FilterAnalogReadOuts(referenceIn);
+  calculateKinematic(referenceIn, referenceVelocity);
+  fixedPipeline.filter(fixedIn, mapped);
+  fixedPipeline.kinematic(mapped, fixedVelocity);
+  deviation.add(referenceVelocity, fixedVelocity);
+}
+
+/// @brief Run the single steps and a fused pipeline with the same variants on the same input and track the deviation
+/// @tparam Fused the fused pipeline, e.g. FusedPipeline<SwapYZ, ExclusiveTransRot, NoKillKeys>
+/// @tparam FIXED, SWAP_YZ, EXCLUSIVE, KILL_ROT, KILL_TRANS the steps of the reference, see referenceSteps()
+/// @param centered 8 centered values, not changed
+/// @param keyVals raw key values for the kill-keys
+/// @param deviation statistics, is updated
+template<class Fused, bool FIXED, bool SWAP_YZ, bool EXCLUSIVE, int KILL_ROT, int KILL_TRANS>
+void compareFusedVariant(const int* centered, const int* keyVals, PipelineDeviation& deviation) {
+  int referenceIn[8];
+  int fusedIn[8];
+  int16_t referenceVelocity[6];
+  int16_t fusedVelocity[6];
+  memcpy(referenceIn, centered, sizeof(referenceIn));
+  memcpy(fusedIn, centered, sizeof(fusedIn));
+  referenceSteps<FIXED, SWAP_YZ, EXCLUSIVE, KILL_ROT, KILL_TRANS>(referenceIn, keyVals, referenceVelocity);
+  Fused::run(fusedIn, keyVals, fusedVelocity);
+  deviation.add(referenceVelocity, fusedVelocity);
+}
+
+/// @brief Run the original steps of the loop() and the fused pipeline of this build on the same input and track the deviation
+/// @param centered 8 centered values, not changed
+/// @param keyVals raw key values for the kill-keys
+/// @param deviation statistics, is updated
+void compareFusedPipeline(const int* centered, const int* keyVals, PipelineDeviation& deviation) {
+  compareFusedVariant<Pipeline, false, (SWITCHYZ > 0), REFERENCE_EXCLUSIVE, REFERENCE_KILLROT, REFERENCE_KILLTRANS>(centered, keyVals,
+                                                                                                                   deviation);
+}
+
+/// @brief Sweep every sensor over its whole range, while the others are zero
+/// @param deviation statistics of the fixed point pipeline, is updated
+void sweepFixedPipeline(PipelineDeviation& deviation) {
+  int centered[8];
+  for (int sensor = 0; sensor < 8; sensor++) {
+    for (int c = (minVals[sensor] - 16) * SENSOR_SCALE; c <= (maxVals[sensor] + 16) * SENSOR_SCALE; c++) {
+      memset(centered, 0, sizeof(centered));
+      centered[sensor] = c;
+      compareFixedPipeline(centered, deviation);
+    }
+  }
+}
+#endif
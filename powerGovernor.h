@@ -0,0 +1,123 @@
+// This file contains the power governor, see POWER_GOVERNOR in config.h
+// It switches between three states, each with its own profile of sampling period, CPU frequency, display and LED:
+// - active:    full rate, while the knob is moved
+// - idle:      after POWER_IDLE_MS without motion. The sensors are only scanned every POWER_IDLE_SCAN_US, the CPU runs slower,
+//              the display is refreshed rarely and the LEDs are dimmed. Every scan publishes a frame of the ADC scans since the
+//              last one, without waiting for OVERSAMPLING_RATIO scans, so the first scan with motion switches back to active.
+// - suspended: while the host has suspended the USB. Slowest scan, display and LEDs off, until the host resumes.
+// The time is given by the caller, so the state machine can be tested on a host with virtual time.
+// There are no dependencies to the Arduino framework.
+
+#ifndef POWERGOVERNOR_H
+#define POWERGOVERNOR_H
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include <stdint.h>
+
+enum PowerState {
+  POWER_ACTIVE,
+  POWER_IDLE,
+  POWER_SUSPENDED
+};
+
+struct PowerProfile {
+  uint32_t samplePeriodUs;  // period of the sampling task
+  uint16_t loopDelayMs;     // pause at the end of each loop(), 0 = none
+  bool partialFrames;       // publish a frame on every scan, even with less than OVERSAMPLING_RATIO ADC scans, see adcEngine.h
+  uint16_t cpuMHz;
+  uint16_t screenDelayMs;   // time between two refreshes of the display
+  bool displayOn;
+  uint8_t ledBrightness;
+};
+
+class PowerGovernor {
+public:
+  /// @param profiles profile of each PowerState
+  /// @param idleMs time without motion, until the state changes from active to idle
+  PowerGovernor(const PowerProfile* profiles, uint32_t idleMs)
+    : profiles(profiles), idleMs(idleMs) {}
+
+  /// @brief Update the state, call it once per loop()
+  /// @param nowUs current time in us
+  /// @param firstScanUs time of the first ADC scan of the evaluated frame: if the frame shows motion, the motion isn't older
+  /// @param motion true, if the frame shows motion above the threshold or a key is pressed
+  /// @param hostSuspended true, if the host has suspended the USB
+  /// @return true, if the state has changed and the profile must be applied
+  bool update(uint32_t nowUs, uint32_t firstScanUs, bool motion, bool hostSuspended) {
+    PowerState next = current;
+    if (motion) lastMotionUs = nowUs;
+    if (hostSuspended) {
+      next = POWER_SUSPENDED;
+    } else if (current == POWER_SUSPENDED) {
+      next = POWER_ACTIVE;  // the host resumed and wants the data
+      lastMotionUs = nowUs;
+    } else if (motion) {
+      next = POWER_ACTIVE;
+    } else if (nowUs - lastMotionUs >= idleMs * 1000) {
+      next = POWER_IDLE;
+    }
+    if (next == current) return false;
+
+    if (current == POWER_IDLE && next == POWER_ACTIVE) {
+      // from the first scan of the frame, which showed the motion, until the active profile is applied
+      wakes++;
+      lastWakeUs = nowUs - firstScanUs;
+      if (lastWakeUs > maxWakeUs) maxWakeUs = lastWakeUs;
+      wakeSumUs += lastWakeUs;
+    }
+    current = next;
+    transitions++;
+    return true;
+  }
+
+  PowerState state() const {
+    return current;
+  }
+
+  const PowerProfile& profile() const {
+    return profiles[current];
+  }
+
+  const char* stateName() const {
+    static const char* names[] = { "active", "idle", "suspended" };
+    return names[current];
+  }
+
+  /// @brief mean time from the first scan of the frame with motion until the active profile was applied in us
+  uint32_t meanWakeUs() const {
+    return wakes ? wakeSumUs / wakes : 0;
+  }
+
+  uint32_t transitions = 0;  // changes of the state
+  uint32_t wakes = 0;        // changes from idle to active
+  uint32_t lastWakeUs = 0;   // wake latency of the last wake
+  uint32_t maxWakeUs = 0;
+  uint64_t wakeSumUs = 0;
+
+private:
+  const PowerProfile* profiles;
+  uint32_t idleMs;
+  PowerState current = POWER_ACTIVE;
+  uint32_t lastMotionUs = 0;
+};
+
+#if defined(ARDUINO) && POWER_GOVERNOR > 0
+#if SAMPLING_TASK > 0
+#define POWER_IDLE_LOOP_DELAY 1  // the sampling task scans the sensors, the loop() only needs to pick up the frames
+#define POWER_SUSPENDED_LOOP_DELAY 1
+#else
+#define POWER_IDLE_LOOP_DELAY (POWER_IDLE_SCAN_US / 1000)  // the loop() scans the sensors itself
+#define POWER_SUSPENDED_LOOP_DELAY (POWER_SUSPENDED_SCAN_US / 1000)
+#endif
+
+// sample period, loop delay, partial frames, CPU, display delay, display on, LED brightness
+const PowerProfile powerProfiles[] = {
+  { SAMPLING_PERIOD_US, 0, false, POWER_ACTIVE_CPU_MHZ, SCREEN_REFRESH_DELAY, true, POWER_ACTIVE_LED_BRIGHTNESS },                    // active
+  { POWER_IDLE_SCAN_US, POWER_IDLE_LOOP_DELAY, true, POWER_IDLE_CPU_MHZ, POWER_IDLE_SCREEN_DELAY, true, POWER_IDLE_LED_BRIGHTNESS },  // idle
+  { POWER_SUSPENDED_SCAN_US, POWER_SUSPENDED_LOOP_DELAY, true, POWER_IDLE_CPU_MHZ, POWER_IDLE_SCREEN_DELAY, false, 0 },              // suspended
+};
+
+PowerGovernor powerGovernor(powerProfiles, POWER_IDLE_MS);
+#endif
+#endif
@@ -0,0 +1,138 @@
+// This file contains the profiler of the loop(), see PROFILER in config.h
+// The cpu cycles of every stage of the loop() are measured with the cycle counter and collected in a histogram per stage.
+// Debug mode 14 reports min, mean, p99 and max of every stage as table and starts a new measurement.
+// The histogram has 8 buckets per power of two, so the p99 is exact within 1/8 (12.5 %). Recording a value needs only a few dozen cycles.
+// With PROFILER 0, the PROFILE_BEGIN() and PROFILE_END() macros are empty and nothing of this file is compiled.
+
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+
+#if PROFILER > 0
+#include <stdint.h>
+#include <string.h>
+
+enum ProfileStage {
+  PROF_SENSORS,     // reading the sensor frame and the keys
+  PROF_CENTERING,   // subtracting the center points
+  PROF_FILTER,      // deadzone and mapping (the whole fused pipeline with FUSED_PIPELINE)
+  PROF_KINEMATICS,  // matrix, sensitivities and modifier function without FUSED_PIPELINE
+  PROF_KEYS,        // evalKeys()
+  PROF_SMOOTHING,   // one-euro filter of the velocities
+  PROF_DISPLAY,     // displayScreen()
+  PROF_USB,         // sendUSBData()
+  PROF_BATTERY,     // sendBattery()
+  PROF_LED,         // updateLEDsBasedOnMotion()
+  PROF_LOOP,        // the whole loop()
+  NUM_PROF_STAGES
+};
+
+const char* const profileStageNames[NUM_PROF_STAGES] = {
+  "sensors", "centering", "filter", "kinematics", "keys", "smoothing", "display", "sendUSBData", "sendBattery", "LEDs", "loop total"
+};
+
+#define PROFILE_SUBBUCKETS 8     // buckets per power of two
+#define PROFILE_MAX_EXPONENT 26  // values from 2^27 cycles on go into the last bucket
+// exact buckets for 0..7, then PROFILE_SUBBUCKETS per power of two
+#define PROFILE_BUCKETS ((PROFILE_MAX_EXPONENT - 1) * PROFILE_SUBBUCKETS)
+
+class ProfileHistogram {
+public:
+  void reset() {
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    sum = 0;
+    min = UINT32_MAX;
+    max = 0;
+  }
+
+  inline void add(uint32_t cycles) {
+    buckets[bucket(cycles)]++;
+    count++;
+    sum += cycles;
+    if (cycles < min) min = cycles;
+    if (cycles > max) max = cycles;
+  }
+
+  /// @brief Upper bound of the given percentile
+  /// @param percent 0 ... 100
+  /// @return cycles, which are not exceeded by percent of the values
+  uint32_t percentile(uint32_t percent) const {
+    uint64_t rank = ((uint64_t)count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < PROFILE_BUCKETS; i++) {
+      seen += buckets[i];
+      if (seen >= rank && seen > 0) {
+        uint32_t upper = (i < PROFILE_BUCKETS - 1) ? upperBound(i) : max;  // the last bucket is open
+        return (upper < max) ? upper : max;
+      }
+    }
+    return max;
+  }
+
+  uint32_t count;
+  uint64_t sum;
+  uint32_t min;
+  uint32_t max;
+
+private:
+  static inline int bucket(uint32_t v) {
+    if (v < PROFILE_SUBBUCKETS) return v;
+    int e = 31 - __builtin_clz(v);  // >= 3
+    if (e > PROFILE_MAX_EXPONENT) return PROFILE_BUCKETS - 1;
+    return (e - 2) * PROFILE_SUBBUCKETS + ((v >> (e - 3)) & (PROFILE_SUBBUCKETS - 1));
+  }
+
+  static uint32_t upperBound(int i) {
+    if (i < PROFILE_SUBBUCKETS) return i;
+    int e = i / PROFILE_SUBBUCKETS + 2;
+    uint32_t sub = i % PROFILE_SUBBUCKETS;
+    return ((PROFILE_SUBBUCKETS + sub + 1) << (e - 3)) - 1;
+  }
+
+  uint32_t buckets[PROFILE_BUCKETS];
+};
+
+class Profiler {
+public:
+  Profiler() {
+    reset();
+  }
+
+  void reset() {
+    for (int s = 0; s < NUM_PROF_STAGES; s++) stages[s].reset();
+  }
+
+  inline void add(ProfileStage stage, uint32_t cycles) {
+    stages[stage].add(cycles);
+  }
+
+  /// @brief Print the table of all stages in us and start a new measurement
+  void report() {
+    float mhz = getCpuFrequencyMhz();
+    const ProfileHistogram& loop = stages[PROF_LOOP];
+    SERIAL.printf("%-12s %8s %9s %9s %9s %9s %6s\n", "stage", "calls", "min us", "mean us", "p99 us", "max us", "share");
+    for (int s = 0; s < NUM_PROF_STAGES; s++) {
+      const ProfileHistogram& h = stages[s];
+      if (h.count == 0) continue;  // stage not used in this build
+      SERIAL.printf("%-12s %8lu %9.2f %9.2f %9.2f %9.2f %5.1f%%\n", profileStageNames[s], (unsigned long)h.count,
+                    h.min / mhz, (float)h.sum / h.count / mhz, h.percentile(99) / mhz, h.max / mhz,
+                    loop.sum ? 100.0f * h.sum / loop.sum : 0.0f);
+    }
+    reset();
+  }
+
+private:
+  ProfileHistogram stages[NUM_PROF_STAGES];
+};
+
+Profiler profiler;
+
+// measure the cycles between PROFILE_BEGIN(stage) and PROFILE_END(stage) in the same scope
+#define PROFILE_BEGIN(stage) uint32_t profileStart_##stage = ESP.getCycleCount()
+#define PROFILE_END(stage) profiler.add(stage, ESP.getCycleCount() - profileStart_##stage)
+
+#else
+#define PROFILE_BEGIN(stage)
+#define PROFILE_END(stage)
+#endif
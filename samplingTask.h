@@ -0,0 +1,129 @@
+// This file contains the sampling task.
+// It reads, filters and centers the sensors in a fixed period, driven by a hardware timer, on its own core.
+// The frames are handed over to the loop() via a lock-free queue, so blocking display or LED updates don't disturb the sampling.
+// The task and the loop() share no other variables: the center points are handed over by a sequence lock and the pause
+// is requested and acknowledged with atomic counters.
+
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include "spscQueue.h"
+
+/// @brief Sensor values of one sampling period
+struct SensorFrame {
+  uint32_t seq;          // running number of the frame
+  uint32_t timestampUs;  // time in micros(), when the frame was read
+  uint32_t firstScanUs;  // time in micros() of the first ADC scan of the frame
+  int rawReads[8];       // filtered and inverted values, see readAllFromSensors()
+  int centered[8];       // rawReads minus centerPoints
+};
+
+/// @brief Copy of the center points, which is handed over to the sampling task
+struct SamplingCenters {
+  int values[8];
+};
+
+#if SAMPLING_TASK > 0
+SpscQueue<SensorFrame, SENSORQUEUE_LENGTH> sensorQueue;
+
+TaskHandle_t samplingTaskHandle = NULL;
+hw_timer_t* samplingTimer = NULL;
+int* samplingCenterPoints;                 // center points of the loop(), only accessed by the loop()
+SeqLock<SamplingCenters> samplingCenters;  // copy of the center points for the task, written by the loop()
+// Odd while the loop() wants exclusive access to the sensors, incremented by pauseSamplingTask() and resumeSamplingTask().
+std::atomic<uint32_t> samplingPauseRequest{ 0 };
+// The task stores the value of samplingPauseRequest, when it has seen the pause request and doesn't touch the sensors anymore.
+std::atomic<uint32_t> samplingPauseAck{ 0 };
+
+void ARDUINO_ISR_ATTR onSamplingTimer() {
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(samplingTaskHandle, &higherPriorityTaskWoken);
+  portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+void samplingTask(void* parameter) {
+  SensorFrame frame = {};
+  SamplingCenters centers;
+  uint32_t centersVersion = samplingCenters.read(centers);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  // wait for the timer
+    uint32_t pause = samplingPauseRequest.load(std::memory_order_acquire);
+    if (pause & 1) {
+      samplingPauseAck.store(pause, std::memory_order_release);
+      continue;
+    }
+    if (samplingCenters.version() != centersVersion) {
+      centersVersion = samplingCenters.read(centers);
+    }
+
+    if (readAllFromSensors(frame.rawReads)) {
+      // Subtract centre position from measured position to determine movement.
+      for (int i = 0; i < 8; i++) {
+        frame.centered[i] = frame.rawReads[i] - centers.values[i];
+      }
+      frame.seq++;
+      frame.timestampUs = micros();
+      frame.firstScanUs = sensorFirstScanUs;
+      sensorQueue.push(frame);  // if the loop() is stuck, the frame is counted as overrun
+    }
+  }
+}
+
+/// @brief Hand the center points of the loop() over to the sampling task, if they have changed.
+/// Call this from the loop() after anything, which changes the center points, e.g. the auto zero.
+void updateSamplingCenterPoints() {
+  static SamplingCenters published;
+  if (memcmp(published.values, samplingCenterPoints, sizeof(published.values)) == 0 && samplingCenters.version() != 0) return;
+  memcpy(published.values, samplingCenterPoints, sizeof(published.values));
+  samplingCenters.write(published);
+}
+
+/// @brief Start the sampling task and the hardware timer. Call this once at the end of setup()
+/// @param centerPoints pointer to the 8 center points, which are used to center the frames
+void startSamplingTask(int* centerPoints) {
+  samplingCenterPoints = centerPoints;
+  updateSamplingCenterPoints();
+  xTaskCreatePinnedToCore(samplingTask, "sampling", SAMPLING_TASK_STACK, NULL, SAMPLING_TASK_PRIORITY, &samplingTaskHandle, SAMPLING_CORE);
+  samplingTimer = timerBegin(1000000);  // 1 MHz -> the alarm is given in us
+  timerAttachInterrupt(samplingTimer, &onSamplingTimer);
+  timerAlarm(samplingTimer, SAMPLING_PERIOD_US, true, 0);
+}
+
+/// @brief Stop the sampling task from touching the sensors, e.g. for the blocking busyZeroing() in the loop()
+/// Returns after the task has acknowledged this request, so a frame, which is just read by the task, is finished before.
+void pauseSamplingTask() {
+  if (samplingTaskHandle == NULL) return;
+  uint32_t pause = samplingPauseRequest.load(std::memory_order_relaxed);
+  if (pause & 1) return;  // already paused
+  pause++;
+  samplingPauseRequest.store(pause, std::memory_order_release);
+  while (samplingPauseAck.load(std::memory_order_acquire) != pause) {
+    delay(1);
+  }
+}
+
+/// @brief Let the sampling task continue after pauseSamplingTask(). The task uses the actual center points from now on.
+void resumeSamplingTask() {
+  uint32_t pause = samplingPauseRequest.load(std::memory_order_relaxed);
+  if (!(pause & 1)) return;  // not paused
+  updateSamplingCenterPoints();
+  samplingPauseRequest.store(pause + 1, std::memory_order_release);
+}
+
+/// @brief Get the newest frame from the sampling task. Older frames in the queue are skipped.
+/// @param frame destination, left unchanged if there is no new frame
+/// @return true, if there was a new frame
+bool getNewestSensorFrame(SensorFrame& frame) {
+  bool newFrame = false;
+  while (sensorQueue.pop(frame)) {
+    newFrame = true;
+  }
+  return newFrame;
+}
+
+/// @brief Report the frames of the ADC and the overruns of the queue
+void printSamplingStats() {
+  SERIAL.printf("Sampling: %lu frames, %lu skipped by ADC, %lu overruns\n",
+                (unsigned long)adcEngine.framesFetched, (unsigned long)adcEngine.framesSkipped, (unsigned long)sensorQueue.overruns());
+}
+#endif
@@ -6,6 +6,7 @@
 #define I2C_SDA_PIN 3
 
 #define SCREEN_REFRESH_DELAY 10
+uint16_t screenRefreshDelay = SCREEN_REFRESH_DELAY;  // raised by the power governor, while the device is idle
 
 // --- OLED DISPLAY CONFIGURATION ---
 U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C u8g2(U8G2_R0, /* reset=*/U8X8_PIN_NONE);
@@ -27,11 +28,79 @@ void setupDisplay() {
   delay(1000);
 }
 
+#if SCREEN_DIRTY_RENDER > 0
+#include "screenDirty.h"
+
+DirtyTiles screenDirty;
+ScreenStats screenStats;
+volatile bool screenInvalid = true;  // the buffer was overwritten, e.g. by the USB state, redraw everything
+
+/// @brief Let the next displayScreen() redraw and send the whole screen
+void screenInvalidate() {
+  screenInvalid = true;
+}
+
+#define SCREEN_TEXT_SIZE 23  // characters of a line of values, which fit on the display right of the "T" and "R"
+
+/// @brief Redraw the changed characters of one line of values and mark their tiles as dirty
+void drawChangedChars(char* shown, const char* text, uint8_t x, uint8_t baseline, uint8_t lineHeight) {
+  uint32_t changed = changedChars(shown, text, SCREEN_TEXT_SIZE);
+  uint8_t charWidth = u8g2.getMaxCharWidth();
+  char glyph[2] = { 0, 0 };
+  for (uint8_t i = 0; changed; i++, changed >>= 1) {
+    if (!(changed & 1)) continue;
+    uint8_t cx = x + i * charWidth;
+    uint8_t cy = baseline - lineHeight + 1;  // the digits have no descent
+    u8g2.setDrawColor(0);
+    u8g2.drawBox(cx, cy, charWidth, lineHeight);
+    u8g2.setDrawColor(1);
+    glyph[0] = text[i];
+    u8g2.drawStr(cx, baseline, glyph);
+    screenDirty.markPixels(cx, cy, charWidth, lineHeight);
+  }
+}
+#endif
+
 void displayScreen(int16_t rx, int16_t ry, int16_t rz, int16_t x, int16_t y, int16_t z, uint8_t* keys) {
   static unsigned long lastDisplayUpdateTime = 0;
   char buffer[32];
 
-  if (millis() - lastDisplayUpdateTime > SCREEN_REFRESH_DELAY) {  // 10Hz update rate
+  // 100 Hz at most with the default SCREEN_REFRESH_DELAY of 10 ms
+  if (millis() - lastDisplayUpdateTime > screenRefreshDelay) {
+#if SCREEN_DIRTY_RENDER > 0
+    static char shownT[SCREEN_TEXT_SIZE], shownR[SCREEN_TEXT_SIZE];  // the values on the display
+    uint8_t TRlineY = 7;
+    u8g2.setFont(u8g2_font_5x8_tr);
+    if (screenInvalid) {
+      screenInvalid = false;
+      u8g2.clearBuffer();
+      u8g2.drawStr(2, TRlineY, "T");
+      u8g2.drawStr(2, 2 * TRlineY, "R");
+      u8g2.drawHLine(0, 2 * TRlineY + 3, screenWidth);
+      memset(shownT, 0, sizeof(shownT));  // differs from every text, so all characters are drawn
+      memset(shownR, 0, sizeof(shownR));
+      screenDirty.markAll();
+    }
+    snprintf(buffer, sizeof(buffer), "%5d %5d %5d", x, y, z);
+    drawChangedChars(shownT, buffer, 13, TRlineY, TRlineY);
+    snprintf(buffer, sizeof(buffer), "%5d %5d %5d", rx, ry, rz);
+    drawChangedChars(shownR, buffer, 13, 2 * TRlineY, TRlineY);
+    // the cleared characters may have cut the lines
+    u8g2.drawVLine(100, 0, 2 * TRlineY + 2);
+    u8g2.drawVLine(70, 0, 2 * TRlineY + 2);
+    u8g2.drawVLine(40, 0, 2 * TRlineY + 2);
+    u8g2.drawVLine(10, 0, 2 * TRlineY + 2);
+
+    // send the runs of dirty tiles, until the frame budget is used up. The rest is sent with the next frame.
+    uint32_t start = micros();
+    uint32_t bytes = 0;
+    uint8_t tx, ty, tw;
+    while (micros() - start < SCREEN_FRAME_BUDGET_US && screenDirty.nextRun(tx, ty, tw)) {
+      u8g2.updateDisplayArea(tx, ty, tw, 1);
+      bytes += tw * SCREEN_TILE_BYTES;
+    }
+    if (bytes) screenStats.frame(bytes, micros() - start, screenDirty.any(), millis());
+#else
     u8g2.clearBuffer();
 
     u8g2.setFont(u8g2_font_5x8_tr);
@@ -57,6 +126,7 @@ void displayScreen(int16_t rx, int16_t ry, int16_t rz, int16_t x, int16_t y, int
     // u8g2.drawStr(110, line, keys.c_str());
 
     u8g2.sendBuffer();
+#endif
     lastDisplayUpdateTime = millis();
   }
-}
\ No newline at end of file
+}
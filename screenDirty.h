@@ -0,0 +1,115 @@
+// This file contains the bookkeeping of the dirty-region renderer of the OLED, see SCREEN_DIRTY_RENDER in config.h
+// The display is organized in tiles of 8x8 pixels, a tile column of one tile row is 8 bytes on the I2C bus.
+// The renderer caches the text shown, redraws only the characters, which have changed, and marks the tiles below them
+// as dirty. Only the runs of dirty tiles are sent to the display, until the frame budget is used up. The rest stays
+// dirty for the next frame.
+// There are no dependencies to the Arduino framework, so it can be tested on a host.
+
+#ifndef SCREENDIRTY_H
+#define SCREENDIRTY_H
+#include <stdint.h>
+#include <string.h>
+
+#define SCREEN_TILE_COLUMNS 16  // 128 pixels
+#define SCREEN_TILE_ROWS 4      // 32 pixels
+#define SCREEN_TILE_BYTES 8     // bytes per tile on the bus
+
+class DirtyTiles {
+public:
+  DirtyTiles() {
+    clear();
+  }
+
+  void clear() {
+    memset(rows, 0, sizeof(rows));
+  }
+
+  void markAll() {
+    for (int i = 0; i < SCREEN_TILE_ROWS; i++) rows[i] = 0xFFFF;
+  }
+
+  /// @brief Mark the tiles below a rectangle of pixels as dirty
+  void markPixels(int x, int y, int w, int h) {
+    if (w <= 0 || h <= 0) return;
+    int x0 = clamp(x / 8, SCREEN_TILE_COLUMNS), x1 = clamp((x + w - 1) / 8, SCREEN_TILE_COLUMNS);
+    int y0 = clamp(y / 8, SCREEN_TILE_ROWS), y1 = clamp((y + h - 1) / 8, SCREEN_TILE_ROWS);
+    uint16_t columns = (uint16_t)(((1UL << (x1 + 1)) - 1) & ~((1UL << x0) - 1));
+    for (int ty = y0; ty <= y1; ty++) rows[ty] |= columns;
+  }
+
+  bool any() const {
+    for (int i = 0; i < SCREEN_TILE_ROWS; i++) {
+      if (rows[i]) return true;
+    }
+    return false;
+  }
+
+  /// @brief Take the next run of adjacent dirty tiles in one tile row and mark it as clean
+  /// @return false, if there are no dirty tiles
+  bool nextRun(uint8_t& tx, uint8_t& ty, uint8_t& tw) {
+    for (int row = 0; row < SCREEN_TILE_ROWS; row++) {
+      if (rows[row] == 0) continue;
+      int start = 0;
+      while (!(rows[row] & (1 << start))) start++;
+      int end = start;
+      while (end < SCREEN_TILE_COLUMNS && (rows[row] & (1 << end))) {
+        rows[row] &= ~(1 << end);
+        end++;
+      }
+      tx = start;
+      ty = row;
+      tw = end - start;
+      return true;
+    }
+    return false;
+  }
+
+  uint16_t rows[SCREEN_TILE_ROWS];  // one bit per tile column
+
+private:
+  static int clamp(int tile, int count) {
+    return tile < 0 ? 0 : (tile >= count ? count - 1 : tile);
+  }
+};
+
+/// @brief Compare the new text with the cached one and update the cache
+/// @param shown text on the display, padded with 0 up to the size
+/// @param size size of shown, up to 32 characters
+/// @return one bit per character, which has changed. A 0 means the character must be cleared, the text got shorter.
+inline uint32_t changedChars(char* shown, const char* text, uint8_t size) {
+  uint32_t changed = 0;
+  size_t len = strlen(text);
+  for (uint8_t i = 0; i < size && i < 32; i++) {
+    char c = i < len ? text[i] : 0;
+    if (shown[i] != c) {
+      changed |= 1UL << i;
+      shown[i] = c;
+    }
+  }
+  return changed;
+}
+
+struct ScreenStats {
+  /// @brief Count a frame, the bytes are the payload of the tiles, without the I2C addressing
+  void frame(uint32_t bytes, uint32_t frameUs, bool deferred, uint32_t nowMs) {
+    frames++;
+    totalBytes += bytes;
+    windowBytes += bytes;
+    if (frameUs > maxFrameUs) maxFrameUs = frameUs;
+    if (deferred) overBudget++;
+    if (nowMs - windowStartMs >= 1000) {
+      bytesPerSec = windowBytes * 1000 / (nowMs - windowStartMs);
+      windowBytes = 0;
+      windowStartMs = nowMs;
+    }
+  }
+
+  uint32_t frames = 0;       // frames with a transfer to the display
+  uint32_t totalBytes = 0;   // bytes sent to the display
+  uint32_t bytesPerSec = 0;  // bytes sent within the last second
+  uint32_t maxFrameUs = 0;   // longest transfer of a frame
+  uint32_t overBudget = 0;   // frames, which left dirty tiles for the next frame, because the budget was used up
+  uint32_t windowStartMs = 0;
+  uint32_t windowBytes = 0;
+};
+#endif
@@ -1,6 +1,11 @@
 // The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
 // Please open config_sample.h, adjust your settings and save it as config.h
+#ifndef SPACEKEYS_H
+#define SPACEKEYS_H
 #include "config.h"
+#include "virtualClock.h"
+
+#define HIDMAXBUTTONS 2  // for Compact
 
 #if NUMKEYS > 0
 // array with the pin definition of all keys
@@ -35,7 +40,7 @@ void evalKeys(int* keyVals, uint8_t* keyOut, uint8_t* keyState, int& debug) {
       if (keyState[i] == 0) {                            // if the button has not been pressed lately:
         keyOut[i] = 1;                                   // this is the variable telling the outside world only one iteration, that the key was pressed
         keyState[i] = 1;                                 // remember, that we already told the outside world about this key
-        timestamp[i] = millis();                         // remember the time, the button was pressed
+        timestamp[i] = clockMillis();                    // remember the time, the button was pressed
         if (debug == 24) SERIAL.printf("Key: %d\n", i);  // this is always sent over the serial console, and not only in debug
       } else {                                           // the button was already pressed and is still pressed (and the event sent in the last loop), don't send the keyOut event again.
         keyOut[i] = 0;
@@ -43,7 +48,7 @@ void evalKeys(int* keyVals, uint8_t* keyOut, uint8_t* keyState, int& debug) {
     } else {                   // the button is not pressed
       if (keyState[i] == 1) {  // has it been pressed lately?
         // debouncing:
-        if (millis() - timestamp[i] > DEBOUNCE_KEYS_MS) {  // check if the last button press is long enough in the past
+        if (clockMillis() - timestamp[i] > DEBOUNCE_KEYS_MS) {  // check if the last button press is long enough in the past
           keyState[i] = 0;                                 // reset this marker and allow a new button press
         }
       }
@@ -63,4 +68,30 @@ bool CheckKey3(int key, int& debug) {
   return SendData;
 }
 
-#endif
\ No newline at end of file
+// Array with the bitnumbers, which should assign keys to buttons
+uint8_t bitNumber[NUMHIDKEYS] = BUTTONLIST;
+
+// Takes the data in keys and sort them into the bits of keyData
+// Which key from keyData should belong to which byte is defined in bitNumber = BUTTONLIST see config.h
+void prepareKeyBytes(uint8_t* keys, uint8_t* keyData, int debug) {
+  for (int i = 0; i < HIDMAXBUTTONS; i++) {
+    keyData[i] = 0;
+  }
+
+  // bitNumber[] should be { 0, 1 } for the Compact
+  for (int i = 0; i < NUMHIDKEYS; i++) {
+    if (keys[i]) {
+      int bitNo = bitNumber[i];
+      int byteNo = bitNo / 8;
+      int bitPos = bitNo % 8;
+      // ACCUMULATE instead of overwrite:
+      keyData[byteNo] |= (1 << bitPos);
+
+      if (debug == 8) {
+        SERIAL.printf("bitNumber: %d -> keyData[%d] = 0x%02X\n", bitNumber[i], (bitNumber[i] / 8), keyData[(bitNumber[i] / 8)]);
+      }
+    }
+  }
+}
+#endif
+#endif
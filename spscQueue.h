@@ -0,0 +1,97 @@
+// Lock-free queue for exactly one producer and one consumer, e.g. the sampling task and the loop(),
+// and a sequence lock to share a value with one writer, e.g. the center points of the loop() with the sampling task.
+// It only uses std::atomic and has no dependency to the Arduino framework or FreeRTOS.
+// test/spsc_stress.cpp runs both with std::thread on a host.
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+#include <stdint.h>
+#include <atomic>
+
+/// @brief Single-producer/single-consumer ring buffer
+/// @tparam T type of the elements, copied by value
+/// @tparam N number of elements, must be a power of two
+template<typename T, uint32_t N>
+class SpscQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue length must be a power of two");
+
+public:
+  /// @brief Add an element. Only to be called by the producer.
+  /// @return false, if the queue is full. The element is dropped and counted as overrun.
+  bool push(const T& item) {
+    uint32_t head = headIndex.load(std::memory_order_relaxed);
+    if (head - tailIndex.load(std::memory_order_acquire) >= N) {
+      overrunCount.store(overrunCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    buffer[head & (N - 1)] = item;
+    headIndex.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @brief Take the oldest element. Only to be called by the consumer.
+  /// @return false, if the queue is empty
+  bool pop(T& item) {
+    uint32_t tail = tailIndex.load(std::memory_order_relaxed);
+    if (tail == headIndex.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = buffer[tail & (N - 1)];
+    tailIndex.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @return number of elements waiting in the queue
+  uint32_t size() const {
+    return headIndex.load(std::memory_order_acquire) - tailIndex.load(std::memory_order_acquire);
+  }
+
+  /// @return number of elements dropped by push(), because the queue was full
+  uint32_t overruns() const {
+    return overrunCount.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint32_t> headIndex{ 0 };     // written by the producer only
+  std::atomic<uint32_t> tailIndex{ 0 };     // written by the consumer only
+  std::atomic<uint32_t> overrunCount{ 0 };  // written by the producer only
+  T buffer[N];
+};
+
+/// @brief Value with exactly one writer and any number of readers, which never block the writer.
+/// The sequence counter is odd while the writer is writing. The reader copies the value and repeats the copy,
+/// if the counter was odd or has changed meanwhile, so it never sees a torn value.
+/// @tparam T type of the value, copied by value
+template<typename T>
+class SeqLock {
+public:
+  /// @brief Replace the value. Only to be called by the writer.
+  void write(const T& value) {
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);  // odd: the value is being written
+    std::atomic_thread_fence(std::memory_order_release);
+    data = value;
+    seq.store(s + 2, std::memory_order_release);  // even: the value is complete
+  }
+
+  /// @brief Copy the value.
+  /// @return version of the value, which has been copied
+  uint32_t read(T& value) const {
+    while (true) {
+      uint32_t s1 = seq.load(std::memory_order_acquire);
+      if (s1 & 1) continue;  // the writer is just writing
+      value = data;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq.load(std::memory_order_relaxed) == s1) return s1;
+    }
+  }
+
+  /// @return version of the value, it changes with every write. Compare it to the result of read() to skip unchanged values.
+  uint32_t version() const {
+    return seq.load(std::memory_order_acquire);
+  }
+
+private:
+  std::atomic<uint32_t> seq{ 0 };
+  T data{};
+};
+#endif
@@ -0,0 +1,168 @@
+// This file contains the binary telemetry stream, see TELEMETRY in config.h
+// The text outputs of the debug modes are throttled to DEBUGDELAY and too slow to analyze the motion at full rate.
+// Instead, named taps in the processing stream their values at the full loop rate as compact binary frames.
+// The host subscribes to a set of taps with the command "telemetry <mask>", see tools/telemetry_decode.py
+// While the stream is running, no text is sent, so the host gets nothing but frames.
+// A tap, which is not subscribed, costs a single branch.
+//
+// Frame format: each frame is COBS encoded and ends with a 0x00 byte. Decoded, it contains:
+//   uint8   tap number, bit 7 set for a keyframe
+//   varint  keyframe: time in us, otherwise: time since the last frame of this tap in us
+//   varint  number of values
+//   varint  keyframe: zigzag encoded values, otherwise: zigzag encoded differences to the last values of this tap
+//   uint16  Fletcher-16 checksum over all bytes before, little endian
+// Every tap starts with a keyframe and sends one every TELEMETRY_KEYFRAME_INTERVAL frames, or after a dropped frame.
+// A frame is dropped instead of blocking the loop(), if the serial interface has no space for it.
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+
+#if TELEMETRY > 0
+#include <stdint.h>
+#include <string.h>
+#include "virtualClock.h"
+
+enum TelemetryTap {
+  TAP_RAW,        // rawReads, filtered ADC values
+  TAP_CENTERED,   // centered values
+  TAP_DEADZONED,  // values after the deadzone and the mapping
+  TAP_VELOCITY,   // velocities after the kinematics
+  TAP_KILLED,     // velocities after the kill-keys
+  TAP_EXCLUSIVE,  // velocities after switchYZ, the exclusive mode and the smoothing
+  TAP_HID,        // report id and payload of every HID report
+  NUM_TAPS
+};
+
+#define TELEMETRY_MAX_VALUES 16                                        // per frame
+#define TELEMETRY_FRAME_SIZE (1 + 5 + 1 + 5 * TELEMETRY_MAX_VALUES + 2)  // decoded, worst case
+#define TELEMETRY_COBS_SIZE (TELEMETRY_FRAME_SIZE + TELEMETRY_FRAME_SIZE / 254 + 2)
+
+// bit mask of the subscribed taps, checked at every tap
+uint8_t telemetryMask = 0;
+
+class Telemetry {
+public:
+  /// @brief Subscribe to a set of taps. All of them start with a keyframe.
+  /// @param mask bit i for tap i, 0 stops the stream
+  void subscribe(uint8_t mask) {
+    for (int t = 0; t < NUM_TAPS; t++) keyframeIn[t] = 0;
+    telemetryMask = mask;
+  }
+
+  /// @brief Send a frame of the tap, call it via TELEMETRY_TAP()
+  template<typename T>
+  void emit(TelemetryTap tap, const T* values, int count) {
+    if (count > TELEMETRY_MAX_VALUES) count = TELEMETRY_MAX_VALUES;
+    uint32_t now = clockMicros();
+    bool keyframe = keyframeIn[tap] == 0 || count != lastCount[tap];
+
+    uint8_t frame[TELEMETRY_FRAME_SIZE];
+    uint8_t* p = frame;
+    *p++ = tap | (keyframe ? 0x80 : 0);
+    p = putVarint(p, keyframe ? now : now - lastTime[tap]);
+    p = putVarint(p, count);
+    int32_t* last = lastValues[tap];
+    for (int i = 0; i < count; i++) {
+      int32_t v = values[i];
+      p = putVarint(p, zigzag(keyframe ? v : v - last[i]));
+    }
+    uint16_t sum = fletcher16(frame, p - frame);
+    *p++ = sum;
+    *p++ = sum >> 8;
+
+    uint8_t encoded[TELEMETRY_COBS_SIZE];
+    size_t len = cobsEncode(frame, p - frame, encoded);
+    if (SERIAL.availableForWrite() < (int)len) {
+      dropped++;
+      keyframeIn[tap] = 0;  // the host can't continue the differences
+      return;
+    }
+    SERIAL.write(encoded, len);
+
+    for (int i = 0; i < count; i++) last[i] = values[i];
+    lastCount[tap] = count;
+    lastTime[tap] = now;
+    keyframeIn[tap] = keyframe ? TELEMETRY_KEYFRAME_INTERVAL : keyframeIn[tap] - 1;
+    frames++;
+  }
+
+  /// @brief Send a HID report as frame of TAP_HID: the report id followed by the bytes of the payload
+  void emitReport(uint8_t id, const void* value, size_t len) {
+    uint8_t values[TELEMETRY_MAX_VALUES];
+    if (len > TELEMETRY_MAX_VALUES - 1) len = TELEMETRY_MAX_VALUES - 1;
+    values[0] = id;
+    memcpy(values + 1, value, len);
+    emit(TAP_HID, values, len + 1);
+  }
+
+  uint32_t frames = 0;   // sent frames
+  uint32_t dropped = 0;  // frames dropped, because the serial interface was busy
+
+private:
+  static inline uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+  }
+
+  static inline uint8_t* putVarint(uint8_t* p, uint32_t v) {
+    while (v >= 0x80) {
+      *p++ = (v & 0x7F) | 0x80;
+      v >>= 7;
+    }
+    *p++ = v;
+    return p;
+  }
+
+  static uint16_t fletcher16(const uint8_t* data, size_t len) {
+    uint16_t a = 0, b = 0;
+    for (size_t i = 0; i < len; i++) {
+      a = (a + data[i]) % 255;
+      b = (b + a) % 255;
+    }
+    return (b << 8) | a;
+  }
+
+  /// @brief Consistent overhead byte stuffing: remove all 0x00, so 0x00 can mark the end of the frame
+  /// @return length of the encoded frame including the final 0x00
+  static size_t cobsEncode(const uint8_t* in, size_t len, uint8_t* out) {
+    size_t code = 0;  // position of the current code byte
+    size_t o = 1;
+    for (size_t i = 0; i < len; i++) {
+      if (in[i] != 0) out[o++] = in[i];
+      if (in[i] == 0 || o - code == 0xFF) {
+        out[code] = o - code;
+        code = o++;
+      }
+    }
+    out[code] = o - code;
+    out[o++] = 0;
+    return o;
+  }
+
+  int32_t lastValues[NUM_TAPS][TELEMETRY_MAX_VALUES];
+  uint8_t lastCount[NUM_TAPS];
+  uint32_t lastTime[NUM_TAPS];
+  uint16_t keyframeIn[NUM_TAPS];  // frames until the next keyframe, 0: the next frame is a keyframe
+};
+
+Telemetry telemetry;
+
+// stream the values at this tap, if subscribed
+#define TELEMETRY_TAP(tap, values, count) \
+  do { \
+    if (__builtin_expect(telemetryMask & (1 << (tap)), 0)) telemetry.emit(tap, values, count); \
+  } while (0)
+
+// stream the HID report, if TAP_HID is subscribed
+#define TELEMETRY_REPORT(id, value, len) \
+  do { \
+    if (__builtin_expect(telemetryMask & (1 << TAP_HID), 0)) telemetry.emitReport(id, value, len); \
+  } while (0)
+
+#else
+#define TELEMETRY_TAP(tap, values, count)
+#define TELEMETRY_REPORT(id, value, len)
+#endif
+#endif
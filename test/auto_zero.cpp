@@ -0,0 +1,199 @@
+// Test of the idle re-zeroing and the adaptive deadzone in autoZero.h with sensor traces at the frame rate of the ADC.
+// The traces are generated with the noise and the drift of the hall effect sensors, so the test knows the true center:
+//   1. idle with noise and thermal drift: the center points follow the drift and the deadzones adapt to the noise
+//   2. a gentle push, which is within the global DEADZONE, but outside of the adapted deadzone: no re-zeroing
+//   3. release: a new idle period starts
+//   4. sweep over push amplitudes and durations: how often is a push absorbed into the center point (false re-zero).
+//      Pushes below the adapted deadzone are taken as drift, from 1.5 times the adapted deadzone on none may be absorbed.
+//   5. replay of traces in the format of traceBuffer.h, e.g. recorded with tools/trace_tool.py: the center points must
+//      not move by more than CENTER_TOLERANCE. ctest replays test/fixtures/gentle_push.trace, which is synthetic:
+//      16 s idle at the 50 Hz of the idle power state, then a push of 60 counts on sensor 2 for 0.9 s at the frame
+//      rate, which stays within the global DEADZONE.
+//   auto_zero [trace ...]
+#include "config.h"
+#include "autoZero.h"
+#include "kalmanBank.h"
+#include "traceBuffer.h"
+#include "check.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define FRAME_MS 4  // ADC_SAMPLE_RATE_HZ / OVERSAMPLING_RATIO = 250 frames per second
+// The center points move only, if they are at least 2^AUTOZERO_SHIFT / 256 counts away, plus the lag behind the drift.
+#define CENTER_TOLERANCE ((1 << AUTOZERO_SHIFT) / 256 + 2)
+
+struct Trace {
+  uint32_t seed = 1;
+  unsigned long nowMs = 0;
+  int centerPoints[8];
+  int deadzones[8];
+  double trueCenter[8];
+  double noiseSigma = 8;  // in units of the oversampled sensors
+  IdleTracker tracker;
+
+  Trace() {
+    for (int i = 0; i < 8; i++) {
+      trueCenter[i] = 8000 + 10 * i;
+      centerPoints[i] = trueCenter[i];
+      deadzones[i] = DEADZONE * SENSOR_SCALE;
+    }
+  }
+
+  /// @brief approximately normal distributed noise, sum of 12 uniform values
+  double noise() {
+    double sum = 0;
+    for (int k = 0; k < 12; k++) {
+      seed = seed * 1103515245 + 12345;
+      sum += ((seed >> 8) & 0xFFFF) / 65536.0;
+    }
+    return (sum - 6) * noiseSigma;
+  }
+
+  /// @brief Feed frames for a duration
+  /// @param driftPerSec drift of every sensor in counts per second
+  /// @param offset deliberate displacement of each sensor by the user
+  void run(unsigned long durationMs, double driftPerSec, const int* offset) {
+    for (unsigned long t = 0; t < durationMs; t += FRAME_MS) {
+      int rawReads[8];
+      int centered[8];
+      for (int i = 0; i < 8; i++) {
+        trueCenter[i] += driftPerSec * FRAME_MS / 1000;
+        rawReads[i] = lround(trueCenter[i] + offset[i] + noise());
+        centered[i] = rawReads[i] - centerPoints[i];
+      }
+      tracker.update(nowMs, rawReads, centered, centerPoints, deadzones);
+      nowMs += FRAME_MS;
+    }
+  }
+};
+
+/// @brief Move the knob of an idle trace and check, whether the push has moved the center point
+/// @return true, if the push was absorbed: the center point has followed it by more than CENTER_TOLERANCE
+static bool pushAbsorbed(const Trace& idle, uint32_t seed, int sensor, int amplitude, unsigned long durationMs) {
+  static Trace trace;
+  trace = idle;
+  trace.seed = seed;
+  int push[8] = {};
+  push[sensor] = amplitude;
+  trace.run(durationMs, 0, push);
+  return fabs(trace.centerPoints[sensor] - trace.trueCenter[sensor]) > CENTER_TOLERANCE;
+}
+
+/// @brief Rate of the absorbed pushes over the amplitude in multiples of the adapted deadzone and the duration
+/// @return worst rate for pushes of at least 1.5 times the adapted deadzone
+static double sweepPushes(const Trace& idle) {
+  const double amplitudes[] = { 0.5, 1.0, 1.5, 2.0, 4.0 };
+  const unsigned long durations[] = { 500, 2000, 5000, 20000, 60000 };
+  const int trials = 8;
+  double worst = 0;
+  printf("absorbed pushes in %% of %d, amplitude in adapted deadzones\n  duration", trials);
+  for (double a : amplitudes) printf("  %4.1f dz", a);
+  printf("\n");
+  for (unsigned long d : durations) {
+    printf("  %6lu ms", d);
+    for (double a : amplitudes) {
+      int absorbed = 0;
+      for (int t = 0; t < trials; t++) {
+        int sensor = t % 8;
+        int amplitude = lround(a * idle.deadzones[sensor]) * ((t & 1) ? -1 : 1);
+        if (pushAbsorbed(idle, 1000 + t, sensor, amplitude, d)) absorbed++;
+      }
+      double rate = 100.0 * absorbed / trials;
+      if (a >= 1.5 && rate > worst) worst = rate;
+      printf("  %5.0f %%", rate);
+    }
+    printf("\n");
+  }
+  return worst;
+}
+
+/// @brief Replay a trace through the Kalman filters and the idle tracker, like the loop()
+/// @return the largest distance of a center point from the one stored with the trace, -1 if the trace is invalid
+static int replayTrace(const char* path, TraceBuffer& traceBuffer) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    printf("%s: can't open\n", path);
+    return -1;
+  }
+  bool valid = traceBuffer.parse([&](uint8_t* buf, size_t len) {
+    return fread(buf, 1, len, f) == len;
+  });
+  fclose(f);
+  if (!valid || traceBuffer.resolution != SENSOR_RESOLUTION) {
+    printf("%s: no valid trace for this sensor resolution\n", path);
+    return -1;
+  }
+  static KalmanBank kalman;
+  kalman.init(5.0, 2.0, 0.01, KALMAN_STEADYSTATE > 0);
+  static IdleTracker tracker;
+  tracker = IdleTracker();
+  int centerPoints[8];
+  int deadzones[8];
+  for (int i = 0; i < 8; i++) {
+    centerPoints[i] = traceBuffer.centers[i];
+    deadzones[i] = DEADZONE * SENSOR_SCALE;
+  }
+  int rawReads[8];
+  int centered[8];
+  int maxOffset = 0;
+  for (uint16_t n = 0; n < traceBuffer.count; n++) {
+    const TraceFrame& frame = traceBuffer.frames[n];
+    kalman.update(frame.adc, rawReads);
+    for (int i = 0; i < 8; i++) centered[i] = rawReads[i] - centerPoints[i];
+    tracker.update(frame.timeUs / 1000, rawReads, centered, centerPoints, deadzones);
+    for (int i = 0; i < 8; i++) {
+      int offset = abs(centerPoints[i] - (int)traceBuffer.centers[i]);
+      if (offset > maxOffset) maxOffset = offset;
+    }
+  }
+  printf("%s: %u frames, %lu idle periods, %s at the end, center points moved up to %d\n", path,
+         (unsigned)traceBuffer.count, (unsigned long)tracker.idlePeriods, tracker.isIdle() ? "idle" : "moving", maxOffset);
+  return maxOffset;
+}
+
+int main(int argc, char** argv) {
+  static Trace trace;
+  const int still[8] = {};
+
+  // 1. idle for 60 s, while the sensors drift by 0.5 counts per second
+  trace.run(60000, 0.5, still);
+  CHECK(trace.tracker.isIdle());
+  CHECK(trace.tracker.idlePeriods == 1);
+  for (int i = 0; i < 8; i++) {
+    CHECK(fabs(trace.centerPoints[i] - trace.trueCenter[i]) <= CENTER_TOLERANCE);
+    CHECK(trace.deadzones[i] >= AUTOZERO_MIN_DEADZONE * SENSOR_SCALE);
+    CHECK(trace.deadzones[i] < DEADZONE * SENSOR_SCALE);
+    CHECK(fabs(trace.tracker.sigma[i] - trace.noiseSigma) < 1.5);
+  }
+  printf("adapted deadzone %d, sigma %.2f\n", trace.deadzones[0], trace.tracker.sigma[0]);
+
+  // 2. a gentle push on one sensor for 20 s: outside of the adapted deadzone, but within the global DEADZONE
+  int push[8] = {};
+  push[1] = trace.deadzones[1] + 5 * trace.noiseSigma;
+  CHECK(push[1] < DEADZONE * SENSOR_SCALE);
+  int centerBefore = trace.centerPoints[1];
+  trace.run(20000, 0, push);
+  CHECK(!trace.tracker.isIdle());
+  CHECK(trace.centerPoints[1] == centerBefore);
+  printf("push of %d counts: center point moved by %d\n", push[1], trace.centerPoints[1] - centerBefore);
+
+  // 3. release: after AUTOZERO_IDLE_MS a new idle period starts at the same center
+  trace.run(AUTOZERO_IDLE_MS + 1000, 0, still);
+  CHECK(trace.tracker.isIdle());
+  CHECK(trace.tracker.idlePeriods == 2);
+  CHECK(fabs(trace.centerPoints[1] - trace.trueCenter[1]) <= CENTER_TOLERANCE);
+
+  // 4. a push beyond the adapted deadzone is never taken as drift
+  static Trace idle;
+  idle = trace;
+  idle.run(60000, 0, still);
+  CHECK(sweepPushes(idle) == 0);
+
+  // 5. replay
+  static TraceBuffer traceBuffer;
+  for (int k = 1; k < argc; k++) {
+    int maxOffset = replayTrace(argv[k], traceBuffer);
+    CHECK(maxOffset >= 0 && maxOffset <= CENTER_TOLERANCE);
+  }
+  return checkResult("auto_zero");
+}
@@ -0,0 +1,195 @@
+// Microbenchmarks of the core functions of the loop() on the host, the counterpart of benchmarkCore() in benchmark.h
+// The sensors are read from a mock ADC engine, which takes its scans from analogRead() of the Arduino shim.
+// Reports the time per call in ns and the sum of all functions as the time of one loop iteration.
+//   bench_core [--quick]   --quick runs only a few iterations, e.g. as smoke test in ctest
+#include <Arduino.h>
+#include "config.h"
+#include "kinematics.h"
+#include "fixedPipeline.h"
+#include "spaceKeys.h"
+#include "floatKalman.h"
+#include <chrono>
+
+static int iterations = 200000;
+static volatile int benchmarkSink;  // the compiler can't optimize the benchmarked code away
+
+/// @brief Engine, which reads OVERSAMPLING_RATIO sequential scans from analogRead() per call, so every call gives a new frame
+class MockAdcEngine : public AdcEngine {
+public:
+  void service() override {
+    uint16_t values[ADC_CHANNELS];
+    for (int k = 0; k < OVERSAMPLING_RATIO; k++) {
+      for (int i = 0; i < ADC_CHANNELS; i++) {
+        values[i] = analogRead(pinList[i]);
+      }
+      pushScan(values, micros());
+    }
+  }
+};
+
+/// @brief Run f(n) for all iterations and return the time per call in ns
+template<typename F>
+double measureNs(F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < iterations; n++) f(n);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+static void report(const char* name, double ns) {
+  printf("%-40s %9.1f ns\n", name, ns);
+}
+
+/// @brief Random centered values within the calibrated range, like the knob moves
+static void randomCenteredFrame(uint32_t& seed, int* centered) {
+  for (int i = 0; i < 8; i++) {
+    seed = seed * 1103515245 + 12345;
+    int range = maxVals[i] - minVals[i];
+    centered[i] = (minVals[i] + (int)((seed >> 8) % (range + 1))) * SENSOR_SCALE;
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1 && strcmp(argv[1], "--quick") == 0) iterations = 1000;
+  setupkalmanFilters();
+  setupSensors();
+  int raw[8];
+  int centered[8];
+  int16_t velocity[6];
+  double loopNs = 0;
+  uint32_t seed = 42;
+  int failures = 0;
+
+  printf("Core functions, time per call (%d iterations)\n", iterations);
+
+  MockAdcEngine mockAdc;
+  int newFrames = 0;
+  double ns = measureNs([&](int n) {
+    for (int i = 0; i < 8; i++) shimAnalog[pinList[i]] = 1400 + ((n * 7 + i * 13) & 63) - 32;  // noisy sensors
+    newFrames += readAllFromSensors(raw, mockAdc);
+  });
+  benchmarkSink = raw[0];
+  report("readAllFromSensors (mock ADC)", ns);
+  loopNs += ns;
+  if (newFrames != iterations) {
+    printf("FAIL: %d new frames instead of %d\n", newFrames, iterations);
+    failures++;
+  }
+
+  static int frames[16][8];
+  for (int n = 0; n < 16; n++) randomCenteredFrame(seed, frames[n]);
+  ns = measureNs([&](int n) {
+    memcpy(centered, frames[n & 15], sizeof(centered));
+    FilterAnalogReadOuts(centered);
+  });
+  benchmarkSink = centered[0];
+  report("FilterAnalogReadOuts", ns);
+  loopNs += ns;
+
+  for (int n = 0; n < 16; n++) FilterAnalogReadOuts(frames[n]);
+  ns = measureNs([&](int n) {
+    memcpy(centered, frames[n & 15], sizeof(centered));
+    calculateKinematic(centered, velocity);
+  });
+  benchmarkSink = velocity[0];
+  report("calculateKinematic", ns);
+  loopNs += ns;
+
+  // the fixed point pipeline replaces FilterAnalogReadOuts() and calculateKinematic(), the counterpart of
+  // benchmarkFixedPipeline() in benchmark.h. The host has a fast double precision FPU, so the saving can be negative here,
+  // what counts are the cycles per frame on the ESP32.
+  static int restFrames[16][8];
+  for (int n = 0; n < 16; n++) randomCenteredFrame(seed, restFrames[n]);
+  double originalNs = measureNs([&](int n) {
+    memcpy(centered, restFrames[n & 15], sizeof(centered));
+    FilterAnalogReadOuts(centered);
+    calculateKinematic(centered, velocity);
+  });
+  benchmarkSink = velocity[0];
+  report("original filter + kinematic", originalNs);
+  int32_t mapped[8];
+  double fixedNs = measureNs([&](int n) {
+    memcpy(centered, restFrames[n & 15], sizeof(centered));
+    fixedPipeline.filter(centered, mapped);
+    fixedPipeline.kinematic(mapped, velocity);
+  });
+  benchmarkSink = velocity[0];
+  report("fixedPipeline filter + kinematic", fixedNs);
+  printf("%-40s %9.1f ns (%.0f %%)\n", "saved by the fixed point pipeline", originalNs - fixedNs,
+         100 * (originalNs - fixedNs) / originalNs);
+
+  // the Kalman filters are part of readAllFromSensors(), the counterpart of benchmarkKalman() in benchmark.h
+  static uint16_t rawFrames[16][8];
+  for (int n = 0; n < 16; n++) {
+    for (int i = 0; i < 8; i++) {
+      seed = seed * 1103515245 + 12345;
+      rawFrames[n][i] = 1400 * SENSOR_SCALE + ((seed >> 16) % 64) - 32;
+    }
+  }
+  FloatKalman floatFilters[8] = {
+    { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 },
+    { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }
+  };
+  ns = measureNs([&](int n) {
+    for (int i = 0; i < 8; i++) raw[i] = floatFilters[i].updateEstimate(rawFrames[n & 15][i]);
+  });
+  benchmarkSink = raw[0];
+  report("Kalman float, 8 channels", ns);
+  static KalmanBank bank;
+  bank.init(5.0, 2.0, 0.01, false);
+  ns = measureNs([&](int n) {
+    bank.update(rawFrames[n & 15], raw);
+  });
+  benchmarkSink = raw[0];
+  report("KalmanBank exact, 8 channels", ns);
+  // a quiet sensor, so the gain freezes
+  bank.init(5.0, 2.0, 0.01, true);
+  for (int n = 0; n < 16 * KALMAN_SS_SAMPLES && !bank.isSteady(); n++) bank.update(rawFrames[0], raw);
+  ns = measureNs([&](int n) {
+    bank.update(rawFrames[n & 15], raw);
+  });
+  benchmarkSink = raw[0];
+  report(bank.isSteady() ? "KalmanBank steady, 8 channels" : "KalmanBank steady (not converged)", ns);
+
+  // the curves are part of calculateKinematic(), so they don't count for the loop iteration again
+  uint8_t savedModFunc = modFunc;
+  for (uint8_t f = 0; f < NUM_MODIFIER_CURVES; f++) {
+    modFunc = f;
+    int sum = 0;
+    ns = measureNs([&](int n) {
+      sum += modifierFunction(n % 701 - 350);
+    });
+    benchmarkSink = sum;
+    char name[40];
+    snprintf(name, sizeof(name), "modifierFunction MODFUNC %d", f);
+    report(name, ns);
+  }
+  modFunc = savedModFunc;
+
+#if NUMKEYS > 0
+  int keys[NUMKEYS];
+  uint8_t keyOut[NUMKEYS];
+  uint8_t keyState[NUMKEYS] = {};
+  int noDebug = -1;
+  ns = measureNs([&](int n) {
+    for (int k = 0; k < NUMKEYS; k++) keys[k] = ((n >> 4) + k) & 1;  // toggle the keys every 16 calls
+    shimMicros += 1000;
+    evalKeys(keys, keyOut, keyState, noDebug);
+  });
+  benchmarkSink = keyState[0];
+  report("evalKeys", ns);
+  loopNs += ns;
+
+  uint8_t keyData[HIDMAXBUTTONS];
+  ns = measureNs([&](int n) {
+    keyState[0] = n & 1;
+    prepareKeyBytes(keyState, keyData, noDebug);
+  });
+  benchmarkSink = keyData[0];
+  report("prepareKeyBytes", ns);
+  loopNs += ns;
+#endif
+
+  report("loop iteration (sum of the above)", loopNs);
+  return failures ? 1 : 0;
+}
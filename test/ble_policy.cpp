@@ -0,0 +1,148 @@
+// Test of the notification batching and the connection interval policy of the BLE HID in bleHidPolicy.h with a mock GATT server.
+// The reports are packed like in sendUSBData() and collected between the connection events of the mock. The mock can be
+// congested, like the controller of the ESP32 with full buffers.
+#include "config.h"
+#include "hidReport.h"
+#include "bleHidPolicy.h"
+#include "check.h"
+
+class MockGatt : public BleGatt {
+public:
+  bool notify(uint8_t id, const uint8_t* data, size_t len) override {
+    if (congested) return false;
+    Notification& n = log[count++ % 16];
+    n.id = id;
+    n.len = len;
+    memcpy(n.data, data, len);
+    return true;
+  }
+
+  void requestInterval(uint16_t minUnits, uint16_t maxUnits) override {
+    lastMinUnits = minUnits;
+    lastMaxUnits = maxUnits;
+    requests++;
+  }
+
+  struct Notification {
+    uint8_t id;
+    size_t len;
+    uint8_t data[BLE_BATCH_MAX_REPORT];
+  } log[16];
+  int count = 0;
+  bool congested = false;
+  uint16_t lastMinUnits = 0;
+  uint16_t lastMaxUnits = 0;
+  int requests = 0;
+};
+
+static int16_t getInt16LE(const uint8_t* p) {
+  return (int16_t)(p[0] | (p[1] << 8));
+}
+
+static void testBatching() {
+  MockGatt gatt;
+  BleNotifyBatcher batcher;
+  uint8_t payload[HID_COMBINED_MAX_SIZE];
+
+  // split reports: translation, rotation and buttons in one connection event, the oldest first
+  packAxesReport(payload, 1, 2, 3);
+  CHECK(batcher.add(1, payload, HID_AXES_REPORT_SIZE));
+  packAxesReport(payload, 4, 5, 6);
+  CHECK(batcher.add(2, payload, HID_AXES_REPORT_SIZE));
+  uint8_t buttons[2] = { 0x01, 0x00 };
+  CHECK(batcher.add(3, buttons, sizeof(buttons)));
+  // a newer translation replaces the pending one, but keeps its place
+  packAxesReport(payload, -7, 8, -9);
+  CHECK(batcher.add(1, payload, HID_AXES_REPORT_SIZE));
+  CHECK(batcher.coalesced == 1);
+  CHECK(batcher.pending() == 3);
+
+  CHECK(batcher.flush(gatt, 2, 0) == 2);  // only two notifications per event, the buttons wait
+  CHECK(gatt.count == 2);
+  CHECK(gatt.log[0].id == 2);  // the rotation was posted before the newest translation
+  CHECK(getInt16LE(gatt.log[0].data + 4) == 6);
+  CHECK(gatt.log[1].id == 3);
+  CHECK(batcher.pending() == 1);
+  CHECK(batcher.flush(gatt, 2, 8) == 1);
+  CHECK(gatt.log[2].id == 1);
+  CHECK(gatt.log[2].len == HID_AXES_REPORT_SIZE);
+  CHECK(getInt16LE(gatt.log[2].data) == -7 && getInt16LE(gatt.log[2].data + 2) == 8 && getInt16LE(gatt.log[2].data + 4) == -9);
+  CHECK(batcher.pending() == 0);
+  CHECK(batcher.events == 2);
+
+  // combined report: all axis and the buttons in one notification
+  size_t len = packCombinedReport(payload, 10, -20, 30, -40, 50, -60, buttons, sizeof(buttons));
+  CHECK(len == HID_COMBINED_AXES_SIZE + 2);
+  CHECK(len <= BLE_BATCH_MAX_REPORT);
+  CHECK(batcher.add(1, payload, len));
+  CHECK(batcher.flush(gatt, BLE_MAX_NOTIFY_PER_EVENT, 16) == 1);
+  CHECK(gatt.log[3].len == len);
+  CHECK(getInt16LE(gatt.log[3].data + 10) == -60);
+  CHECK(gatt.log[3].data[12] == 0x01);
+
+  // a congested stack keeps the report, it is notified in the next connection event
+  buttons[0] = 0;  // the release of the button must reach the host
+  CHECK(batcher.add(3, buttons, sizeof(buttons)));
+  gatt.congested = true;
+  CHECK(batcher.flush(gatt, BLE_MAX_NOTIFY_PER_EVENT, 24) == 0);
+  CHECK(batcher.congested == 1);
+  CHECK(batcher.pending() == 1);
+  gatt.congested = false;
+  CHECK(batcher.flush(gatt, BLE_MAX_NOTIFY_PER_EVENT, 32) == 1);
+  CHECK(gatt.log[4].id == 3 && gatt.log[4].data[0] == 0);
+  CHECK(batcher.pending() == 0);
+  CHECK(batcher.dropped == 0);
+
+  // too long reports and more ids than slots are dropped
+  uint8_t tooLong[BLE_BATCH_MAX_REPORT + 1] = {};
+  CHECK(!batcher.add(2, tooLong, sizeof(tooLong)));
+  CHECK(batcher.add(23, buttons, 2));
+  CHECK(!batcher.add(42, buttons, 2));
+  CHECK(batcher.dropped == 2);
+
+  // the rate of the notifications within the last second
+  BleNotifyBatcher rate;
+  for (uint32_t ms = 0; ms <= 1000; ms += 10) {
+    rate.add(1, payload, HID_AXES_REPORT_SIZE);
+    rate.flush(gatt, BLE_MAX_NOTIFY_PER_EVENT, ms);
+  }
+  CHECK(rate.rateHz == 101);
+}
+
+static void testIntervalPolicy() {
+  MockGatt gatt;
+  BleIntervalPolicy policy(BLE_FAST_INTERVAL, BLE_IDLE_INTERVAL, BLE_IDLE_MS);
+  policy.connected(0);
+  CHECK(policy.intervalUs() == BLE_FAST_INTERVAL * BLE_INTERVAL_UNIT_US);
+
+  // motion: the fast interval is requested once
+  policy.update(gatt, 10, true);
+  policy.update(gatt, 20, true);
+  CHECK(gatt.requests == 1);
+  CHECK(gatt.lastMinUnits == BLE_FAST_INTERVAL && gatt.lastMaxUnits == 2 * BLE_FAST_INTERVAL);
+  CHECK(policy.fast());
+
+  // no motion: the idle interval after BLE_IDLE_MS
+  policy.update(gatt, 20 + BLE_IDLE_MS - 1, false);
+  CHECK(gatt.requests == 1);
+  policy.update(gatt, 20 + BLE_IDLE_MS, false);
+  CHECK(gatt.requests == 2);
+  CHECK(gatt.lastMinUnits == BLE_IDLE_INTERVAL && gatt.lastMaxUnits == 2 * BLE_IDLE_INTERVAL);
+  CHECK(!policy.fast());
+  CHECK(policy.intervalUs() == BLE_IDLE_INTERVAL * BLE_INTERVAL_UNIT_US);
+
+  // the interval set by the host is used, until the host sets a new one
+  policy.intervalUpdated(40);
+  CHECK(policy.intervalUs() == 40 * BLE_INTERVAL_UNIT_US);
+  policy.update(gatt, 5000, true);
+  CHECK(gatt.requests == 3);
+  CHECK(policy.fast());
+  CHECK(policy.intervalUs() == 40 * BLE_INTERVAL_UNIT_US);
+  CHECK(policy.requests == 3);
+}
+
+int main() {
+  testBatching();
+  testIntervalPolicy();
+  return checkResult("ble_policy");
+}
@@ -0,0 +1,94 @@
+// Test of the zeroing of the sensors, busyZeroing() in calibration.h, with a mock ADC in virtual time
+// The mock converts one scan per SAMPLING_PERIOD_US like the continuous ADC, so the number of averaged frames and the
+// duration are the same as on the device.
+#include <Arduino.h>
+#include "config.h"
+#include "calibration.h"
+#include "check.h"
+
+// the parts of the sketch, which calibration.h only declares
+#if CALIBSTORE > 0
+bool saveCalibration() {
+  return true;
+}
+#endif
+#if SAMPLING_TASK > 0
+void printSamplingStats() {}
+#endif
+#if SCREEN_DIRTY_RENDER > 0
+void printScreenStats() {}
+#endif
+#if HID_SCHEDULER > 0
+class NoEndpoint : public HidEndpoint {
+public:
+  bool ready() override {
+    return false;
+  }
+  bool send(uint8_t, const uint8_t*, size_t) override {
+    return false;
+  }
+} noEndpoint;
+HidScheduler hidScheduler(noEndpoint, HID_MIN_INTERVAL_US, HID_MAX_AGE_US);
+#endif
+#if HID_COALESCE > 0
+ReportCoalescer reportCoalescer(HID_MAX_STALE_MS);
+#endif
+#if POWER_GOVERNOR > 0
+const PowerProfile powerProfiles[] = { {}, {}, {} };
+PowerGovernor powerGovernor(powerProfiles, POWER_IDLE_MS);
+#endif
+
+#define REST 1400  // ADC value of the sensors at rest
+#define NOISE 3    // +/- counts of noise of every scan
+
+/// @brief One scan of the sensors per SAMPLING_PERIOD_US, the virtual time runs with the scans
+class MockAdc : public AdcEngine {
+public:
+  void service() override {
+    shimMicros += SAMPLING_PERIOD_US;
+    if (stalled) return;
+    uint16_t values[ADC_CHANNELS];
+    for (int i = 0; i < ADC_CHANNELS; i++) {
+      seed = seed * 1103515245 + 12345;
+      values[i] = REST + 10 * i + (int)((seed >> 16) % (2 * NOISE + 1)) - NOISE;
+      if (i == movedSensor) values[i] += (shimMicros / 1000) % 200;  // someone touches the knob
+    }
+    pushScan(values, shimMicros);
+  }
+
+  bool stalled = false;
+  int movedSensor = -1;
+  uint32_t seed = 1;
+};
+
+int main() {
+  static MockAdc adc;
+  int centerPoints[8];
+  int raw[8];
+  setupkalmanFilters();
+  for (int n = 0; n < 100 * OVERSAMPLING_RATIO; n++) readAllFromSensors(raw, adc);  // settle the Kalman filters
+
+  // the knob at rest: the center points are the means of the frames
+  CHECK(busyZeroing(centerPoints, 500, true, adc));
+  for (int i = 0; i < 8; i++) CHECK(abs(centerPoints[i] - (REST + 10 * i) * SENSOR_SCALE) <= NOISE);
+  char frames[40];
+  snprintf(frames, sizeof(frames), " ms for %d frames.", 500 * ADC_SAMPLE_RATE_HZ / OVERSAMPLING_RATIO / 1000);
+  CHECK(Serial.output.find(frames) != std::string::npos);
+  CHECK(Serial.output.find("Attention") == std::string::npos);
+
+  // a moved axis gives a warning, but the zeroing is done
+  Serial.output.clear();
+  adc.movedSensor = 3;
+  CHECK(!busyZeroing(centerPoints, 500, true, adc));
+  CHECK(Serial.output.find("Moved axis?") != std::string::npos);
+  CHECK(abs(centerPoints[3] - (REST + 30) * SENSOR_SCALE) > NOISE);
+
+  // no frames from the ADC: the center points stay as they are
+  adc.movedSensor = -1;
+  int before[8];
+  memcpy(before, centerPoints, sizeof(before));
+  adc.stalled = true;
+  CHECK(!busyZeroing(centerPoints, 500, false, adc));
+  CHECK(memcmp(before, centerPoints, sizeof(before)) == 0);
+  return checkResult("busy_zeroing");
+}
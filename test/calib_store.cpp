@@ -0,0 +1,131 @@
+// Test of the binary calibration blob in calibStore.h
+// The blob must survive a round trip, a version 1 blob must still be read, and a corrupt, truncated or unknown blob
+// must be refused without changing the destination. calibrationError() must catch the values, which break the pipeline.
+#include "config.h"
+#include "calibStore.h"
+#include "check.h"
+#include <math.h>
+
+static CalibrationData sampleCalibration() {
+  CalibrationData c;
+  for (int i = 0; i < 8; i++) {
+    c.minVals[i] = -500 - i;
+    c.maxVals[i] = 546 + i;
+    c.centerPoints[i] = 8000 + 13 * i;
+  }
+  for (int i = 0; i < 7; i++) c.sensitivities[i] = 0.5f + i;
+  for (int i = 0; i < 4; i++) c.gates[i] = 20 + i;
+  c.modFunc = 3;
+  c.invertMask = 0xA5;
+  c.sensorResolution = 14;
+  c.flags = CALIB_FLAG_CENTERPOINTS | CALIB_FLAG_MATRIX;
+  for (int a = 0; a < 6; a++) {
+    for (int i = 0; i < 8; i++) c.kinematicMatrix[a][i] = (a * 8 + i) * 100 - 2400;
+  }
+  return c;
+}
+
+static bool sameCalibration(const CalibrationData& a, const CalibrationData& b, bool withMatrix) {
+  return memcmp(a.minVals, b.minVals, sizeof(a.minVals)) == 0 && memcmp(a.maxVals, b.maxVals, sizeof(a.maxVals)) == 0
+         && memcmp(a.centerPoints, b.centerPoints, sizeof(a.centerPoints)) == 0
+         && memcmp(a.sensitivities, b.sensitivities, sizeof(a.sensitivities)) == 0
+         && memcmp(a.gates, b.gates, sizeof(a.gates)) == 0 && a.modFunc == b.modFunc && a.invertMask == b.invertMask
+         && a.sensorResolution == b.sensorResolution
+         && (!withMatrix || memcmp(a.kinematicMatrix, b.kinematicMatrix, sizeof(a.kinematicMatrix)) == 0);
+}
+
+/// @brief Store a new CRC after the blob was changed
+static void resign(uint8_t* blob, size_t len) {
+  uint8_t* p = blob + len - 4;
+  calibPut(p, crc32Update(0, blob, len - 4), 4);
+}
+
+int main() {
+  const CalibrationData original = sampleCalibration();
+  uint8_t blob[CALIB_MAX_SIZE];
+  size_t len = serializeCalibration(original, blob);
+  CHECK(len == CALIB_MAX_SIZE);
+  CHECK(calibrationError(original) == NULL);
+
+  // round trip
+  CalibrationData c = {};
+  CHECK(deserializeCalibration(blob, len, c));
+  CHECK(sameCalibration(c, original, true) && c.flags == original.flags);
+
+  // every truncation and every single bit error is refused, the destination stays untouched
+  CalibrationData untouched = {};
+  for (size_t n = 0; n < len; n++) CHECK(!deserializeCalibration(blob, n, untouched));
+  for (size_t bit = 0; bit < 8 * len; bit++) {
+    blob[bit / 8] ^= 1 << (bit % 8);
+    CHECK(!deserializeCalibration(blob, len, untouched));
+    blob[bit / 8] ^= 1 << (bit % 8);
+  }
+  CalibrationData zero = {};
+  CHECK(memcmp(&untouched, &zero, sizeof(zero)) == 0);
+
+  // an unknown version or a size, which doesn't match the version, is refused even with a valid CRC
+  uint8_t changed[CALIB_MAX_SIZE];
+  memcpy(changed, blob, len);
+  changed[4] = CALIB_VERSION + 1;
+  resign(changed, len);
+  CHECK(!deserializeCalibration(changed, len, c));
+  memcpy(changed, blob, len);
+  changed[4] = 1;  // version 1 with the size of version 2
+  resign(changed, len);
+  CHECK(!deserializeCalibration(changed, len, c));
+
+  // version 1: the same blob without the matrix, which is taken from config.h after loading
+  uint8_t v1[CALIB_HEADER_SIZE + CALIB_PAYLOAD_SIZE_V1 + 4];
+  memcpy(v1, blob, CALIB_HEADER_SIZE + CALIB_PAYLOAD_SIZE_V1);
+  v1[4] = 1;
+  v1[5] = 0;
+  v1[6] = CALIB_PAYLOAD_SIZE_V1;
+  v1[7] = 0;
+  resign(v1, sizeof(v1));
+  CHECK(deserializeCalibration(v1, sizeof(v1), c));
+  CHECK(sameCalibration(c, original, false));
+  CHECK(c.flags == CALIB_FLAG_CENTERPOINTS);
+  for (int a = 0; a < 6; a++) {
+    for (int i = 0; i < 8; i++) CHECK(c.kinematicMatrix[a][i] == 0);
+  }
+  // storing it again upgrades it to the actual version
+  uint8_t v2[CALIB_MAX_SIZE];
+  CHECK(serializeCalibration(c, v2) == CALIB_MAX_SIZE);
+  CHECK(v2[4] == CALIB_VERSION && deserializeCalibration(v2, sizeof(v2), c));
+  CHECK(sameCalibration(c, original, false) && !(c.flags & CALIB_FLAG_MATRIX));
+
+  // values, which would break the pipeline, are rejected with the same limits as the "set" command
+  c = original;
+  c.sensitivities[5] = 0;  // SENS_ROTY
+  CHECK(calibrationError(c) != NULL);
+  c.sensitivities[5] = NAN;
+  CHECK(calibrationError(c) != NULL);
+  c.sensitivities[5] = SENSITIVITY_MAX * 2;
+  CHECK(calibrationError(c) != NULL);
+  c = original;
+  c.minVals[2] = c.maxVals[2] = 0;
+  CHECK(calibrationError(c) != NULL);
+  c = original;
+  c.minVals[5] = 10;
+  CHECK(calibrationError(c) != NULL);
+  c = original;
+  c.modFunc = NUM_MODIFIER_CURVES;
+  CHECK(calibrationError(c) != NULL);
+  c = original;
+  c.gates[1] = -1;
+  CHECK(calibrationError(c) != NULL);
+  c.gates[1] = GATE_MAX + 1;
+  CHECK(calibrationError(c) != NULL);
+  c = original;
+  c.sensorResolution = 40;
+  CHECK(calibrationError(c) != NULL);
+  c.flags &= ~CALIB_FLAG_CENTERPOINTS;  // the resolution doesn't matter without center points
+  CHECK(calibrationError(c) == NULL);
+
+  // a bad value survives the serialization, the check is done before the values are used
+  c = original;
+  c.modFunc = 200;
+  len = serializeCalibration(c, blob);
+  CHECK(deserializeCalibration(blob, len, c) && calibrationError(c) != NULL);
+  return checkResult("calib_store");
+}
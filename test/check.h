@@ -0,0 +1,23 @@
+// Minimal checks for the host tests, see CMakeLists.txt
+// A failed check is printed with its line and counted, the test goes on. main() returns checkResult().
+#ifndef CHECK_H
+#define CHECK_H
+#include <stdio.h>
+
+static int checkFailures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      checkFailures++; \
+    } \
+  } while (0)
+
+/// @brief Report the result of the test
+/// @return exit code of the test, 0 if all checks passed
+inline int checkResult(const char* name) {
+  printf("%s: %s\n", name, checkFailures ? "FAILED" : "passed");
+  return checkFailures ? 1 : 0;
+}
+#endif
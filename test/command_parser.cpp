@@ -0,0 +1,118 @@
+// Test of the serial command parser in commandParser.h
+// The lines are fed byte by byte, like pollSerialCommands() takes them from the serial interface, with all kinds of line
+// endings and with the idle timeout. Then random bytes are fed, the parser must never write beyond its line and every
+// parsed command must point into the line.
+#include "config.h"
+#include "commandParser.h"
+#include "check.h"
+
+/// @brief Feed a string byte by byte
+/// @return number of completed lines, the last one is copied to lastLine
+static int feedString(CommandParser& parser, const char* text, uint32_t nowMs, char* lastLine) {
+  int lines = 0;
+  for (const char* p = text; *p; p++) {
+    if (parser.feed(*p, nowMs)) {
+      strcpy(lastLine, parser.line());
+      lines++;
+    }
+  }
+  return lines;
+}
+
+static void testLines() {
+  CommandParser parser;
+  char line[COMMAND_MAX_LINE + 1];
+
+  // every line ending completes the line, the empty line of "\r\n" is not reported
+  CHECK(feedString(parser, "12\n", 0, line) == 1 && strcmp(line, "12") == 0);
+  CHECK(feedString(parser, "13\r\n", 0, line) == 1 && strcmp(line, "13") == 0);
+  CHECK(feedString(parser, "14\r", 0, line) == 1 && strcmp(line, "14") == 0);
+  CHECK(feedString(parser, "\n\r\n", 0, line) == 0);
+
+  // without line ending, the line is complete after COMMAND_IDLE_MS
+  CHECK(feedString(parser, "#5 stats", 1000, line) == 0);
+  CHECK(!parser.idle(1000 + COMMAND_IDLE_MS - 1));
+  CHECK(parser.idle(1000 + COMMAND_IDLE_MS));
+  CHECK(strcmp(parser.line(), "#5 stats") == 0);
+  CHECK(!parser.idle(5000));  // nothing pending
+
+  // a line with exactly COMMAND_MAX_LINE bytes is taken, a longer one is discarded up to its end
+  char longLine[COMMAND_MAX_LINE + 3];
+  memset(longLine, 'a', COMMAND_MAX_LINE);
+  strcpy(longLine + COMMAND_MAX_LINE, "\n");
+  CHECK(feedString(parser, longLine, 0, line) == 1 && strlen(line) == COMMAND_MAX_LINE);
+  memset(longLine, 'b', COMMAND_MAX_LINE + 1);
+  strcpy(longLine + COMMAND_MAX_LINE + 1, "\n");
+  CHECK(feedString(parser, longLine, 0, line) == 0);
+  CHECK(parser.overflows == 1);
+  CHECK(feedString(parser, "7\n", 0, line) == 1 && strcmp(line, "7") == 0);  // the next line is fine again
+
+  // a NUL byte doesn't cut the line
+  CHECK(!parser.feed('\0', 0) && !parser.feed('1', 0) && !parser.feed('\0', 0) && !parser.feed('5', 0));
+  CHECK(parser.feed('\n', 0) && strcmp(parser.line(), "15") == 0);
+}
+
+static void testCommands() {
+  char line[COMMAND_MAX_LINE + 1];
+  Command cmd;
+
+  strcpy(line, "-1");
+  CHECK(parseCommand(line, cmd) && cmd.plainNumber && cmd.number == -1 && cmd.id == -1);
+
+  strcpy(line, "  #42\tset  sens_rotx 1.5 ");
+  CHECK(parseCommand(line, cmd));
+  CHECK(!cmd.plainNumber && cmd.id == 42 && strcmp(cmd.name, "set") == 0);
+  CHECK(cmd.argc == 2 && strcmp(cmd.args[0], "sens_rotx") == 0 && strcmp(cmd.args[1], "1.5") == 0);
+
+  strcpy(line, "stats");
+  CHECK(parseCommand(line, cmd) && cmd.id == -1 && strcmp(cmd.name, "stats") == 0 && cmd.argc == 0);
+
+  strcpy(line, "#7 12");  // a number with an id is a command named "12", not a debug mode
+  CHECK(parseCommand(line, cmd) && !cmd.plainNumber && strcmp(cmd.name, "12") == 0);
+
+  const char* malformed[] = { "", "   ", "#", "#x stats", "#-3 stats", "#4", "set a b c d", "#1 set a b c d" };
+  for (const char* text : malformed) {
+    strcpy(line, text);
+    CHECK(!parseCommand(line, cmd));
+  }
+}
+
+static void testFuzz() {
+  CommandParser parser;
+  uint32_t seed = 99;
+  uint32_t nowMs = 0;
+  int lines = 0;
+  int parsed = 0;
+  const char alphabet[] = "#0123456789 \t\r\n-abcdefgsetdebug";
+  for (int n = 0; n < 1000000; n++) {
+    seed = seed * 1103515245 + 12345;
+    char c = (seed >> 28) < 12 ? alphabet[(seed >> 8) % (sizeof(alphabet) - 1)] : (char)(seed >> 16);
+    nowMs += (seed >> 24) & 15;
+    bool complete = parser.feed(c, nowMs);
+    if (!complete && (seed & 0xFF) == 0) complete = parser.idle(nowMs + COMMAND_IDLE_MS);
+    if (!complete) continue;
+    lines++;
+    char* line = parser.line();
+    size_t len = strlen(line);
+    CHECK(len > 0 && len <= COMMAND_MAX_LINE);
+    Command cmd;
+    if (!parseCommand(line, cmd)) continue;
+    parsed++;
+    if (cmd.plainNumber) continue;
+    CHECK(cmd.argc >= 0 && cmd.argc <= COMMAND_MAX_ARGS);
+    CHECK(cmd.name >= line && cmd.name < line + len && *cmd.name != '\0');
+    for (int i = 0; i < cmd.argc; i++) {
+      CHECK(cmd.args[i] > cmd.name && cmd.args[i] < line + len && *cmd.args[i] != '\0');
+      CHECK(strpbrk(cmd.args[i], " \t") == nullptr);
+    }
+  }
+  printf("fuzz: %d lines, %d parsed, %lu overflows\n", lines, parsed, (unsigned long)parser.overflows);
+  CHECK(lines > 1000 && parsed > 100);
+}
+
+int main() {
+  testLines();
+  testCommands();
+  testFuzz();
+  return checkResult("command_parser");
+}
@@ -0,0 +1,115 @@
+// Sweep harness of the fixed point and the fused pipeline against the original steps of the loop(), see pipelineCheck.h
+// For every modifier curve, each sensor is swept over its whole range, then random frames with all sensors and pressed
+// kill-keys are used. Reports the deviations like the benchmarks on the spacemouse (debug mode 13).
+// The original pipeline truncates the input of the modifier curve, the fixed point one keeps the fraction, so a velocity may
+// differ by one step of the curve, but not more. Values, which are gated to zero by only one pipeline, are counted separately.
+// Every variant of the fused pipeline (SWITCHYZ, EXCLUSIVEMODE, kill-keys) is instantiated, not only the one of this build:
+// it must give exactly the results of the single fixed point steps. Against the original steps, the exclusive mode may only
+// report the other group, if both groups were equal within the deviation of their axis (one step of the curve per axis, plus a
+// gate at the edge), see PipelineDeviation::groupFlips.
+#include <Arduino.h>
+#include "config.h"
+#include "pipelineCheck.h"
+#include "check.h"
+
+#define RANDOM_FRAMES 100000
+#define VARIANT_FRAMES 20000
+#define VARIANT_KILLROT 0    // keys of the kill-keys in the variants with kill-keys
+#define VARIANT_KILLTRANS 1
+
+/// @brief Largest difference of the curve output between two neighboring inputs
+static int maxCurveStep(uint8_t f) {
+  int step = 1;
+  for (int x = -350; x < 350; x++) {
+    int d = abs(getModifierCurve(f, false).apply(x + 1) - getModifierCurve(f, false).apply(x));
+    if (d > step) step = d;
+  }
+  return step;
+}
+
+/// @brief Compare a variant of the fused pipeline with the original and with the fixed point single steps
+/// @param allowed allowed deviation from the original steps
+template<class Fused, bool SWAP_YZ, bool EXCLUSIVE, int KILL_ROT, int KILL_TRANS>
+static void checkVariant(const char* name, int allowed) {
+  int centered[8];
+  int keys[8];
+  PipelineDeviation original = {};
+  PipelineDeviation fixed = {};
+  uint32_t seed = 815;
+  for (int n = 0; n < VARIANT_FRAMES; n++) {
+    randomCenteredFrame(seed, centered);
+    for (int k = 0; k < 8; k++) {
+      keys[k] = ((seed >> (k + 3)) & 3) == 0 ? LOW : HIGH;
+    }
+    compareFusedVariant<Fused, false, SWAP_YZ, EXCLUSIVE, KILL_ROT, KILL_TRANS>(centered, keys, original);
+    compareFusedVariant<Fused, true, SWAP_YZ, EXCLUSIVE, KILL_ROT, KILL_TRANS>(centered, keys, fixed);
+  }
+  printf("  %-28s", name);
+  original.report("original:");
+  printf("%s", Serial.output.c_str());
+  Serial.output.clear();
+  CHECK(original.maxDeviation <= allowed);
+  CHECK(original.gateEdges * 100 < original.comparisons);
+  int maxGate = 0;
+  for (int g = 0; g < 4; g++) maxGate = max(maxGate, gates[g]);
+  CHECK(original.maxFlipMargin <= 6 * allowed + 2 * maxGate);
+  CHECK(original.groupFlips * 100 < VARIANT_FRAMES);
+  CHECK(fixed.deviations == 0 && fixed.groupFlips == 0);  // the same arithmetic as the fixed point steps
+}
+
+/// @brief Check all variants of the fused pipeline
+static void checkVariants(int allowed) {
+  typedef KillKeys<VARIANT_KILLROT, VARIANT_KILLTRANS> Kill;
+  const int KR = VARIANT_KILLROT;
+  const int KT = VARIANT_KILLTRANS;
+  checkVariant<FusedPipeline<NoAxisSwap, NoExclusive, NoKillKeys>, false, false, -1, -1>("plain", allowed);
+  checkVariant<FusedPipeline<SwapYZ, NoExclusive, NoKillKeys>, true, false, -1, -1>("swap", allowed);
+  checkVariant<FusedPipeline<NoAxisSwap, ExclusiveTransRot, NoKillKeys>, false, true, -1, -1>("exclusive", allowed);
+  checkVariant<FusedPipeline<SwapYZ, ExclusiveTransRot, NoKillKeys>, true, true, -1, -1>("swap+exclusive", allowed);
+  checkVariant<FusedPipeline<NoAxisSwap, NoExclusive, Kill>, false, false, KR, KT>("kill", allowed);
+  checkVariant<FusedPipeline<SwapYZ, NoExclusive, Kill>, true, false, KR, KT>("swap+kill", allowed);
+  checkVariant<FusedPipeline<NoAxisSwap, ExclusiveTransRot, Kill>, false, true, KR, KT>("exclusive+kill", allowed);
+  checkVariant<FusedPipeline<SwapYZ, ExclusiveTransRot, Kill>, true, true, KR, KT>("swap+exclusive+kill", allowed);
+}
+
+int main() {
+  int centered[8];
+  int keys[NUMKEYS + 1];
+  uint8_t savedModFunc = modFunc;
+  for (uint8_t f = 0; f < NUM_MODIFIER_CURVES; f++) {
+    modFunc = f;
+    int maxDeviation = maxCurveStep(f);
+    printf("MODFUNC %d, allowed deviation %d counts\n", f, maxDeviation);
+
+    PipelineDeviation sweep = {};
+    sweepFixedPipeline(sweep);
+    sweep.report("  sweep: ");
+
+    PipelineDeviation random = {};
+    PipelineDeviation golden = {};
+    uint32_t seed = 4711;
+    for (int n = 0; n < RANDOM_FRAMES; n++) {
+      randomCenteredFrame(seed, centered);
+      for (int k = 0; k < NUMKEYS; k++) {
+        keys[k] = ((seed >> k) & 7) == 0 ? LOW : HIGH;  // the kill-keys are pressed sometimes
+      }
+      compareFixedPipeline(centered, random);
+      compareFusedPipeline(centered, keys, golden);
+    }
+    random.report("  random:");
+    golden.report("  golden:");
+    printf("%s", Serial.output.c_str());
+    Serial.output.clear();
+
+    CHECK(sweep.maxDeviation <= maxDeviation);
+    CHECK(random.maxDeviation <= maxDeviation);
+    CHECK(golden.maxDeviation <= maxDeviation);
+    // the gate edges are rare, they only shift the gate by a fraction of a count
+    CHECK(random.gateEdges * 100 < random.comparisons);
+    CHECK(golden.gateEdges * 100 < golden.comparisons);
+    CHECK(golden.groupFlips == 0);
+    checkVariants(maxDeviation);
+  }
+  modFunc = savedModFunc;
+  return checkResult("fixed_sweep");
+}
@@ -0,0 +1,71 @@
+// Test of the flight recorder: the dump must have the layout, which tools/flightrecorder_decode.py expects
+// (44 byte header, FLIGHTRECORDER_RECORD_SIZE bytes per record, CRC-32 trailer), independent of the padding in the RAM.
+#include <Arduino.h>
+#include "config.h"
+#include "flightRecorder.h"
+#include "check.h"
+
+static uint32_t getLE(const uint8_t* p, int bytes) {
+  uint32_t v = 0;
+  for (int i = 0; i < bytes; i++) v |= (uint32_t)p[i] << (8 * i);
+  return v;
+}
+
+int main() {
+  static FlightRecorder recorder;
+  int rawReads[8];
+  int centered[8];
+  int16_t velocity[6] = {};
+  uint8_t keyState[NUMKEYS > 0 ? NUMKEYS : 1] = {};
+  int centerPoints[8] = { 8000, 8001, 8002, 8003, 8004, 8005, 8006, 8007 };
+
+  // fill more than the depth, the velocity jumps once and triggers the recorder
+  const int jumpAt = 700;
+  int n = 0;
+  while (!recorder.isFrozen() && n < 10000) {
+    for (int i = 0; i < 8; i++) {
+      rawReads[i] = 8000 + n + i;
+      centered[i] = n - i;
+    }
+    velocity[0] = n >= jumpAt ? FLIGHTRECORDER_JUMP + 1 : 0;
+    recorder.record(1000 * n, rawReads, centered, velocity, keyState);
+    n++;
+  }
+  CHECK(recorder.isFrozen());
+  CHECK(n == jumpAt + FLIGHTRECORDER_POSTTRIGGER + 1);
+
+  Serial.output.clear();
+  recorder.dump(Serial, centerPoints);
+  const uint8_t* d = (const uint8_t*)Serial.output.data();
+  size_t expected = FLIGHTRECORDER_HEADER_SIZE + FLIGHTRECORDER_DEPTH * FLIGHTRECORDER_RECORD_SIZE + 4;
+  CHECK(Serial.output.size() == expected);
+  if (Serial.output.size() != expected) return checkResult("flight_recorder");
+
+  CHECK(memcmp(d, "SMFR", 4) == 0);
+  CHECK(d[4] == FLIGHTRECORDER_VERSION);
+  CHECK(d[5] == FR_TRIGGER_ANOMALY);
+  CHECK(getLE(d + 6, 2) == FLIGHTRECORDER_RECORD_SIZE);
+  CHECK(getLE(d + 8, 2) == FLIGHTRECORDER_DEPTH);
+  CHECK(d[10] == SENSOR_RESOLUTION);
+  for (int i = 0; i < 8; i++) CHECK((int)getLE(d + 12 + 4 * i, 4) == centerPoints[i]);
+
+  // the records are in the order of recording, the oldest first
+  int triggers = 0;
+  for (int r = 0; r < FLIGHTRECORDER_DEPTH; r++) {
+    const uint8_t* p = d + FLIGHTRECORDER_HEADER_SIZE + r * FLIGHTRECORDER_RECORD_SIZE;
+    int sample = n - FLIGHTRECORDER_DEPTH + r;
+    CHECK(getLE(p, 4) == (uint32_t)(1000 * sample));
+    CHECK((int)getLE(p + 4, 2) == 8000 + sample);
+    CHECK((int16_t)getLE(p + 20 + 2 * 7, 2) == sample - 7);
+    CHECK((int16_t)getLE(p + 36, 2) == (sample >= jumpAt ? FLIGHTRECORDER_JUMP + 1 : 0));
+    if (p[49] & FR_FLAG_TRIGGER) {
+      triggers++;
+      CHECK(sample == jumpAt);
+    }
+  }
+  CHECK(triggers == 1);
+
+  size_t end = expected - 4;
+  CHECK(getLE(d + end, 4) == crc32Update(0, d, end));
+  return checkResult("flight_recorder");
+}
@@ -0,0 +1,26 @@
+// Float reference of the SimpleKalmanFilter for the tests and benchmarks of kalmanBank.h
+#ifndef FLOATKALMAN_H
+#define FLOATKALMAN_H
+#include <math.h>
+
+/// @brief Float reference, the same steps as SimpleKalmanFilter::updateEstimate()
+class FloatKalman {
+public:
+  FloatKalman(float measurementError, float estimationError, float processNoise)
+    : errMeasure(measurementError), errEstimate(estimationError), q(processNoise) {}
+
+  float updateEstimate(float measurement) {
+    float gain = errEstimate / (errEstimate + errMeasure);
+    float current = lastEstimate + gain * (measurement - lastEstimate);
+    errEstimate = (1.0f - gain) * errEstimate + fabsf(lastEstimate - current) * q;
+    lastEstimate = current;
+    return current;
+  }
+
+private:
+  float errMeasure;
+  float errEstimate;
+  float q;
+  float lastEstimate = 0;
+};
+#endif
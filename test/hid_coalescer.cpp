@@ -0,0 +1,80 @@
+// Test of the coalescing of the HID reports in hidCoalescer.h
+// A slow and steady motion is fed at the loop rate, the coalescer must cut the reports, but never lose the start or
+// the end of a motion and send at least every HID_MAX_STALE_MS.
+#include "config.h"
+#include "hidCoalescer.h"
+#include "check.h"
+
+int main() {
+  ReportCoalescer coalescer(HID_MAX_STALE_MS);
+  const int16_t thresholds[3] = { 4, 4, 4 };
+  const int16_t zero[3] = { 0, 0, 0 };
+
+  // the first report of an id is always sent, also a zero one, repeated zeros are suppressed
+  CHECK(coalescer.admit(1, zero, thresholds, 3, 0));
+  CHECK(!coalescer.admit(1, zero, thresholds, 3, 1));
+  CHECK(!coalescer.admit(1, zero, thresholds, 3, 1000));
+
+  // the first motion after the zeros is sent, even if it is small
+  int16_t v[3] = { 1, 0, 0 };
+  CHECK(coalescer.admit(1, v, thresholds, 3, 1001));
+  // changes below the threshold are suppressed, until one reaches it
+  v[0] = 4;
+  CHECK(!coalescer.admit(1, v, thresholds, 3, 1002));
+  v[0] = 5;
+  CHECK(coalescer.admit(1, v, thresholds, 3, 1003));
+  v[1] = -3;
+  CHECK(!coalescer.admit(1, v, thresholds, 3, 1004));
+  v[1] = -4;
+  CHECK(coalescer.admit(1, v, thresholds, 3, 1005));
+
+  // a steady value is sent again after HID_MAX_STALE_MS
+  CHECK(!coalescer.admit(1, v, thresholds, 3, 1005 + HID_MAX_STALE_MS - 1));
+  CHECK(coalescer.admit(1, v, thresholds, 3, 1005 + HID_MAX_STALE_MS));
+
+  // the end of the motion is sent once
+  CHECK(coalescer.admit(1, zero, thresholds, 3, 2000));
+  CHECK(!coalescer.admit(1, zero, thresholds, 3, 2001));
+
+  // the ids are independent, a threshold of 0 or 1 takes every change
+  const int16_t exact[2] = { 0, 1 };
+  int16_t buttons[2] = { 1, 0 };
+  CHECK(coalescer.admit(3, buttons, exact, 2, 2002));
+  CHECK(!coalescer.admit(3, buttons, exact, 2, 2003));
+  buttons[1] = 1;
+  CHECK(coalescer.admit(3, buttons, exact, 2, 2004));
+  CHECK(!coalescer.admit(1, zero, thresholds, 3, 2005));
+
+  // a report, which can't be compared, is always sent: more ids than slots or too many values
+  CHECK(coalescer.admit(2, zero, thresholds, 3, 2006));
+  CHECK(coalescer.admit(9, zero, thresholds, 3, 2007));
+  CHECK(coalescer.admit(9, zero, thresholds, 3, 2008));
+  int16_t many[HID_COALESCE_MAX_VALUES + 1] = {};
+  int16_t manyThresholds[HID_COALESCE_MAX_VALUES + 1] = {};
+  CHECK(coalescer.admit(1, many, manyThresholds, HID_COALESCE_MAX_VALUES + 1, 2009));
+
+  // after reset(), the next report of every id is sent
+  coalescer.reset();
+  CHECK(coalescer.admit(1, zero, thresholds, 3, 3000));
+
+  // slow and steady motion at 1 ms per loop: one count per 5 ms on every axis
+  ReportCoalescer steady(HID_MAX_STALE_MS);
+  int sent = 0;
+  uint32_t lastSentMs = 0;
+  uint32_t maxGapMs = 0;
+  for (uint32_t ms = 0; ms < 10000; ms++) {
+    int16_t value = ms / 5;
+    int16_t axes[3] = { value, (int16_t)-value, (int16_t)(value / 2) };
+    if (steady.admit(1, axes, thresholds, 3, ms)) {
+      if (ms - lastSentMs > maxGapMs) maxGapMs = ms - lastSentMs;
+      lastSentMs = ms;
+      sent++;
+    }
+  }
+  printf("steady motion: %d of 10000 reports sent, suppression %.1f %%, max. gap %lu ms\n", sent, steady.suppressionRatio(),
+         (unsigned long)maxGapMs);
+  CHECK(sent <= 10000 / 20 + 1);  // a report for every 4 counts
+  CHECK(maxGapMs <= HID_MAX_STALE_MS);
+  CHECK(steady.suppressionRatio() > 90);
+  return checkResult("hid_coalescer");
+}
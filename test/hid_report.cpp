@@ -0,0 +1,79 @@
+// Test of the packing of the HID reports in hidReport.h
+// The packed reports must be little endian and have exactly the size, which the report descriptor in hidDescriptor.h
+// declares for the input report, in the split and in the combined mode.
+#include "config.h"
+#include "hidReport.h"
+#include "hidDescriptor.h"
+#include "check.h"
+
+/// @brief Size of an input report in bytes, as declared by the report descriptor
+static int descriptorInputSize(uint8_t reportId) {
+  int bits = 0;
+  int id = 0, size = 0, count = 0;
+  for (size_t i = 0; i < sizeof(report_descriptor);) {
+    uint8_t prefix = report_descriptor[i];
+    int len = (prefix & 3) == 3 ? 4 : (prefix & 3);
+    uint32_t data = 0;
+    for (int k = 0; k < len; k++) data |= (uint32_t)report_descriptor[i + 1 + k] << (8 * k);
+    switch (prefix & 0xFC) {
+      case 0x84: id = data; break;     // Report ID
+      case 0x74: size = data; break;   // Report Size
+      case 0x94: count = data; break;  // Report Count
+      case 0x80:                       // Input
+        if (id == reportId) bits += size * count;
+        break;
+    }
+    i += 1 + len;
+  }
+  return bits / 8;
+}
+
+static int16_t getInt16LE(const uint8_t* p) {
+  return (int16_t)(p[0] | (p[1] << 8));
+}
+
+int main() {
+  uint8_t payload[HID_COMBINED_MAX_SIZE + 4];
+
+  // split report: three axis, little endian, also the extremes
+  memset(payload, 0xEE, sizeof(payload));
+  CHECK(packAxesReport(payload, 350, -350, -1) == HID_AXES_REPORT_SIZE);
+  CHECK(payload[0] == 0x5E && payload[1] == 0x01);  // 350
+  CHECK(payload[2] == 0xA2 && payload[3] == 0xFE);  // -350
+  CHECK(payload[4] == 0xFF && payload[5] == 0xFF);  // -1
+  CHECK(payload[HID_AXES_REPORT_SIZE] == 0xEE);     // nothing written beyond the report
+  packAxesReport(payload, INT16_MAX, INT16_MIN, 0);
+  CHECK(getInt16LE(payload) == INT16_MAX && getInt16LE(payload + 2) == INT16_MIN && getInt16LE(payload + 4) == 0);
+
+  // combined report without and with the buttons
+  memset(payload, 0xEE, sizeof(payload));
+  CHECK(packCombinedReport(payload, 1, -2, 3, -4, 5, -6, nullptr, 0) == HID_COMBINED_AXES_SIZE);
+  for (int a = 0; a < 6; a++) CHECK(getInt16LE(payload + 2 * a) == (a & 1 ? -(a + 1) : a + 1));
+  CHECK(payload[HID_COMBINED_AXES_SIZE] == 0xEE);
+  const uint8_t buttons[6] = { 0x03, 0x80, 0x11, 0x22, 0x33, 0x44 };
+  CHECK(packCombinedReport(payload, 0, 0, 0, 0, 0, 0, buttons, 2) == HID_COMBINED_AXES_SIZE + 2);
+  CHECK(payload[12] == 0x03 && payload[13] == 0x80);
+  // too many button bytes are cut at the maximum size of the report
+  memset(payload, 0xEE, sizeof(payload));
+  CHECK(packCombinedReport(payload, 0, 0, 0, 0, 0, 0, buttons, sizeof(buttons)) == HID_COMBINED_MAX_SIZE);
+  CHECK(payload[HID_COMBINED_MAX_SIZE - 1] == buttons[HID_COMBINED_MAX_SIZE - HID_COMBINED_AXES_SIZE - 1]);
+  CHECK(payload[HID_COMBINED_MAX_SIZE] == 0xEE);
+
+  // the sizes must match the descriptor of this build, ctest builds this test for every mode
+#if HID_COMBINED_REPORT > 0 && HID_COMBINED_BUTTONS > 0
+  CHECK(descriptorInputSize(1) == HID_COMBINED_AXES_SIZE + 2);  // two bytes of buttons
+  CHECK(descriptorInputSize(2) == 0);
+  CHECK(descriptorInputSize(3) == 0);
+#elif HID_COMBINED_REPORT > 0
+  CHECK(descriptorInputSize(1) == HID_COMBINED_AXES_SIZE);
+  CHECK(descriptorInputSize(2) == 0);
+  CHECK(descriptorInputSize(3) == 2);
+#else
+  CHECK(descriptorInputSize(1) == HID_AXES_REPORT_SIZE);
+  CHECK(descriptorInputSize(2) == HID_AXES_REPORT_SIZE);
+  CHECK(descriptorInputSize(3) == 2);
+#endif
+  printf("HID_COMBINED_REPORT %d, HID_COMBINED_BUTTONS %d, descriptor: report 1 %d bytes, report 2 %d bytes, report 3 %d bytes\n",
+         HID_COMBINED_REPORT, HID_COMBINED_BUTTONS, descriptorInputSize(1), descriptorInputSize(2), descriptorInputSize(3));
+  return checkResult("hid_report");
+}
@@ -0,0 +1,124 @@
+// Test of the HID transmit scheduler in hidScheduler.h with a mock endpoint in virtual time
+// The mock endpoint is busy for a while after every report, like the interrupt IN endpoint until the host has polled,
+// and can refuse reports. No report may get lost: the newest value of every id reaches the host.
+#include "config.h"
+#include "hidScheduler.h"
+#include "check.h"
+
+class MockEndpoint : public HidEndpoint {
+public:
+  bool ready() override {
+    return online && (int32_t)(nowUs - busyUntilUs) >= 0;
+  }
+
+  bool send(uint8_t id, const uint8_t* data, size_t len) override {
+    if (refuse > 0) {
+      refuse--;
+      return false;
+    }
+    lastId = id;
+    lastLen = len;
+    memcpy(lastData, data, len);
+    received[id]++;
+    count++;
+    busyUntilUs = nowUs + pollUs;
+    return true;
+  }
+
+  uint32_t nowUs = 0;
+  uint32_t busyUntilUs = 0;
+  uint32_t pollUs = 1000;  // the host polls every 1 ms
+  bool online = true;
+  int refuse = 0;          // number of reports to refuse
+  uint8_t lastId = 0;
+  size_t lastLen = 0;
+  uint8_t lastData[HID_SCHEDULER_MAX_REPORT];
+  int received[256] = {};
+  int count = 0;
+};
+
+static int sentCallbacks = 0;
+static void onSent(uint8_t, uint32_t) {
+  sentCallbacks++;
+}
+
+int main() {
+  static MockEndpoint endpoint;
+  HidScheduler scheduler(endpoint, 2000, HID_MAX_AGE_US);
+  scheduler.onSent = onSent;
+  uint8_t data[4] = { 1, 2, 3, 4 };
+
+  // the first report goes out at once, the next one waits for the minimum interval
+  CHECK(scheduler.post(1, data, 4, 0));
+  CHECK(scheduler.service(0));
+  CHECK(endpoint.lastId == 1 && endpoint.lastLen == 4);
+  CHECK(scheduler.post(2, data, 4, 100));
+  endpoint.nowUs = 1500;
+  CHECK(!scheduler.service(1500));  // the endpoint is free, but the interval hasn't passed
+  endpoint.nowUs = 2000;
+  CHECK(scheduler.service(2000));
+  CHECK(endpoint.lastId == 2);
+  CHECK(scheduler.idle());
+
+  // latest value wins, the oldest id goes first
+  data[0] = 10;
+  scheduler.post(1, data, 4, 2100);
+  data[0] = 20;
+  scheduler.post(3, data, 2, 2200);
+  data[0] = 11;
+  scheduler.post(1, data, 4, 2300);  // replaces the pending report 1 and is now newer than report 3
+  CHECK(scheduler.coalesced == 1);
+  CHECK(scheduler.pending() == 2);
+  endpoint.nowUs = 4000;
+  CHECK(scheduler.service(4000));
+  CHECK(endpoint.lastId == 3 && endpoint.lastData[0] == 20);
+  endpoint.nowUs = 6000;
+  CHECK(scheduler.service(6000));
+  CHECK(endpoint.lastId == 1 && endpoint.lastData[0] == 11);
+  CHECK(endpoint.received[1] == 2);
+
+  // a refused report stays pending and is sent on the next call
+  data[0] = 30;
+  scheduler.post(2, data, 4, 7000);
+  endpoint.nowUs = 8000;
+  endpoint.refuse = 1;
+  CHECK(!scheduler.service(8000));
+  CHECK(scheduler.pending() == 1);
+  CHECK(scheduler.service(8000));
+  CHECK(endpoint.lastId == 2 && endpoint.lastData[0] == 30);
+
+  // the host is suspended for a second: the last state of every id is kept, not dropped, and counted as stale
+  endpoint.online = false;
+  for (uint32_t t = 10000; t < 1010000; t += 1000) {
+    data[0] = t / 1000;
+    scheduler.post(1, data, 4, t);
+    endpoint.nowUs = t;
+    CHECK(!scheduler.service(t));
+  }
+  data[0] = 0;
+  scheduler.post(3, data, 2, 20000);  // the release of a button early in the suspend
+  endpoint.online = true;
+  for (uint32_t t = 1010000; t < 1020000; t += 1000) {
+    endpoint.nowUs = t;
+    scheduler.service(t);
+  }
+  CHECK(scheduler.idle());
+  CHECK(endpoint.received[3] == 2 && endpoint.lastData[0] != 0);
+  CHECK(scheduler.stale == 1);  // only the button report, report 1 was refreshed until the end
+  CHECK(scheduler.dropped == 0);
+
+  // too long reports and more ids than slots are dropped
+  uint8_t tooLong[HID_SCHEDULER_MAX_REPORT + 1] = {};
+  CHECK(!scheduler.post(1, tooLong, sizeof(tooLong), 1030000));
+  for (uint8_t id = 4; id < 4 + HID_SCHEDULER_SLOTS - 3; id++) CHECK(scheduler.post(id, data, 1, 1030000));
+  CHECK(!scheduler.post(100, data, 1, 1030000));
+  CHECK(scheduler.dropped == 2);
+
+  CHECK(sentCallbacks == (int)scheduler.sent);
+  CHECK(endpoint.count == (int)scheduler.sent);
+  printf("sent %lu, coalesced %lu, stale %lu, latency mean %lu us, max %lu us\n", (unsigned long)scheduler.sent,
+         (unsigned long)scheduler.coalesced, (unsigned long)scheduler.stale, (unsigned long)scheduler.latencyMeanUs(),
+         (unsigned long)scheduler.latencyMaxUs);
+  CHECK(scheduler.latencyMaxUs >= 990000);
+  return checkResult("hid_scheduler");
+}
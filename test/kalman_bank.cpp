@@ -0,0 +1,100 @@
+// Test of the fixed point Kalman filters in kalmanBank.h against a float reference of the SimpleKalmanFilter
+// Exact mode: the output must match the truncated output of the float filter within +/-1 count.
+// Steady-state mode: the gain must freeze on a resting knob and the frozen filter must still follow a motion. The gain
+// only converges on a quiet sensor, with a noise of +/-8 counts and more it moves by more than KALMAN_SS_EPSILON.
+#include <Arduino.h>
+#include "config.h"
+#include "kalmanBank.h"
+#include "check.h"
+#include "floatKalman.h"
+#include <stdlib.h>
+
+#define CENTER (1400 * SENSOR_SCALE)  // oversampled sensor at rest
+#define NOISE 32                      // +/- counts of noise
+#define QUIET_NOISE 4                 // +/- counts of noise of a quiet sensor
+
+/// @brief Resting knob with noise, steps and ramps of the single channels, like the sketch sees them
+static void testFrame(uint32_t& seed, int n, uint16_t* values) {
+  for (int i = 0; i < KALMAN_CHANNELS; i++) {
+    seed = seed * 1103515245 + 12345;
+    int value = CENTER + (int)((seed >> 16) % (2 * NOISE + 1)) - NOISE;
+    int phase = (n + i * 1500) % 12000;
+    if (phase >= 4000 && phase < 6000) value += 2000 * (i % 2 ? 1 : -1);  // step
+    if (phase >= 8000 && phase < 10000) value += (phase - 8000) * (i + 1) / 4;  // ramp
+    values[i] = (uint16_t)constrain(value, 0, 16383);
+  }
+}
+
+static int compareExact(int frames) {
+  FloatKalman reference[KALMAN_CHANNELS] = {
+    { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 },
+    { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }, { 5.0, 2.0, 0.01 }
+  };
+  static KalmanBank bank;
+  bank.init(5.0, 2.0, 0.01, false);
+  uint16_t values[KALMAN_CHANNELS];
+  int out[KALMAN_CHANNELS];
+  uint32_t seed = 7;
+  int maxDeviation = 0;
+  for (int n = 0; n < frames; n++) {
+    testFrame(seed, n, values);
+    bank.update(values, out);
+    for (int i = 0; i < KALMAN_CHANNELS; i++) {
+      int expected = (int)reference[i].updateEstimate(values[i]);  // the sketch truncates the float filter
+      maxDeviation = max(maxDeviation, abs(out[i] - expected));
+    }
+  }
+  CHECK(!bank.isSteady());
+  return maxDeviation;
+}
+
+static void testSteadyState() {
+  static KalmanBank bank;
+  bank.init(5.0, 2.0, 0.01, true);
+  uint16_t values[KALMAN_CHANNELS];
+  int out[KALMAN_CHANNELS];
+  uint32_t seed = 11;
+
+  // noisy sensors: the gain keeps moving and is never frozen
+  for (int n = 0; n < 20 * KALMAN_SS_SAMPLES; n++) {
+    for (int i = 0; i < KALMAN_CHANNELS; i++) {
+      seed = seed * 1103515245 + 12345;
+      values[i] = CENTER + (int)((seed >> 16) % (2 * NOISE + 1)) - NOISE;
+    }
+    bank.update(values, out);
+  }
+  CHECK(!bank.isSteady());
+
+  // quiet sensors on a resting knob: all gains freeze and the output stays within the noise
+  bank.init(5.0, 2.0, 0.01, true);
+  int frozenAfter = -1;
+  for (int n = 0; n < 20 * KALMAN_SS_SAMPLES && frozenAfter < 0; n++) {
+    for (int i = 0; i < KALMAN_CHANNELS; i++) {
+      seed = seed * 1103515245 + 12345;
+      values[i] = CENTER + (int)((seed >> 16) % (2 * QUIET_NOISE + 1)) - QUIET_NOISE;
+    }
+    bank.update(values, out);
+    if (bank.isSteady()) frozenAfter = n + 1;
+  }
+  printf("steady state after %d updates\n", frozenAfter);
+  CHECK(frozenAfter >= KALMAN_SS_SAMPLES);
+  for (int n = 0; n < 1000; n++) {
+    bank.update(values, out);
+    for (int i = 0; i < KALMAN_CHANNELS; i++) CHECK(abs(out[i] - CENTER) <= QUIET_NOISE);
+  }
+
+  // a step after the freeze: the gain is at least KALMAN_SS_MIN_GAIN, so the output settles within a few hundred updates
+  int settle = (int)ceil(log(0.5 / 2000) / log(1.0 - KALMAN_SS_MIN_GAIN));
+  for (int i = 0; i < KALMAN_CHANNELS; i++) values[i] = CENTER + 2000;
+  for (int n = 0; n < settle; n++) bank.update(values, out);
+  for (int i = 0; i < KALMAN_CHANNELS; i++) CHECK(abs(out[i] - (CENTER + 2000)) <= 1);
+  CHECK(bank.isSteady());
+}
+
+int main() {
+  int maxDeviation = compareExact(48000);
+  printf("exact mode: max. deviation %d counts\n", maxDeviation);
+  CHECK(maxDeviation <= 1);
+  testSteadyState();
+  return checkResult("kalman_bank");
+}
@@ -0,0 +1,73 @@
+// Test of the least squares fit of the decoupling matrix in kinematicFit.h
+// The samples are generated with a known matrix, the fit must find it again. Without enough samples, the ridge
+// regularization must keep the matrix at the prior.
+#include "config.h"
+#include "kinematicFit.h"
+#include "check.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const int16_t prior[6][8] = KINEMATIC_MATRIX_VALUES;
+
+/// @brief The velocities of a sensor frame with a matrix in Q12
+static void velocities(const int16_t matrix[6][8], const int* x, float* y) {
+  for (int a = 0; a < 6; a++) {
+    double sum = 0;
+    for (int i = 0; i < 8; i++) sum += matrix[a][i] * (double)x[i];
+    y[a] = sum / 4096.0;
+  }
+}
+
+static int maxDifference(const int16_t a[6][8], const int16_t b[6][8]) {
+  int d = 0;
+  for (int axis = 0; axis < 6; axis++) {
+    for (int i = 0; i < 8; i++) {
+      if (abs(a[axis][i] - b[axis][i]) > d) d = abs(a[axis][i] - b[axis][i]);
+    }
+  }
+  return d;
+}
+
+int main() {
+  static KinematicFit fit;
+  int16_t out[6][8];
+  fit.reset();
+  CHECK(!fit.solve(prior, KINEMATIC_FIT_RIDGE, out));  // no samples
+
+  // a coupled matrix: the prior plus some crosstalk between the sensors
+  int16_t truth[6][8];
+  uint32_t seed = 7;
+  for (int a = 0; a < 6; a++) {
+    for (int i = 0; i < 8; i++) {
+      seed = seed * 1103515245 + 12345;
+      truth[a][i] = prior[a][i] + (int)((seed >> 16) % 801) - 400;
+    }
+  }
+
+  // random frames like the movements of the guided calibration
+  int x[8];
+  float y[6];
+  for (int n = 0; n < 2000; n++) {
+    for (int i = 0; i < 8; i++) {
+      seed = seed * 1103515245 + 12345;
+      x[i] = (int)((seed >> 16) % 2001) - 1000;
+    }
+    velocities(truth, x, y);
+    fit.addSample(x, y);
+  }
+  CHECK(fit.samples == 2000);
+  CHECK(fit.solve(prior, 1e-6, out));
+  printf("fit with 2000 samples: max. difference %d (Q12)\n", maxDifference(out, truth));
+  CHECK(maxDifference(out, truth) <= 2);
+
+  // a single movement can't determine the matrix, the regularization keeps the other entries at the prior
+  fit.reset();
+  memset(x, 0, sizeof(x));
+  x[0] = 500;
+  velocities(prior, x, y);
+  for (int n = 0; n < 100; n++) fit.addSample(x, y);
+  CHECK(fit.solve(prior, KINEMATIC_FIT_RIDGE, out));
+  printf("fit with one movement: max. difference to the prior %d (Q12)\n", maxDifference(out, prior));
+  CHECK(maxDifference(out, prior) <= 1);
+  return checkResult("kinematic_fit");
+}
@@ -0,0 +1,44 @@
+// Test of the echo of the latency probes in latencyProbe.h
+// The host writes the probe as "<BI" (report id, probe id) and unpacks the feature report with struct "<6IB" in
+// tools/latency_probe.py: six little endian uint32 and one uint8, 25 bytes without padding.
+#include "latencyProbe.h"
+#include "check.h"
+#include <string.h>
+
+/// @brief Unpack a little endian uint32 like struct.unpack("<I")
+static uint32_t getUint32LE(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int main() {
+  CHECK(LATENCY_ECHO_SIZE == 6 * 4 + 1);  // struct.calcsize("<6IB")
+  LatencyProbe probe;
+
+  // the probe id as written by the host, after the report id
+  const uint8_t output[4] = { 0x78, 0x56, 0x34, 0x12 };
+  probe.probe(output, sizeof(output), 1000);
+  probe.loopStart(0x0A0B0C0D);
+  probe.motionPosted();
+  probe.loopStart(2222);  // a newer frame, which was not posted
+  probe.motionSent(0xFFFFFFF0);
+
+  uint8_t echo[LATENCY_ECHO_SIZE + 4];
+  memset(echo, 0xEE, sizeof(echo));
+  CHECK(probe.echo(echo, sizeof(echo), 0x80000001, 3) == LATENCY_ECHO_SIZE);
+  CHECK(getUint32LE(echo + 0) == 0x12345678);   // probe id
+  CHECK(getUint32LE(echo + 4) == 1000);         // probe us
+  CHECK(getUint32LE(echo + 8) == 0x80000001);   // echo us
+  CHECK(getUint32LE(echo + 12) == 0x0A0B0C0D);  // frame us of the posted motion report
+  CHECK(getUint32LE(echo + 16) == 0xFFFFFFF0);  // sent us
+  CHECK(getUint32LE(echo + 20) == 2);           // loop sequence
+  CHECK(echo[24] == 3);                         // queue depth
+  CHECK(echo[LATENCY_ECHO_SIZE] == 0xEE);       // nothing written beyond the report
+
+  // too short buffers and probes are refused
+  CHECK(probe.echo(echo, LATENCY_ECHO_SIZE - 1, 0, 0) == 0);
+  const uint8_t shortProbe[3] = { 1, 2, 3 };
+  probe.probe(shortProbe, sizeof(shortProbe), 5000);
+  probe.echo(echo, sizeof(echo), 0, 0);
+  CHECK(getUint32LE(echo) == 0x12345678 && getUint32LE(echo + 4) == 1000);
+  return checkResult("latency_probe");
+}
@@ -0,0 +1,41 @@
+// Test of the lookup tables of the modifier curves in modifierLut.h
+// The tables of the curves 0 ... 4 must be bit-exact with the calculation in double precision, which was used before the
+// tables (modifierFunctionReference() in kinematics.h), for every input including the clamped ones beyond +-350.
+// The user defined curves 5 and 6 have no reference, they must be odd, monotonic and end at 0 and +-350.
+#include <Arduino.h>
+#include "config.h"
+#include "kinematics.h"
+#include "check.h"
+
+int main() {
+  uint8_t savedModFunc = modFunc;
+  for (uint8_t f = 0; f <= 4; f++) {
+    modFunc = f;
+    int mismatches = 0;
+    for (int x = -400; x <= 400; x++) {
+      int reference = modifierFunctionReference(x);
+      if (modifierFunction(x) != reference) mismatches++;
+      // TRANSZ: the negative half follows the curve, the positive half is linear
+      if (modifierTransZ(x) != (x < 0 ? reference : constrain(x, 0, 350))) mismatches++;
+      // the Q16.16 interpolation of the fixed point pipeline hits the table at the integer inputs
+      if (getModifierCurve(f, false).applyQ16(x * 65536) != modifierFunction(x) * 65536) mismatches++;
+    }
+    printf("modFunc %d: %d mismatches\n", f, mismatches);
+    CHECK(mismatches == 0);
+  }
+
+  for (uint8_t f = 5; f < NUM_MODIFIER_CURVES; f++) {
+    ModifierCurve curve = getModifierCurve(f, false);
+    CHECK(curve.apply(0) == 0 && curve.apply(350) == 350 && curve.apply(-350) == -350);
+    for (int x = 1; x <= 350; x++) {
+      CHECK(curve.apply(-x) == -curve.apply(x));
+      CHECK(curve.apply(x) >= curve.apply(x - 1));
+    }
+  }
+
+  // unknown curves fall back to linear
+  modFunc = NUM_MODIFIER_CURVES;
+  for (int x = -350; x <= 350; x++) CHECK(modifierFunction(x) == x);
+  modFunc = savedModFunc;
+  return checkResult("modifier_lut");
+}
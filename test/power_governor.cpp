@@ -0,0 +1,157 @@
+// Test of the power governor in powerGovernor.h together with the acquisition engine in adcEngine.h in virtual time
+// The ADC converts continuously at ADC_SAMPLE_RATE_HZ, but its driver only buffers a few scans. In the idle state, the
+// scans are only fetched every POWER_IDLE_SCAN_US. The knob is moved at a random time and the governor must be active
+// again within about one idle scan, with the wake latency measured from the first scan, which showed the motion.
+#include "config.h"
+#include "adcEngine.h"
+#include "powerGovernor.h"
+#include "check.h"
+#include <stdlib.h>
+
+#define SCAN_US (1000000 / ADC_SAMPLE_RATE_HZ)
+#define CENTER 2000      // ADC value of the sensor at rest
+#define MOVED 3000       // ADC value of the sensor, while the knob is moved, a single scan of an idle frame shows it
+#define MOTION_LEVEL 50  // difference to the center in units of the oversampled sensors, which counts as motion
+
+/// @brief Continuous ADC, whose driver keeps only the newest scans between two fetches
+class SimulatedAdc : public AdcEngine {
+public:
+  explicit SimulatedAdc(int driverScans)
+    : driverScans(driverScans) {}
+
+  /// @brief The ADC has finished a scan of all channels
+  void convert(uint16_t value, uint32_t nowUs) {
+    buffer[head % MAX_SCANS] = { value, nowUs };
+    head++;
+    if (head - tail > (uint32_t)driverScans) tail = head - driverScans;  // the driver overwrites the oldest scan
+  }
+
+  void service() override {
+    for (; tail != head; tail++) {
+      const Scan& scan = buffer[tail % MAX_SCANS];
+      uint16_t values[ADC_CHANNELS];
+      for (int i = 0; i < ADC_CHANNELS; i++) values[i] = scan.value;
+      pushScan(values, scan.timeUs);
+    }
+  }
+
+private:
+  static const int MAX_SCANS = 128;
+  struct Scan {
+    uint16_t value;
+    uint32_t timeUs;
+  };
+  Scan buffer[MAX_SCANS];
+  uint32_t head = 0;
+  uint32_t tail = 0;
+  int driverScans;
+};
+
+// sample period, loop delay, partial frames, CPU, display delay, display on, LED brightness
+static const PowerProfile profiles[] = {
+  { SCAN_US, 0, false, 240, 50, true, 200 },                  // active
+  { POWER_IDLE_SCAN_US, 1, true, 80, 500, true, 40 },         // idle
+  { POWER_SUSPENDED_SCAN_US, 1, true, 80, 500, false, 0 },    // suspended
+};
+
+struct WakeResult {
+  bool woke;               // the governor became active again within the simulated time
+  uint32_t wakeUs;         // from the start of the motion until the governor is active again
+  uint32_t measuredUs;     // wake latency measured by the governor
+  uint32_t frames;         // frames, which were fetched in the idle state
+};
+
+/// @brief Let the knob rest until the governor is idle, then move it at motionUs after the start of the idle state
+static WakeResult simulateWake(int driverScans, bool partialFrames, uint32_t motionUs) {
+  SimulatedAdc adc(driverScans);
+  PowerGovernor governor(profiles, POWER_IDLE_MS);
+  WakeResult result = {};
+  AdcFrame frame = {};
+  uint32_t nextFetchUs = 0;
+  uint32_t idleSinceUs = 0;
+  bool moved = false;
+  uint32_t motionStartUs = 0;
+  for (uint32_t nowUs = SCAN_US; nowUs < POWER_IDLE_MS * 1000 + 5000000; nowUs += SCAN_US) {
+    bool idle = governor.state() == POWER_IDLE;
+    bool moving = idle && nowUs - idleSinceUs >= motionUs;
+    if (moving && !moved) {
+      moved = true;
+      motionStartUs = nowUs;
+    }
+    adc.convert(moving ? MOVED : CENTER, nowUs);
+    if ((int32_t)(nowUs - nextFetchUs) < 0) continue;
+
+    // the sampling task and the loop() at the period of the profile
+    nextFetchUs = nowUs + governor.profile().samplePeriodUs;
+    adc.partialFrames = partialFrames && governor.profile().partialFrames;
+    adc.service();
+    if (adc.partialFrames) adc.flushScans();
+    if (adc.latest(frame) && idle) result.frames++;
+    bool motion = abs(frame.values[0] - CENTER * SENSOR_SCALE) >= MOTION_LEVEL;
+    if (governor.update(nowUs, frame.firstScanUs, motion, false)) {
+      if (governor.state() == POWER_IDLE) {
+        idleSinceUs = nowUs;
+      } else if (moved) {
+        result.woke = true;
+        result.wakeUs = nowUs - motionStartUs;
+        result.measuredUs = governor.lastWakeUs;
+        return result;
+      }
+    }
+  }
+  return result;
+}
+
+static void testStates() {
+  PowerGovernor governor(profiles, POWER_IDLE_MS);
+  CHECK(governor.state() == POWER_ACTIVE);
+  CHECK(!governor.update(1000, 0, true, false));
+  CHECK(!governor.update(1000 + POWER_IDLE_MS * 1000 - 1, 0, false, false));
+  CHECK(governor.update(1000 + POWER_IDLE_MS * 1000, 0, false, false) && governor.state() == POWER_IDLE);
+  CHECK(governor.profile().samplePeriodUs == POWER_IDLE_SCAN_US && governor.profile().partialFrames);
+
+  // the host suspends the USB: no motion wakes the device, until the host resumes
+  CHECK(governor.update(10000000, 0, false, true) && governor.state() == POWER_SUSPENDED);
+  CHECK(!governor.update(10100000, 10090000, true, true));
+  CHECK(governor.update(10200000, 0, false, false) && governor.state() == POWER_ACTIVE);
+  CHECK(governor.wakes == 0);  // a resume is no wake by motion
+  CHECK(!governor.update(10200000 + POWER_IDLE_MS * 1000 - 1, 0, false, false));  // the resume counts as motion
+
+  // a wake is measured from the first scan of the frame with motion
+  CHECK(governor.update(10200000 + POWER_IDLE_MS * 1000, 0, false, false) && governor.state() == POWER_IDLE);
+  CHECK(governor.update(20000000, 19985000, true, false) && governor.state() == POWER_ACTIVE);
+  CHECK(governor.wakes == 1 && governor.lastWakeUs == 15000 && governor.meanWakeUs() == 15000);
+  CHECK(governor.transitions == 5);
+}
+
+int main() {
+  testStates();
+
+  // the driver keeps only one scan between two fetches, so a complete frame needs OVERSAMPLING_RATIO idle scans
+  WakeResult decimated = simulateWake(1, false, 1000000);
+  printf("decimated frames: %lu idle frames, wake after %lu us\n", (unsigned long)decimated.frames,
+         (unsigned long)decimated.wakeUs);
+  CHECK(decimated.woke && decimated.wakeUs > 4 * POWER_IDLE_SCAN_US);
+
+  // with partial frames, every idle scan gives a frame and the first one with motion wakes the governor
+  uint32_t seed = 3;
+  uint32_t maxWakeUs = 0;
+  const int driverScanList[] = { 1, 4, 16, POWER_IDLE_SCAN_US / SCAN_US };
+  for (int driverScans : driverScanList) {
+    for (int n = 0; n < 50; n++) {
+      seed = seed * 1103515245 + 12345;
+      uint32_t motionUs = 100000 + (seed >> 8) % 1000000;
+      WakeResult result = simulateWake(driverScans, true, motionUs);
+      CHECK(result.woke && result.wakeUs < POWER_IDLE_SCAN_US);
+      // the frame with motion starts with the oldest scan, which the driver kept
+      uint32_t keptUs = driverScans * SCAN_US;
+      bool keepsAll = keptUs >= POWER_IDLE_SCAN_US;
+      CHECK(result.measuredUs < (keepsAll ? POWER_IDLE_SCAN_US : keptUs));
+      if (keepsAll) CHECK(result.measuredUs >= result.wakeUs);  // the first scan with motion is in the frame
+      if (result.wakeUs > maxWakeUs) maxWakeUs = result.wakeUs;
+    }
+  }
+  printf("partial frames: wake after at most %lu us, idle scan %lu us\n", (unsigned long)maxWakeUs,
+         (unsigned long)POWER_IDLE_SCAN_US);
+  return checkResult("power_governor");
+}
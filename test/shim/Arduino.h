@@ -0,0 +1,173 @@
+// Minimal replacement of the Arduino core for the host build of the tests and benchmarks, see CMakeLists.txt
+// It provides only what the tested parts of the sketch use: the time, the analog and digital pins, map(), constrain()
+// and a serial interface, which collects the output in a string and reads the input from a string.
+// The time does not run by itself, the tests advance it with delay() or by setting shimMicros.
+#ifndef ARDUINO_SHIM_H
+#define ARDUINO_SHIM_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define F(s) s
+#define ARDUINO_ISR_ATTR
+
+using std::abs;
+using std::max;
+using std::min;
+
+// SECTION TIME
+inline uint32_t shimMicros = 0;  // virtual time in us
+
+inline unsigned long micros() {
+  return shimMicros;
+}
+
+inline unsigned long millis() {
+  return shimMicros / 1000;
+}
+
+inline void delay(unsigned long ms) {
+  shimMicros += ms * 1000;
+}
+
+inline void delayMicroseconds(unsigned int us) {
+  shimMicros += us;
+}
+// !SECTION TIME
+
+// SECTION PINS
+#define SHIM_PINS 64
+inline int shimAnalog[SHIM_PINS] = {};   // value returned by analogRead() for each pin
+inline int shimDigital[SHIM_PINS] = {};  // value returned by digitalRead() for each pin
+
+inline int analogRead(uint8_t pin) {
+  return pin < SHIM_PINS ? shimAnalog[pin] : 0;
+}
+
+inline int digitalRead(uint8_t pin) {
+  return pin < SHIM_PINS ? shimDigital[pin] : HIGH;
+}
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < SHIM_PINS && mode == INPUT_PULLUP) shimDigital[pin] = HIGH;
+}
+// !SECTION PINS
+
+// SECTION MATH
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+// !SECTION MATH
+
+// SECTION SERIAL
+class Stream {
+public:
+  size_t write(uint8_t c) {
+    output += (char)c;
+    return 1;
+  }
+
+  size_t write(const uint8_t* data, size_t len) {
+    output.append((const char*)data, len);
+    return len;
+  }
+
+  size_t printf(const char* format, ...) {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (len < 0) return 0;
+    if (len >= (int)sizeof(buffer)) len = sizeof(buffer) - 1;
+    output.append(buffer, len);
+    return len;
+  }
+
+  size_t print(const char* s) {
+    output += s;
+    return strlen(s);
+  }
+
+  size_t print(char c) {
+    return write((uint8_t)c);
+  }
+
+  size_t print(long v) {
+    return printf("%ld", v);
+  }
+
+  size_t print(int v) {
+    return printf("%d", v);
+  }
+
+  size_t print(unsigned long v) {
+    return printf("%lu", v);
+  }
+
+  size_t print(unsigned int v) {
+    return printf("%u", v);
+  }
+
+  size_t print(double v, int digits = 2) {
+    return printf("%.*f", digits, v);
+  }
+
+  template<typename T>
+  size_t println(T v) {
+    size_t n = print(v);
+    return n + print("\r\n");
+  }
+
+  size_t println() {
+    return print("\r\n");
+  }
+
+  int available() {
+    return input.size() - inputPos;
+  }
+
+  int read() {
+    return inputPos < input.size() ? (uint8_t)input[inputPos++] : -1;
+  }
+
+  int peek() {
+    return inputPos < input.size() ? (uint8_t)input[inputPos] : -1;
+  }
+
+  int availableForWrite() {
+    return writeSpace;
+  }
+
+  void begin(unsigned long) {}
+  void flush() {}
+
+  std::string output;     // everything written so far
+  std::string input;      // bytes to be read
+  size_t inputPos = 0;    // next byte of input to be read
+  int writeSpace = 4096;  // reported by availableForWrite()
+};
+
+inline Stream Serial;
+
+#ifndef SERIAL
+#define SERIAL Serial
+#endif
+// !SECTION SERIAL
+#endif
@@ -0,0 +1,119 @@
+// Stress test of the SpscQueue and the SeqLock in spscQueue.h with a producer and a consumer thread
+// The producer pushes numbered frames as fast as it can, the consumer checks that no frame is torn, reordered or duplicated,
+// and that every frame, which was not delivered, has been counted as overrun.
+#include "spscQueue.h"
+#include "check.h"
+#include <thread>
+
+#define FRAMES 1000000
+
+struct Frame {
+  uint32_t seq;
+  int values[8];  // all equal seq * (i + 1), so a torn frame is detected
+};
+
+/// @brief Producer and consumer run at full speed
+/// @param retry true: the producer repeats a push, until the queue takes it, so every frame must arrive in order
+static void testQueue(bool retry) {
+  static SpscQueue<Frame, 16> retryQueue;
+  static SpscQueue<Frame, 16> lossyQueue;
+  SpscQueue<Frame, 16>& queue = retry ? retryQueue : lossyQueue;
+  uint32_t pushed = 0;
+  std::atomic<bool> done{ false };
+  std::thread producer([&]() {
+    Frame frame;
+    for (uint32_t n = 1; n <= FRAMES; n++) {
+      frame.seq = n;
+      for (int i = 0; i < 8; i++) frame.values[i] = n * (i + 1);
+      if (retry) {
+        while (!queue.push(frame)) {
+          std::this_thread::yield();  // also on a single core
+        }
+        pushed++;
+      } else if (queue.push(frame)) {
+        pushed++;
+      }
+    }
+    done = true;
+  });
+
+  uint32_t received = 0;
+  uint32_t lastSeq = 0;
+  int torn = 0;
+  int reordered = 0;
+  int gaps = 0;
+  Frame frame;
+  while (!done || queue.size() > 0) {
+    if (!queue.pop(frame)) {
+      std::this_thread::yield();
+      continue;
+    }
+    received++;
+    if (frame.seq <= lastSeq) reordered++;
+    if (frame.seq != lastSeq + 1) gaps++;
+    lastSeq = frame.seq;
+    for (int i = 0; i < 8; i++) {
+      if (frame.values[i] != (int)(frame.seq * (i + 1))) torn++;
+    }
+  }
+  producer.join();
+
+  printf("queue %s: %u frames received, %u overruns\n", retry ? "with retry" : "lossy", received, queue.overruns());
+  CHECK(torn == 0);
+  CHECK(reordered == 0);
+  CHECK(received == pushed);
+  if (retry) {
+    CHECK(received == FRAMES);
+    CHECK(gaps == 0);
+  } else {
+    CHECK(received + queue.overruns() == FRAMES);
+  }
+}
+
+static void testSeqLock() {
+  static SeqLock<Frame> lock;
+  std::atomic<bool> done{ false };
+  std::thread writer([&]() {
+    Frame frame;
+    for (uint32_t n = 1; n <= FRAMES; n++) {
+      frame.seq = n;
+      for (int i = 0; i < 8; i++) frame.values[i] = n * (i + 1);
+      lock.write(frame);
+    }
+    done = true;
+  });
+
+  int torn = 0;
+  int backwards = 0;
+  uint32_t reads = 0;
+  uint32_t lastSeq = 0;
+  uint32_t lastVersion = 0;
+  Frame frame;
+  while (!done) {
+    uint32_t version = lock.read(frame);
+    reads++;
+    if (version & 1) torn++;
+    if (frame.seq < lastSeq || version < lastVersion) backwards++;
+    lastSeq = frame.seq;
+    lastVersion = version;
+    for (int i = 0; i < 8; i++) {
+      if (frame.values[i] != (int)(frame.seq * (i + 1))) torn++;
+    }
+  }
+  writer.join();
+
+  uint32_t version = lock.read(frame);
+  printf("seqlock: %u reads\n", reads);
+  CHECK(torn == 0);
+  CHECK(backwards == 0);
+  CHECK(frame.seq == FRAMES);
+  CHECK(version == 2 * FRAMES);
+  CHECK(lock.version() == version);
+}
+
+int main() {
+  testQueue(true);
+  testQueue(false);
+  testSeqLock();
+  return checkResult("spsc_stress");
+}
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Export, import and show the calibration of the spacemouse.
+
+The calibration store is described in calibStore.h. Typical use to clone a calibration:
+    calibration_tool.py export --port /dev/ttyACM0 unit1.bin
+    calibration_tool.py import --port /dev/ttyACM1 unit1.bin
+    calibration_tool.py show unit1.bin
+Export and import need pyserial.
+"""
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = b"SMCB"
+HEADER = struct.Struct("<4sHH")
+PAYLOAD_V1 = struct.Struct("<8h8h8i7f4hBBBB")
+PAYLOAD_V2 = struct.Struct("<8h8h8i7f4hBBBB48h")
+PAYLOADS = {1: PAYLOAD_V1, 2: PAYLOAD_V2}
+FLAG_MATRIX = 0x02
+SENSITIVITY_NAMES = ["TRANSX_SENSITIVITY", "TRANSY_SENSITIVITY", "POS_TRANSZ_SENSITIVITY", "NEG_TRANSZ_SENSITIVITY",
+                     "ROTX_SENSITIVITY", "ROTY_SENSITIVITY", "ROTZ_SENSITIVITY"]
+GATE_NAMES = ["GATE_NEG_TRANSZ", "GATE_ROTX", "GATE_ROTY", "GATE_ROTZ"]
+
+
+def find_blob(data):
+    """Return the blob contained in data, which may be surrounded by text of the serial interface."""
+    start = data.find(MAGIC)
+    if start < 0 or len(data) < start + HEADER.size:
+        raise ValueError("no calibration blob found")
+    _, version, size = HEADER.unpack_from(data, start)
+    end = start + HEADER.size + size
+    if len(data) < end + 4:
+        raise ValueError("calibration blob is truncated")
+    (crc,) = struct.unpack_from("<I", data, end)
+    if zlib.crc32(data[start:end]) != crc:
+        raise ValueError("CRC mismatch, the calibration blob is corrupted")
+    if version not in PAYLOADS or size != PAYLOADS[version].size:
+        raise ValueError("unsupported calibration version %d" % version)
+    return data[start:end + 4]
+
+
+def show(blob):
+    _, version, _ = HEADER.unpack_from(blob, 0)
+    v = PAYLOADS[version].unpack_from(blob, HEADER.size)
+    min_vals, max_vals, center = v[0:8], v[8:16], v[16:24]
+    sens, gates = v[24:31], v[31:35]
+    mod_func, invert_mask, resolution, flags = v[35:39]
+    print("#define MINVALS { %s }" % ", ".join(map(str, min_vals)))
+    print("#define MAXVALS { %s }" % ", ".join(map(str, max_vals)))
+    print("#define INVERTLIST { %s }" % ", ".join(str((invert_mask >> i) & 1) for i in range(8)))
+    for name, value in zip(SENSITIVITY_NAMES, sens):
+        print("#define %s %g" % (name, value))
+    for name, value in zip(GATE_NAMES, gates):
+        print("#define %s %d" % (name, value))
+    print("#define MODFUNC %d" % mod_func)
+    state = "valid" if flags & 1 else "not stored"
+    print("// center points (%d bit, %s): %s" % (resolution, state, ", ".join(map(str, center))))
+    if version >= 2 and flags & FLAG_MATRIX:
+        rows = [v[39 + 8 * a:47 + 8 * a] for a in range(6)]
+        print("#define KINEMATIC_MATRIX_VALUES \\")
+        for a, row in enumerate(rows):
+            print("%s%s%s" % ("  { { " if a == 0 else "    { ", ", ".join(map(str, row)), " } }" if a == 5 else " }, \\"))
+
+
+def export_blob(port):
+    import serial  # pyserial
+
+    with serial.Serial(port, timeout=1) as ser:
+        ser.reset_input_buffer()
+        ser.write(b"40\n")
+        data = b""
+        deadline = time.time() + 3
+        while time.time() < deadline:
+            data += ser.read(256)
+            try:
+                return find_blob(data)
+            except ValueError:
+                pass
+    raise ValueError("no calibration received")
+
+
+def import_blob(port, blob):
+    import serial  # pyserial
+
+    with serial.Serial(port, timeout=6) as ser:
+        ser.reset_input_buffer()
+        ser.write(b"41\n")
+        ser.readline()  # "Send the calibration blob now."
+        ser.write(blob)
+        print(ser.readline().decode(errors="replace").strip())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("command", choices=["export", "import", "show"])
+    parser.add_argument("file", help="binary calibration file")
+    parser.add_argument("--port", help="serial port of the spacemouse")
+    args = parser.parse_args()
+
+    if args.command == "show":
+        with open(args.file, "rb") as f:
+            show(find_blob(f.read()))
+        return
+    if not args.port:
+        parser.error("--port is needed for %s" % args.command)
+    if args.command == "export":
+        blob = export_blob(args.port)
+        with open(args.file, "wb") as f:
+            f.write(blob)
+        show(blob)
+    else:
+        with open(args.file, "rb") as f:
+            import_blob(args.port, find_blob(f.read()))
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except ValueError as e:
+        sys.exit("error: %s" % e)
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Convert a flight recorder dump of the spacemouse into CSV.
+
+The dump is requested with debug mode 30, see flightRecorder.h for the binary format.
+Either decode a file, which was captured from the serial interface:
+    flightrecorder_decode.py dump.bin -o dump.csv
+or let the script request the dump itself (needs pyserial):
+    flightrecorder_decode.py --port /dev/ttyACM0 -o dump.csv
+"""
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b"SMFR"
+HEADER = struct.Struct("<4sBBHHBB8i")
+RECORD = struct.Struct("<I8H8h6hBB")
+REASONS = {0: "none", 1: "serial", 2: "keys", 3: "anomaly"}
+VELOCITY_NAMES = ["TX", "TY", "TZ", "RX", "RY", "RZ"]
+
+
+def decode(data):
+    """Find the dump in data and return (header dict, list of records)."""
+    start = data.find(MAGIC)
+    if start < 0:
+        raise ValueError("no flight recorder dump found")
+    magic, version, reason, record_size, count, resolution, _, *center = HEADER.unpack_from(data, start)
+    if version != 1 or record_size != RECORD.size:
+        raise ValueError("unsupported dump version %d / record size %d" % (version, record_size))
+    end = start + HEADER.size + count * RECORD.size
+    if len(data) < end + 4:
+        raise ValueError("dump is truncated")
+    (crc,) = struct.unpack_from("<I", data, end)
+    if zlib.crc32(data[start:end]) != crc:
+        raise ValueError("CRC mismatch, the dump is corrupted")
+    header = {"reason": REASONS.get(reason, str(reason)), "count": count, "resolution": resolution, "centerPoints": center}
+    records = [RECORD.unpack_from(data, start + HEADER.size + i * RECORD.size) for i in range(count)]
+    return header, records
+
+
+def write_csv(header, records, out):
+    out.write("# trigger: %s, sensor resolution: %d bit, centerPoints: %s\n"
+              % (header["reason"], header["resolution"], " ".join(str(c) for c in header["centerPoints"])))
+    columns = ["time_us"] + ["raw%d" % i for i in range(8)] + ["centered%d" % i for i in range(8)]
+    columns += VELOCITY_NAMES + ["keys", "trigger"]
+    out.write(",".join(columns) + "\n")
+    for r in records:
+        out.write(",".join(str(v) for v in r[:-1]) + ",%d\n" % (r[-1] & 1))
+
+
+def read_from_port(port):
+    import serial  # pyserial
+
+    with serial.Serial(port, timeout=2) as ser:
+        ser.reset_input_buffer()
+        ser.write(b"30\n")
+        data = b""
+        while True:
+            chunk = ser.read(4096)
+            if not chunk:
+                return data
+            data += chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", nargs="?", help="binary file captured from the serial interface")
+    parser.add_argument("--port", help="serial port of the spacemouse, to request the dump directly")
+    parser.add_argument("-o", "--output", help="CSV file (default: stdout)")
+    args = parser.parse_args()
+
+    if args.port:
+        data = read_from_port(args.port)
+    elif args.dump:
+        with open(args.dump, "rb") as f:
+            data = f.read()
+    else:
+        parser.error("either a dump file or --port is needed")
+
+    header, records = decode(data)
+    out = open(args.output, "w") if args.output else sys.stdout
+    write_csv(header, records, out)
+    if args.output:
+        out.close()
+        print("%d records written, trigger: %s" % (len(records), header["reason"]), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""Measure the latency of the spacemouse with the echo of the latency probe over hidraw (Linux).
+
+The reports are described in latencyProbe.h, enable LATENCY_PROBE in config.h. Typical use:
+    latency_probe.py                           (find the hidraw device of the spacemouse by VID and PID)
+    latency_probe.py --device /dev/hidraw3 --count 2000 --interval 0.005
+    latency_probe.py --mock                    (run against a simulated device, e.g. to test the tool)
+For every probe, the tool writes the probe id with the output report 5 and reads the echo with the feature report 5.
+It reports the distributions of
+    round trip:      writing the probe until receiving the echo, measured by the host
+    turnaround:      receiving the probe until the echo was requested, measured by the device
+    sample to send:  sensor frame behind the latest motion report until it was handed to the USB
+    queue depth:     pending reports in the hidScheduler
+The hidraw device must be readable and writable, e.g. with a udev rule or sudo.
+"""
+import argparse
+import glob
+import os
+import random
+import struct
+import sys
+import time
+
+USB_VID = 0x256F
+USB_PID = 0xC63A
+PROBE_ID = 5
+ECHO = struct.Struct("<6IB")  # probe id, probe us, echo us, frame us, sent us, loop sequence, queue depth
+
+
+def hidiocgfeature(length):
+    """ioctl request HIDIOCGFEATURE(length) of linux/hidraw.h"""
+    return (3 << 30) | (length << 16) | (ord("H") << 8) | 0x07
+
+
+def find_hidraw():
+    """Return the hidraw device of the spacemouse or None."""
+    hid_id = "HID_ID=0003:%08X:%08X" % (USB_VID, USB_PID)
+    for path in sorted(glob.glob("/sys/class/hidraw/hidraw*/device/uevent")):
+        with open(path) as f:
+            if hid_id in f.read().upper():
+                return "/dev/" + path.split("/")[4]
+    return None
+
+
+class HidrawTransport:
+    """Probe and echo over a hidraw device."""
+
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR)
+
+    def send_probe(self, probe):
+        os.write(self.fd, struct.pack("<BI", PROBE_ID, probe))
+
+    def get_echo(self):
+        import fcntl
+
+        buffer = bytearray(1 + ECHO.size)
+        buffer[0] = PROBE_ID
+        fcntl.ioctl(self.fd, hidiocgfeature(len(buffer)), buffer)
+        return bytes(buffer[1:])  # the first byte is the report id
+
+    def close(self):
+        os.close(self.fd)
+
+
+class MockTransport:
+    """Simulated device: a loop at loop_us, a USB polling interval of poll_us and a sampling period of frame_us.
+
+    The host clock advances by the simulated delays instead of waiting, so the measurement is deterministic.
+    """
+
+    def __init__(self, loop_us=400, poll_us=1000, frame_us=1000, seed=1):
+        self.random = random.Random(seed)
+        self.loop_us = loop_us
+        self.poll_us = poll_us
+        self.frame_us = frame_us
+        self.device_us = 12345678  # the device clock has its own offset
+        self.probe = (0, 0)
+        self.loop_seq = 0
+
+    def clock(self):
+        return self.device_us / 1e6
+
+    def transfer(self):
+        # an output or a control transfer waits for the next frame of the USB
+        self.device_us += self.poll_us - self.device_us % self.poll_us + self.random.randrange(50)
+
+    def send_probe(self, probe):
+        self.transfer()
+        self.probe = (probe, self.device_us)
+
+    def get_echo(self):
+        self.transfer()
+        echo_us = self.device_us
+        sent_us = echo_us - self.random.randrange(self.poll_us)
+        frame_us = sent_us - self.random.randrange(self.loop_us) - self.random.randrange(self.frame_us)
+        self.loop_seq += self.random.randrange(1, 4)
+        depth = self.random.randrange(3)
+        return ECHO.pack(self.probe[0], self.probe[1], echo_us, frame_us, sent_us, self.loop_seq, depth)
+
+    def close(self):
+        pass
+
+
+def measure(transport, count, interval, clock=time.perf_counter):
+    """Send count probes and return the samples of round trip, turnaround and sample to send in us, and the queue depths."""
+    samples = {"round trip": [], "turnaround": [], "sample to send": [], "queue depth": []}
+    lost = 0
+    for probe in range(1, count + 1):
+        start = clock()
+        transport.send_probe(probe)
+        echo = ECHO.unpack(transport.get_echo())
+        end = clock()
+        if echo[0] != probe:
+            lost += 1  # the echo belongs to another probe
+            continue
+        _, probe_us, echo_us, frame_us, sent_us, _, depth = echo
+        samples["round trip"].append((end - start) * 1e6)
+        samples["turnaround"].append((echo_us - probe_us) & 0xFFFFFFFF)
+        samples["sample to send"].append((sent_us - frame_us) & 0xFFFFFFFF)
+        samples["queue depth"].append(depth)
+        if interval > 0 and clock is time.perf_counter:
+            time.sleep(interval)
+    return samples, lost
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p / 100 * len(values)))]
+
+
+def report(samples, lost, out=sys.stdout):
+    out.write("%-15s %8s %8s %8s %8s %8s %8s\n" % ("", "min", "p50", "p90", "p99", "max", "mean"))
+    for name, values in samples.items():
+        if not values:
+            continue
+        out.write("%-15s %8.0f %8.0f %8.0f %8.0f %8.0f %8.1f\n" % (
+            name, min(values), percentile(values, 50), percentile(values, 90), percentile(values, 99), max(values),
+            sum(values) / len(values)))
+    out.write("times in us, %d probes, %d lost\n" % (len(samples["round trip"]), lost))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--device", help="hidraw device, found by VID and PID if omitted")
+    parser.add_argument("--mock", action="store_true", help="use a simulated device instead of hidraw")
+    parser.add_argument("--count", type=int, default=1000, help="number of probes")
+    parser.add_argument("--interval", type=float, default=0.002, help="pause between the probes in s")
+    args = parser.parse_args()
+
+    if args.mock:
+        transport = MockTransport()
+        samples, lost = measure(transport, args.count, args.interval, clock=transport.clock)
+    else:
+        device = args.device or find_hidraw()
+        if device is None:
+            sys.exit("no hidraw device of the spacemouse found, use --device")
+        transport = HidrawTransport(device)
+        try:
+            samples, lost = measure(transport, args.count, args.interval)
+        finally:
+            transport.close()
+    report(samples, lost)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""Subscribe to the telemetry taps of the spacemouse and convert the binary stream into CSV.
+
+The frame format is described in telemetry.h. Typical use:
+    telemetry_decode.py --port /dev/ttyACM0 --taps centered,exclusive --seconds 10 motion.csv
+    telemetry_decode.py --input stream.bin motion.csv      (decode a stream recorded before)
+The CSV has the columns time_us, tap, v0, v1, ... The axis of the HID reports 1 and 2 are decoded to int16 values.
+Reading from the port needs pyserial.
+"""
+import argparse
+import csv
+import struct
+import sys
+import time
+
+TAPS = ["raw", "centered", "deadzoned", "velocity", "killed", "exclusive", "hid"]
+TAP_HID = TAPS.index("hid")
+MAX_VALUES = 16  # TELEMETRY_MAX_VALUES in telemetry.h
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            raise ValueError("invalid COBS frame")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def fletcher16(data):
+    a = b = 0
+    for byte in data:
+        a = (a + byte) % 255
+        b = (b + a) % 255
+    return (b << 8) | a
+
+
+def varints(data, pos):
+    """Yield the varints of data from pos on, together with the position after each of them."""
+    while pos < len(data):
+        value = shift = 0
+        while True:
+            byte = data[pos]
+            pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if byte < 0x80:
+                break
+        yield value, pos
+
+
+def unzigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+class Decoder:
+    """Reconstruct the values of the taps from the keyframes and differences."""
+
+    def __init__(self):
+        self.time = {}
+        self.values = {}
+        self.bad_frames = 0
+
+    def bad_frame(self):
+        """The tap of a broken frame is unknown, so all taps wait for their next keyframe."""
+        self.bad_frames += 1
+        self.values.clear()
+        return None
+
+    def frame(self, encoded):
+        """Decode one COBS frame without the final 0x00. Return (time_us, tap, values) or None."""
+        try:
+            frame = cobs_decode(encoded)
+        except ValueError:
+            return self.bad_frame()
+        if len(frame) < 5 or fletcher16(frame[:-2]) != struct.unpack_from("<H", frame, len(frame) - 2)[0]:
+            return self.bad_frame()
+        tap, keyframe = frame[0] & 0x7F, bool(frame[0] & 0x80)
+        numbers = [v for v, _ in varints(frame[:-2], 1)]
+        if tap >= len(TAPS) or len(numbers) < 2 or len(numbers) != 2 + numbers[1]:
+            return self.bad_frame()
+        deltas = [unzigzag(v) for v in numbers[2:]]
+        if keyframe:
+            self.time[tap] = numbers[0]
+            self.values[tap] = deltas
+        elif tap in self.values and len(self.values[tap]) == len(deltas):
+            self.time[tap] = (self.time[tap] + numbers[0]) & 0xFFFFFFFF
+            self.values[tap] = [v + d for v, d in zip(self.values[tap], deltas)]
+        else:
+            return None  # wait for the next keyframe of this tap
+        return self.time[tap], tap, list(self.values[tap])
+
+
+def split_frames(data):
+    """Split the stream at the 0x00 bytes, return the complete frames and the rest."""
+    parts = data.split(b"\x00")
+    return [p for p in parts[:-1] if p], parts[-1]
+
+
+def row(time_us, tap, values):
+    if tap == TAP_HID and values and values[0] in (1, 2) and len(values) >= 7:
+        # the axis as int16, in the combined report 1 followed by the bytes of the buttons
+        payload = bytes(v & 0xFF for v in values[1:])
+        axes = 12 if len(payload) >= 12 else 6
+        values = [values[0]] + list(struct.unpack("<%dh" % (axes // 2), payload[:axes])) + list(payload[axes:])
+    return [time_us, TAPS[tap]] + values
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("output", help="CSV file, - for stdout")
+    parser.add_argument("--port", help="serial port of the spacemouse")
+    parser.add_argument("--input", help="binary stream recorded before, instead of --port")
+    parser.add_argument("--taps", default="centered,exclusive", help="comma separated taps: " + ",".join(TAPS))
+    parser.add_argument("--seconds", type=float, default=5, help="duration of the recording from the port")
+    args = parser.parse_args()
+    if not args.port and not args.input:
+        parser.error("--port or --input is needed")
+
+    if args.input:
+        with open(args.input, "rb") as f:
+            data = f.read()
+    else:
+        import serial  # pyserial
+
+        mask = 0
+        for name in args.taps.split(","):
+            if name not in TAPS:
+                parser.error("unknown tap %s" % name)
+            mask |= 1 << TAPS.index(name)
+        with serial.Serial(args.port, timeout=0.1) as ser:
+            ser.reset_input_buffer()
+            ser.write(b"telemetry %d\n" % mask)
+            # the answer is sent before the first frame, skip the text of a debug mode, which was still running
+            answer = ""
+            deadline = time.time() + 2
+            while time.time() < deadline and not answer.startswith(("ok telemetry", "err")):
+                answer = ser.readline().decode(errors="replace").strip()
+            if answer != "ok telemetry=%d" % mask:
+                sys.exit("the spacemouse doesn't stream the telemetry: %s" % (answer or "no answer"))
+            data = b""
+            deadline = time.time() + args.seconds
+            while time.time() < deadline:
+                data += ser.read(65536)
+            ser.write(b"telemetry 0\n")
+
+    frames, _ = split_frames(data)
+    decoder = Decoder()
+    out = sys.stdout if args.output == "-" else open(args.output, "w", newline="")
+    writer = csv.writer(out)
+    writer.writerow(["time_us", "tap"] + ["v%d" % i for i in range(MAX_VALUES)])
+    rows = 0
+    for encoded in frames:
+        decoded = decoder.frame(encoded)
+        if decoded:
+            writer.writerow(row(*decoded))
+            rows += 1
+    if out is not sys.stdout:
+        out.close()
+    print("%d rows, %d invalid frames" % (rows, decoder.bad_frames), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Record, upload and replay traces of the spacemouse and compare the HID reports against a golden output.
+
+The trace format is described in traceBuffer.h, the report log in traceReplay.h. Typical use:
+    trace_tool.py record --port /dev/ttyACM0 move.trace      (debug mode 32, then 36)
+    trace_tool.py golden --port /dev/ttyACM0 move.trace move.golden
+    trace_tool.py replay --port /dev/ttyACM0 move.trace move.golden
+    trace_tool.py show move.trace
+    trace_tool.py show move.golden
+replay exits with 1 and shows the first differing report, if the reports are not bit for bit the same as the golden output.
+All commands except show need pyserial.
+"""
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+TRACE_MAGIC = b"SMTR"
+TRACE_HEADER = struct.Struct("<4sBBHBBH8i")
+TRACE_FRAME = struct.Struct("<I8HBB")
+LOG_MAGIC = b"SMRL"
+LOG_HEADER = struct.Struct("<4sBBH")
+LOG_RECORD = struct.Struct("<IBB")
+LOG_END = 0xFFFFFFFF
+
+
+def find_trace(data):
+    """Return the trace contained in data, which may be surrounded by text of the serial interface."""
+    start = data.find(TRACE_MAGIC)
+    if start < 0 or len(data) < start + TRACE_HEADER.size:
+        raise ValueError("no trace found")
+    count = TRACE_HEADER.unpack_from(data, start)[3]
+    end = start + TRACE_HEADER.size + count * TRACE_FRAME.size
+    if len(data) < end + 4:
+        raise ValueError("trace is truncated")
+    (crc,) = struct.unpack_from("<I", data, end)
+    if zlib.crc32(data[start:end]) != crc:
+        raise ValueError("CRC mismatch, the trace is corrupted")
+    return data[start:end + 4]
+
+
+def parse_log(data):
+    """Return the reports (time in us, id, payload) of the report log contained in data and the end of the log."""
+    start = data.find(LOG_MAGIC)
+    if start < 0:
+        raise ValueError("no report log found")
+    pos = start + LOG_HEADER.size
+    reports = []
+    while True:
+        if len(data) < pos + LOG_RECORD.size:
+            raise ValueError("report log is truncated")
+        time_us, report_id, length = LOG_RECORD.unpack_from(data, pos)
+        pos += LOG_RECORD.size
+        if time_us == LOG_END and report_id == 0:
+            break
+        reports.append((time_us, report_id, bytes(data[pos:pos + length])))
+        pos += length
+    if len(data) < pos + 4:
+        raise ValueError("report log is truncated")
+    (crc,) = struct.unpack_from("<I", data, pos)
+    if zlib.crc32(data[start:pos]) != crc:
+        raise ValueError("CRC mismatch, the report log is corrupted")
+    return reports, data[start:pos + 4]
+
+
+def show_trace(trace):
+    header = TRACE_HEADER.unpack_from(trace, 0)
+    count, resolution, centers = header[3], header[4], header[7:15]
+    print("trace: %d frames, %d bit, center points: %s" % (count, resolution, ", ".join(map(str, centers))))
+    for n in range(count):
+        f = TRACE_FRAME.unpack_from(trace, TRACE_HEADER.size + n * TRACE_FRAME.size)
+        print("%10d us  %s  keys 0x%02x" % (f[0], " ".join("%5d" % v for v in f[1:9]), f[9]))
+
+
+def show_log(reports):
+    print("report log: %d reports" % len(reports))
+    for time_us, report_id, payload in reports:
+        values = struct.unpack("<%dh" % (len(payload) // 2), payload[:len(payload) // 2 * 2]) if report_id in (1, 2) else payload
+        print("%10d us  id %d  %s" % (time_us, report_id, " ".join(str(v) for v in values)))
+
+
+def command(ser, mode, timeout=3):
+    """Select a debug mode and return everything received until nothing comes for timeout seconds."""
+    ser.reset_input_buffer()
+    ser.write(b"%d\n" % mode)
+    data = b""
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        chunk = ser.read(4096)
+        if chunk:
+            data += chunk
+            deadline = time.time() + timeout
+    return data
+
+
+def upload(ser, trace):
+    ser.reset_input_buffer()
+    ser.write(b"33\n")
+    ser.readline()  # "Send the trace now."
+    ser.write(trace)
+    print(ser.readline().decode(errors="replace").strip())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("command", choices=["record", "golden", "replay", "show"])
+    parser.add_argument("file", help="trace file, or report log for show")
+    parser.add_argument("golden", nargs="?", help="golden report log")
+    parser.add_argument("--port", help="serial port of the spacemouse")
+    args = parser.parse_args()
+
+    if args.command == "show":
+        with open(args.file, "rb") as f:
+            data = f.read()
+        if data.find(TRACE_MAGIC) >= 0:
+            show_trace(find_trace(data))
+        else:
+            show_log(parse_log(data)[0])
+        return
+    if not args.port:
+        parser.error("--port is needed for %s" % args.command)
+    if args.command in ("golden", "replay") and not args.golden:
+        parser.error("the golden report log is needed for %s" % args.command)
+    import serial  # pyserial
+
+    with serial.Serial(args.port, timeout=1) as ser:
+        if args.command == "record":
+            print(command(ser, 32, timeout=1).decode(errors="replace").strip())
+            input("Move the knob, press enter after the recording has finished.")
+            trace = find_trace(command(ser, 36))
+            with open(args.file, "wb") as f:
+                f.write(trace)
+            print("%d frames saved" % TRACE_HEADER.unpack_from(trace, 0)[3])
+            return
+        with open(args.file, "rb") as f:
+            trace = find_trace(f.read())
+        upload(ser, trace)
+        reports, log = parse_log(command(ser, 35))
+    if args.command == "golden":
+        with open(args.golden, "wb") as f:
+            f.write(log)
+        print("%d reports saved as golden output" % len(reports))
+        return
+
+    with open(args.golden, "rb") as f:
+        golden, _ = parse_log(f.read())
+    for n, (got, expected) in enumerate(zip(reports, golden)):
+        if got != expected:
+            print("report %d differs:" % n)
+            show_log([expected])
+            show_log([got])
+            sys.exit(1)
+    if len(reports) != len(golden):
+        sys.exit("%d reports instead of %d" % (len(reports), len(golden)))
+    print("%d reports, bit for bit identical to the golden output" % len(reports))
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except ValueError as e:
+        sys.exit("error: %s" % e)
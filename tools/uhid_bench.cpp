@@ -0,0 +1,171 @@
+// Virtual spacemouse on Linux: sends the HID reports of a synthetic motion over uhid, to benchmark the throughput and the
+// latency of the report path (packing, coalescing, hidScheduler) without the hardware.
+// The motion is fed as ADC scans through the real pipeline of the loop(): readAllFromSensors() with the Kalman filters,
+// FilterAnalogReadOuts() and calculateKinematic(), built against the Arduino shim in test/shim.
+// The host side sees the same report descriptor as from the real device, e.g. run tools/latency_probe.py against it.
+//
+// Built by CMakeLists.txt on Linux as target uhid_bench, but not run by ctest. Run it with access to /dev/uhid:
+//   sudo ./uhid_bench [seconds] [min interval in us] [loop period in us]
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "config.h"
+#include "kinematics.h"
+#include "hidReport.h"
+#include "hidScheduler.h"
+#include "hidCoalescer.h"
+#include "latencyProbe.h"
+#include "hidDescriptor.h"
+#include "hidTransport.h"
+#include "uhidTransport.h"
+
+#define USBVID 0x256F
+#define USBPID 0xC63A
+
+#define REST 2000       // ADC value of the sensors at rest
+#define AMPLITUDE 300   // ADC counts of the sensors at full motion
+
+/// @brief The shim has a virtual time, the benchmark runs in real time and keeps the virtual time up to date
+static uint32_t wallMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  shimMicros = ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+  return shimMicros;
+}
+
+/// @brief Engine, which takes one scan of all sensors from analogRead() of the shim per call, like the ADC in
+/// continuous mode, which converts one scan per SAMPLING_PERIOD_US
+class ShimAdcEngine : public AdcEngine {
+public:
+  void service() override {
+    uint16_t values[ADC_CHANNELS];
+    for (int i = 0; i < ADC_CHANNELS; i++) values[i] = analogRead(pinList[i]);
+    pushScan(values, micros());
+  }
+};
+
+/// @brief Set the sensors to the deflection of the knob, with some noise
+/// @param a phase of the motion in rad, the push goes around the knob
+/// @param level 0 ... 1, 0 for the knob at rest
+static void setSensors(double a, double level, uint32_t& seed) {
+  for (int i = 0; i < 8; i++) {
+    seed = seed * 1103515245 + 12345;
+    int noise = (int)((seed >> 16) % 5) - 2;
+    shimAnalog[pinList[i]] = REST + (int)(AMPLITUDE * level * sin(a + i * M_PI / 4)) + noise;
+  }
+}
+
+static LatencyProbe latencyProbe;
+static HidScheduler* scheduler;
+
+static void onOutput(uint8_t id, const uint8_t* data, uint16_t len) {
+  if (id == LATENCY_PROBE_ID) latencyProbe.probe(data, len, wallMicros());
+}
+
+static uint16_t onGetFeature(uint8_t id, uint8_t* buffer, uint16_t len) {
+  if (id != LATENCY_PROBE_ID) return 0;
+  return latencyProbe.echo(buffer, len, wallMicros(), scheduler->pending());
+}
+
+static void onSent(uint8_t id, uint32_t nowUs) {
+  if (id == 1 || id == 2) latencyProbe.motionSent(nowUs);
+}
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 10;
+  uint32_t minIntervalUs = argc > 2 ? atoi(argv[2]) : 1000;
+  uint32_t loopUs = argc > 3 ? atoi(argv[3]) : 250;
+
+  UhidTransport transport("SpaceMouse uhid", USBVID, USBPID);
+  transport.setHandlers(onOutput, onGetFeature);
+  if (!transport.begin(report_descriptor, sizeof(report_descriptor))) return 1;
+  HidScheduler hidScheduler(transport, minIntervalUs, HID_MAX_AGE_US);
+  hidScheduler.onSent = onSent;
+  scheduler = &hidScheduler;
+  ReportCoalescer coalescer(HID_MAX_STALE_MS);
+  const int16_t thresholds[HID_COALESCE_MAX_VALUES] = HID_SIGNIFICANCE;
+
+  // the knob at rest: let the Kalman filters settle and take the center points, like the zeroing of the sketch
+  static ShimAdcEngine adc;
+  uint32_t seed = 1;
+  int rawReads[8];
+  int centerPoints[8];
+  int centered[8];
+  int16_t velocity[6] = {};
+  setupkalmanFilters();
+  for (int i = 0; i < 8; i++) deadzones[i] = DEADZONE * SENSOR_SCALE;
+  for (int n = 0; n < 500 * OVERSAMPLING_RATIO; n++) {
+    setSensors(0, 0, seed);
+    readAllFromSensors(rawReads, adc);
+  }
+  memcpy(centerPoints, rawReads, sizeof(centerPoints));
+
+  // wait until the kernel has started the device
+  uint32_t start = wallMicros();
+  while (!transport.ready() && wallMicros() - start < 2000000) transport.poll(100);
+  printf("uhid device started, %u us min interval, %u us loop\n", minIntervalUs, loopUs);
+
+  start = wallMicros();
+  uint32_t nextLoop = start;
+  uint32_t maxSendUs = 0;
+  uint32_t frames = 0;
+  uint32_t maxPipelineUs = 0;
+  while (wallMicros() - start < seconds * 1e6) {
+    transport.poll(0);
+    uint32_t now = wallMicros();
+    if ((int32_t)(now - nextLoop) < 0) continue;
+    nextLoop += loopUs;
+
+    // a slow push around the knob, with pauses
+    double t = (now - start) / 1e6;
+    setSensors(t * 2.0, fmod(t, 4.0) < 3.0 ? 1.0 : 0.0, seed);
+    latencyProbe.loopStart(now);
+    // only a new frame gives new velocities, the loop() sends the last ones in between
+    if (readAllFromSensors(rawReads, adc)) {
+      for (int i = 0; i < 8; i++) centered[i] = rawReads[i] - centerPoints[i];
+      FilterAnalogReadOuts(centered);
+      calculateKinematic(centered, velocity);
+      frames++;
+      uint32_t pipelineUs = wallMicros() - now;
+      if (pipelineUs > maxPipelineUs) maxPipelineUs = pipelineUs;
+    }
+    int16_t axes[6] = { velocity[TRANSX], velocity[TRANSY], velocity[TRANSZ], velocity[ROTX], velocity[ROTY], velocity[ROTZ] };
+
+#if HID_COMBINED_REPORT > 0
+    if (HID_COALESCE == 0 || coalescer.admit(1, axes, thresholds, 6, now / 1000)) {
+      uint8_t payload[HID_COMBINED_MAX_SIZE];
+      size_t len = packCombinedReport(payload, axes[0], axes[1], axes[2], axes[3], axes[4], axes[5], nullptr, 0);
+      latencyProbe.motionPosted();
+      hidScheduler.post(1, payload, len, now);
+    }
+#else
+    // the translations in report 1 and the rotations in report 2, like the descriptor without the combined report
+    for (uint8_t id = 1; id <= 2; id++) {
+      const int16_t* values = axes + 3 * (id - 1);
+      if (HID_COALESCE == 0 || coalescer.admit(id, values, thresholds + 3 * (id - 1), 3, now / 1000)) {
+        uint8_t payload[HID_AXES_REPORT_SIZE];
+        packAxesReport(payload, values[0], values[1], values[2]);
+        latencyProbe.motionPosted();
+        hidScheduler.post(id, payload, sizeof(payload), now);
+      }
+    }
+#endif
+    uint32_t sendStart = wallMicros();
+    if (hidScheduler.service(sendStart)) {
+      uint32_t sendUs = wallMicros() - sendStart;
+      if (sendUs > maxSendUs) maxSendUs = sendUs;
+    }
+  }
+
+  double elapsed = (wallMicros() - start) / 1e6;
+  printf("%u frames in %.1f s: %.0f frames/s, pipeline max %u us\n", frames, elapsed, frames / elapsed, maxPipelineUs);
+  printf("%u reports in %.1f s: %.0f reports/s\n", hidScheduler.sent, elapsed, hidScheduler.sent / elapsed);
+  printf("posted %u, coalesced %u, dropped %u, stale %u, suppressed %u (%.1f %%)\n", hidScheduler.posted, hidScheduler.coalesced,
+         hidScheduler.dropped, hidScheduler.stale, coalescer.suppressed, coalescer.suppressionRatio());
+  printf("latency post to send: mean %u us, max %u us, write to uhid max %u us\n", hidScheduler.latencyMeanUs(),
+         hidScheduler.latencyMaxUs, maxSendUs);
+  return 0;
+}
@@ -0,0 +1,149 @@
+// This file contains the trace buffer for the replay of recorded sensor data, see traceReplay.h
+// A trace holds the decimated ADC frames, as they come from the acquisition engine, and the raw key states.
+// It is recorded on the spacemouse (debug mode 32) or uploaded over the serial interface (debug mode 33), see tools/trace_tool.py
+//
+// Binary format, all values little endian:
+//   header:  "SMTR", uint8 version, uint8 reserved, uint16 number of frames, uint8 sensor resolution in bits, uint8 reserved,
+//            uint16 reserved, int32 centerPoints[8]
+//   frames:  uint32 timestamp in us, uint16 adc[8], uint8 keys (bit i = raw value of key i), uint8 reserved
+//   trailer: uint32 CRC-32 over header and frames
+
+#ifndef TRACEBUFFER_H
+#define TRACEBUFFER_H
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include "crc32.h"
+#include <stdint.h>
+#include <string.h>
+
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 44
+#define TRACE_FRAME_SIZE 22
+
+struct TraceFrame {
+  uint32_t timeUs;
+  uint16_t adc[8];
+  uint8_t keys;
+};
+
+class TraceBuffer {
+public:
+  /// @brief Start recording the next TRACE_MAX_FRAMES frames
+  /// @param centerPoints pointer to the 8 center points, which are stored with the trace
+  void startRecording(const int* centerPoints) {
+    for (int i = 0; i < 8; i++) centers[i] = centerPoints[i];
+    resolution = SENSOR_RESOLUTION;
+    count = 0;
+    recording = true;
+  }
+
+  bool isRecording() {
+    return recording;
+  }
+
+  /// @brief Store a new frame of the acquisition engine while recording. Called by the consumer of the engine.
+  void capture(const uint16_t* adc, uint32_t timeUs) {
+    if (!recording) return;
+    TraceFrame& f = frames[count];
+    f.timeUs = timeUs;
+    memcpy(f.adc, adc, sizeof(f.adc));
+    f.keys = keys;
+    if (++count >= TRACE_MAX_FRAMES) recording = false;
+  }
+
+  /// @brief Stop recording before the buffer is full
+  void stopRecording() {
+    recording = false;
+  }
+
+  /// @brief Serialize the trace, see the format at the top of this file
+  /// @param write function, which gets the bytes
+  template<typename W>
+  void serialize(W write) {
+    uint8_t buf[TRACE_HEADER_SIZE];
+    uint8_t* p = buf;
+    memcpy(p, "SMTR", 4);
+    p += 4;
+    *p++ = TRACE_VERSION;
+    *p++ = 0;
+    p = putLE(p, count, 2);
+    *p++ = resolution;
+    *p++ = 0;
+    p = putLE(p, 0, 2);
+    for (int i = 0; i < 8; i++) p = putLE(p, (uint32_t)centers[i], 4);
+    uint32_t crc = crc32Update(0, buf, TRACE_HEADER_SIZE);
+    write(buf, TRACE_HEADER_SIZE);
+    for (uint16_t n = 0; n < count; n++) {
+      p = putLE(buf, frames[n].timeUs, 4);
+      for (int i = 0; i < 8; i++) p = putLE(p, frames[n].adc[i], 2);
+      *p++ = frames[n].keys;
+      *p++ = 0;
+      crc = crc32Update(crc, buf, TRACE_FRAME_SIZE);
+      write(buf, TRACE_FRAME_SIZE);
+    }
+    putLE(buf, crc, 4);
+    write(buf, 4);
+  }
+
+  /// @brief Parse a trace, see the format at the top of this file
+  /// @param read function, which fills a buffer with the given number of bytes and returns false on a timeout
+  /// @return false, if the trace is invalid, too long or incomplete. The buffer is empty afterwards.
+  template<typename R>
+  bool parse(R read) {
+    recording = false;
+    count = 0;
+    uint8_t buf[TRACE_HEADER_SIZE];
+    if (!read(buf, TRACE_HEADER_SIZE) || memcmp(buf, "SMTR", 4) != 0 || buf[4] != TRACE_VERSION) return false;
+    uint32_t crc = crc32Update(0, buf, TRACE_HEADER_SIZE);
+    const uint8_t* p = buf + 6;
+    uint16_t n = getLE(p, 2);
+    if (n > TRACE_MAX_FRAMES) return false;
+    uint8_t res = *p++;
+    p += 3;
+    int32_t c[8];
+    for (int i = 0; i < 8; i++) c[i] = (int32_t)getLE(p, 4);
+    for (uint16_t k = 0; k < n; k++) {
+      if (!read(buf, TRACE_FRAME_SIZE)) return false;
+      crc = crc32Update(crc, buf, TRACE_FRAME_SIZE);
+      p = buf;
+      frames[k].timeUs = getLE(p, 4);
+      for (int i = 0; i < 8; i++) frames[k].adc[i] = getLE(p, 2);
+      frames[k].keys = *p;
+    }
+    if (!read(buf, 4)) return false;
+    p = buf;
+    if (getLE(p, 4) != crc) return false;
+    memcpy(centers, c, sizeof(centers));
+    resolution = res;
+    count = n;
+    return true;
+  }
+
+  TraceFrame frames[TRACE_MAX_FRAMES];
+  volatile uint16_t count = 0;  // number of valid frames
+  int32_t centers[8];           // center points at the time of the recording
+  uint8_t resolution = SENSOR_RESOLUTION;
+  volatile uint8_t keys = 0;  // raw key states, updated by the loop() while recording
+
+private:
+  static uint8_t* putLE(uint8_t* p, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+      *p++ = value >> (8 * i);
+    }
+    return p;
+  }
+
+  static uint32_t getLE(const uint8_t*& p, int bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+      value |= (uint32_t)(*p++) << (8 * i);
+    }
+    return value;
+  }
+
+  volatile bool recording = false;
+};
+
+TraceBuffer traceBuffer;
+#endif
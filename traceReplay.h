@@ -0,0 +1,191 @@
+// This file contains the report log of the trace replay. The replay itself is done by replayTrace() in the main file,
+// because it runs the trace through the same processing as the loop().
+// During the replay, the HID reports don't go to the USB but into the report log (stub HID sink) and the time is taken
+// from the trace (virtualClock.h). Therefore, the same trace and the same firmware give exactly the same reports.
+// The report log is either streamed over the serial interface (debug mode 35) to be compared bit by bit against a golden
+// output with tools/trace_tool.py, or only summarized as CRC-32 together with the replay speed (debug mode 34).
+//
+// Binary format of the report log, all values little endian:
+//   header:  "SMRL", uint8 version, uint8 reserved, uint16 reserved
+//   reports: uint32 virtual time in us, uint8 report id, uint8 length, payload
+//   end:     uint32 0xFFFFFFFF, uint8 0, uint8 0
+//   trailer: uint32 CRC-32 over everything before
+//
+// The ResponseMeter measures the step response latency and the jitter of the velocities during a replay (debug mode 37).
+
+// The user specific settings, like pin mappings or special configuration variables and sensitivities are stored in config.h.
+// Please open config_sample.h, adjust your settings and save it as config.h
+#include "config.h"
+#include "crc32.h"
+#include "traceBuffer.h"
+#include "virtualClock.h"
+#include <math.h>
+#include <string.h>
+
+#define REPORTLOG_VERSION 1
+
+class ReportLog {
+public:
+  /// @brief Start a new log
+  /// @param stream stream for the log, or nullptr if only the CRC-32 is needed
+  void begin(Stream* stream) {
+    out = stream;
+    crc = 0;
+    reports = 0;
+    const uint8_t header[8] = { 'S', 'M', 'R', 'L', REPORTLOG_VERSION, 0, 0, 0 };
+    write(header, sizeof(header));
+  }
+
+  /// @brief Add one HID report
+  void add(uint8_t id, const void* value, size_t len) {
+    uint8_t head[6];
+    putHead(head, clockVirtualUs, id, len);
+    write(head, sizeof(head));
+    write((const uint8_t*)value, len);
+    reports++;
+  }
+
+  /// @brief Finish the log with the end marker and the CRC-32
+  /// @return CRC-32 of the whole log
+  uint32_t end() {
+    uint8_t head[6];
+    putHead(head, 0xFFFFFFFF, 0, 0);
+    write(head, sizeof(head));
+    uint32_t result = crc;
+    uint8_t trailer[4] = { (uint8_t)result, (uint8_t)(result >> 8), (uint8_t)(result >> 16), (uint8_t)(result >> 24) };
+    if (out) {
+      out->write(trailer, 4);
+      out->flush();
+    }
+    return result;
+  }
+
+  uint32_t reports = 0;  // number of reports in the log
+
+private:
+  static void putHead(uint8_t* p, uint32_t timeUs, uint8_t id, uint8_t len) {
+    for (int i = 0; i < 4; i++) p[i] = timeUs >> (8 * i);
+    p[4] = id;
+    p[5] = len;
+  }
+
+  void write(const uint8_t* data, size_t len) {
+    crc = crc32Update(crc, data, len);
+    if (out) out->write(data, len);
+  }
+
+  Stream* out = nullptr;
+  uint32_t crc = 0;
+};
+
+ReportLog reportLog;
+
+/// @brief Stub HID sink for the replay, see reportSink in usbSpaceHID.h
+void traceReportSink(uint8_t id, const void* value, size_t len) {
+  reportLog.add(id, value, len);
+}
+
+/// @brief Step response latency and jitter of the velocities over a trace, to compare filter settings, see debug mode 37
+/// The step starts with the first frame with any velocity. The latency is the time from there until the velocity reaches 90%
+/// of its peak. The jitter is the RMS of the second difference of the moving axis, i.e. the noise on top of the movement.
+/// Translation and rotation are measured separately.
+class ResponseMeter {
+public:
+  void begin() {
+    for (int g = 0; g < 2; g++) {
+      peak[g] = 0;
+      jitterSum[g] = 0;
+      jitterCount[g] = 0;
+    }
+    frames = 0;
+    stepFrame = -1;
+    memset(prev, 0, sizeof(prev));
+  }
+
+  /// @brief Add the velocities of the next frame
+  void add(const int16_t* velocity, uint32_t timeUs) {
+    if (frames >= TRACE_MAX_FRAMES) return;
+    for (int g = 0; g < 2; g++) {
+      int m = 0;
+      for (int axis = 3 * g; axis < 3 * g + 3; axis++) {
+        m = max(m, abs(velocity[axis]));
+        // second difference, only while the axis is moving
+        if (frames >= 2 && velocity[axis] != 0 && prev[0][axis] != 0 && prev[1][axis] != 0) {
+          float d2 = velocity[axis] - 2.0f * prev[0][axis] + prev[1][axis];
+          jitterSum[g] += d2 * d2;
+          jitterCount[g]++;
+        }
+      }
+      magnitude[g][frames] = m;
+      peak[g] = max(peak[g], m);
+      if (m > 0 && stepFrame < 0) {
+        stepFrame = frames;
+        stepTimeUs = timeUs;
+      }
+    }
+    memcpy(prev[1], prev[0], sizeof(prev[0]));
+    memcpy(prev[0], velocity, sizeof(prev[0]));
+    times[frames++] = timeUs;
+  }
+
+  /// @brief Latency from the start of the step until the velocity reaches 90% of its peak
+  /// @param g 0 for the translation, 1 for the rotation
+  /// @return latency in ms, or -1 if there was no movement
+  float latencyMs(int g) const {
+    if (stepFrame < 0 || peak[g] == 0) return -1;
+    for (int n = stepFrame; n < frames; n++) {
+      if (magnitude[g][n] * 10 >= peak[g] * 9) return (uint32_t)(times[n] - stepTimeUs) / 1000.0f;
+    }
+    return -1;
+  }
+
+  /// @brief RMS of the second difference of the moving axis
+  /// @param g 0 for the translation, 1 for the rotation
+  float jitter(int g) const {
+    return jitterCount[g] ? sqrtf(jitterSum[g] / jitterCount[g]) : 0;
+  }
+
+  int peak[2];  // peak velocity of the translation and rotation
+
+private:
+  int16_t magnitude[2][TRACE_MAX_FRAMES];  // largest velocity of the translation and rotation per frame
+  uint32_t times[TRACE_MAX_FRAMES];
+  int16_t prev[2][6];  // velocities of the two last frames
+  float jitterSum[2];
+  uint32_t jitterCount[2];
+  int frames;
+  int stepFrame;
+  uint32_t stepTimeUs;
+};
+
+/// @brief Receive a trace over the serial interface into the trace buffer (debug mode 33)
+/// @return true, if a valid trace was received
+bool uploadTrace() {
+  while (SERIAL.available()) SERIAL.read();  // drop the rest of the command line
+  SERIAL.println(F("Send the trace now."));
+  bool ok = traceBuffer.parse([](uint8_t* buf, size_t len) {
+    size_t n = 0;
+    unsigned long start = millis();
+    while (n < len && millis() - start < TRACE_UPLOAD_TIMEOUT_MS) {
+      if (SERIAL.available()) {
+        buf[n++] = SERIAL.read();
+        start = millis();
+      }
+    }
+    return n == len;
+  });
+  if (ok) {
+    SERIAL.printf("Trace with %u frames received.\n", (unsigned)traceBuffer.count);
+  } else {
+    SERIAL.println(F("Upload failed: invalid trace."));
+  }
+  return ok;
+}
+
+/// @brief Send the trace buffer as binary blob (debug mode 36)
+void downloadTrace() {
+  traceBuffer.serialize([](const uint8_t* buf, size_t len) {
+    SERIAL.write(buf, len);
+  });
+  SERIAL.flush();
+}
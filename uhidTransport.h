@@ -0,0 +1,138 @@
+// This file contains the transport of the HID reports over the Linux uhid, see hidTransport.h
+// It creates a virtual spacemouse on a Linux box, e.g. to benchmark the throughput and the latency of the reports
+// without the hardware, see tools/uhid_bench.cpp. It is not used by the sketch, it needs Linux and access to /dev/uhid.
+
+#ifndef UHIDTRANSPORT_H
+#define UHIDTRANSPORT_H
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <linux/uhid.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "hidTransport.h"
+
+class UhidTransport : public HidTransport {
+public:
+  UhidTransport(const char* deviceName, uint16_t vid, uint16_t pid)
+    : deviceName(deviceName), vid(vid), pid(pid) {}
+
+  ~UhidTransport() {
+    if (fd < 0) return;
+    struct uhid_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = UHID_DESTROY;
+    writeEvent(ev);
+    close(fd);
+  }
+
+  bool begin(const uint8_t* descriptor, size_t len) override {
+    if (len > HID_MAX_DESCRIPTOR_SIZE) return false;
+    fd = open("/dev/uhid", O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+      perror("open /dev/uhid");
+      return false;
+    }
+    struct uhid_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = UHID_CREATE2;
+    snprintf((char*)ev.u.create2.name, sizeof(ev.u.create2.name), "%s", deviceName);
+    memcpy(ev.u.create2.rd_data, descriptor, len);
+    ev.u.create2.rd_size = len;
+    ev.u.create2.bus = BUS_USB;
+    ev.u.create2.vendor = vid;
+    ev.u.create2.product = pid;
+    return writeEvent(ev);
+  }
+
+  bool connected() override {
+    return opened;
+  }
+
+  HidCapabilities capabilities() override {
+    return { 1000, 63, true, false };  // like the USB, the kernel itself has no limit
+  }
+
+  const char* name() override {
+    return "uhid";
+  }
+
+  bool ready() override {
+    return started;
+  }
+
+  bool send(uint8_t id, const uint8_t* data, size_t len) override {
+    struct uhid_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = UHID_INPUT2;
+    if (len + 1 > sizeof(ev.u.input2.data)) return false;
+    ev.u.input2.data[0] = id;
+    memcpy(ev.u.input2.data + 1, data, len);
+    ev.u.input2.size = len + 1;
+    return writeEvent(ev);
+  }
+
+  /// @brief Handle the events of the kernel: start, open and the output and feature reports of the host
+  /// @param timeoutMs time to wait for an event, 0 to return immediately
+  void poll(int timeoutMs) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    while (::poll(&pfd, 1, timeoutMs) > 0 && (pfd.revents & POLLIN)) {
+      timeoutMs = 0;
+      struct uhid_event ev;
+      if (read(fd, &ev, sizeof(ev)) <= 0) return;
+      switch (ev.type) {
+        case UHID_START: started = true; break;
+        case UHID_STOP: started = false; break;
+        case UHID_OPEN: opened = true; break;
+        case UHID_CLOSE: opened = false; break;
+        case UHID_OUTPUT:
+          // the data starts with the report id
+          if (onOutput && ev.u.output.size > 0) onOutput(ev.u.output.data[0], ev.u.output.data + 1, ev.u.output.size - 1);
+          break;
+        case UHID_SET_REPORT:
+          if (onOutput && ev.u.set_report.size > 0) onOutput(ev.u.set_report.rnum, ev.u.set_report.data + 1, ev.u.set_report.size - 1);
+          replySetReport(ev.u.set_report.id);
+          break;
+        case UHID_GET_REPORT:
+          replyGetReport(ev.u.get_report.id, ev.u.get_report.rnum);
+          break;
+        default: break;
+      }
+    }
+  }
+
+private:
+  bool writeEvent(const struct uhid_event& ev) {
+    return write(fd, &ev, sizeof(ev)) == (ssize_t)sizeof(ev);
+  }
+
+  void replyGetReport(uint32_t requestId, uint8_t reportId) {
+    struct uhid_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = UHID_GET_REPORT_REPLY;
+    ev.u.get_report_reply.id = requestId;
+    ev.u.get_report_reply.data[0] = reportId;
+    uint16_t len = onGetFeature ? onGetFeature(reportId, ev.u.get_report_reply.data + 1, sizeof(ev.u.get_report_reply.data) - 1) : 0;
+    ev.u.get_report_reply.err = len ? 0 : EIO;
+    ev.u.get_report_reply.size = len ? len + 1 : 0;
+    writeEvent(ev);
+  }
+
+  void replySetReport(uint32_t requestId) {
+    struct uhid_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = UHID_SET_REPORT_REPLY;
+    ev.u.set_report_reply.id = requestId;
+    writeEvent(ev);
+  }
+
+  const char* deviceName;
+  uint16_t vid;
+  uint16_t pid;
+  int fd = -1;
+  bool started = false;
+  bool opened = false;
+};
+#endif
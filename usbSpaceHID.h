@@ -43,63 +43,30 @@ FirmwareMSC MSC_Update;
 #endif
 
 #include "USBHID.h"
+#include "class/hid/hid_device.h"
 USBHID HID;
 
-static const uint8_t report_descriptor[] = {
-  // --- Global Items ---
-  0x05, 0x01,  // Usage Page (Generic Desktop)
-  0x09, 0x08,  // Usage (Multi-axis Controller)
-  0xA1, 0x01,  // Collection (Application)
-
-  // --- Translation Report (ID 1) ---
-  0xA1, 0x00, 0x85, 0x01,
-  0x16, 0xA2, 0xFE, 0x26, 0x5E, 0x01,
-  0x09, 0x30, 0x09, 0x31, 0x09, 0x32,
-  0x75, 0x10, 0x95, 0x03, 0x81, 0x02,
-  0xC0,
-
-  // --- Rotation Report (ID 2) ---
-  0xA1, 0x00, 0x85, 0x02,
-  0x16, 0xA2, 0xFE, 0x26, 0x5E, 0x01,
-  0x09, 0x33, 0x09, 0x34, 0x09, 0x35,
-  0x75, 0x10, 0x95, 0x03, 0x81, 0x02,
-  0xC0,
-
-  // --- Button Report (ID 3) ---
-  0xA1, 0x00, 0x85, 0x03,
-  0x05, 0x09, 0x19, 0x01, 0x29, 0x02,
-  0x15, 0x00, 0x25, 0x01,
-  0x75, 0x01, 0x95, 0x02, 0x81, 0x02,
-  0x75, 0x01, 0x95, 0x0E, 0x81, 0x03,
-  0xC0,
-
-  // --- LED Control Report (ID 4) ---
-  0xA1, 0x02, 0x85, 0x04,
-  0x05, 0x08, 0x09, 0x4B,
-  0x15, 0x00, 0x25, 0x01,
-  0x95, 0x01, 0x75, 0x01, 0x91, 0x02,
-  0x95, 0x01, 0x75, 0x07, 0x91, 0x03,
-  0xC0,
-
-  // --- Power Status Report (ID 23) ---
-  0x06, 0x00, 0xFF,
-  0x85, 0x17,
-  0x09, 0x01,
-  0x15, 0x00, 0x25, 0x64,
-  0x75, 0x08, 0x95, 0x01,
-  0x81, 0x02,
-  0x09, 0x02,
-  0x25, 0x01, 0x95, 0x01,
-  0x81, 0x02,
-
-  0xC0  // End Application Collection
-};
+#include "virtualClock.h"
+#include "telemetry.h"
+#include "hidReport.h"
+#include "hidScheduler.h"
+#include "hidCoalescer.h"
+#include "latencyProbe.h"
+#include "hidDescriptor.h"
+#include "hidTransport.h"
+#include "spaceKeys.h"
+
+// If set, the HID reports are given to this function instead of the USB, e.g. to record them during the replay of a trace
+void (*reportSink)(uint8_t id, const void* value, size_t len) = nullptr;
+
+#if LATENCY_PROBE > 0
+LatencyProbe latencyProbe;
+#endif
 
-class SpaceMouseHID_Device : public USBHIDDevice {
+// The USB HID, the reports are sent over the interrupt IN endpoint
+class UsbHidTransport : public HidTransport, public USBHIDDevice {
 public:
-  bool ledState = false;
-
-  SpaceMouseHID_Device(void) {
+  UsbHidTransport(void) {
     static bool initialized = false;
     if (!initialized) {
       initialized = true;
@@ -107,28 +74,181 @@ public:
     }
   }
 
-  void begin(void) {
+  bool begin(const uint8_t* descriptor, size_t len) override {
+    this->descriptor = descriptor;
+    descriptorLen = len;
     HID.begin();
+    return true;
+  }
+
+  bool connected() override {
+    return USB;
+  }
+
+  HidCapabilities capabilities() override {
+    return { 1000, 63, true, false };  // full speed: one report per frame of 1 ms, 64 bytes including the report id
   }
 
-  uint16_t _onGetDescriptor(uint8_t* buffer) {
-    memcpy(buffer, report_descriptor, sizeof(report_descriptor));
-    return sizeof(report_descriptor);
+  const char* name() override {
+    return "USB";
+  }
+
+  bool ready() override {
+    return HID.ready();
+  }
+
+  bool send(uint8_t id, const uint8_t* data, size_t len) override {
+#if HID_SCHEDULER > 0
+    // HID.SendReport() takes the mutex of the USBHID, clears the completion semaphore, sends and then blocks until the
+    // host has fetched the report or the timeout expires. Here, the hidSchedulerTask() is the only one, which sends over
+    // this interface, and it sends only after ready(). So there is nothing to lock against, the semaphore stays unused
+    // (SendReport() clears it anyway before it sends) and waiting for the completion would only stall the task, which
+    // sees the completion with the next ready(). If the endpoint refuses the report, the scheduler keeps it and tries again.
+    return tud_hid_n_report(0, id, data, len);
+#else
+    // waits until the previous report is completed, so e.g. the battery report and the motion report don't collide
+    return HID.SendReport(id, data, len);
+#endif
+  }
+
+  uint16_t _onGetDescriptor(uint8_t* buffer) override {
+    memcpy(buffer, descriptor, descriptorLen);
+    return descriptorLen;
   }
 
   void _onOutput(uint8_t report_id, const uint8_t* buffer, uint16_t len) override {
+    if (onOutput) onOutput(report_id, buffer, len);
+  }
+
+  uint16_t _onGetFeature(uint8_t report_id, uint8_t* buffer, uint16_t len) override {
+    return onGetFeature ? onGetFeature(report_id, buffer, len) : 0;
+  }
+
+private:
+  const uint8_t* descriptor = report_descriptor;
+  size_t descriptorLen = sizeof(report_descriptor);
+};
+
+UsbHidTransport usbHidTransport;
+HidTransport* hidTransport = &usbHidTransport;  // the transport of the reports, see selectTransport()
+
+#if HID_SCHEDULER > 0
+HidScheduler hidScheduler(usbHidTransport, HID_MIN_INTERVAL_US, HID_MAX_AGE_US);
+SemaphoreHandle_t hidSchedulerMutex = NULL;  // guards the hidScheduler and the transport between the loop() and the task
+TaskHandle_t hidSchedulerTaskHandle = NULL;
+
+/// @brief Queue a report for the hidSchedulerTask() and wake it up
+bool hidSchedulerPost(uint8_t id, const void* data, size_t len) {
+  xSemaphoreTake(hidSchedulerMutex, portMAX_DELAY);
+  bool posted = hidScheduler.post(id, data, len, micros());
+  xSemaphoreGive(hidSchedulerMutex);
+  if (hidSchedulerTaskHandle != NULL) xTaskNotifyGive(hidSchedulerTaskHandle);
+  return posted;
+}
+
+/// @brief Sends the pending reports as soon as the endpoint is ready, independent of the timing of the loop().
+/// Sleeps until a report is posted. While reports are pending, the ready() of the endpoint (tud_hid_n_ready() of the USB)
+/// is checked every tick of 1 ms, which matches the polling interval of the host.
+/// A paced transport like BLE is serviced on every tick, it flushes its reports once per connection event.
+void hidSchedulerTask(void* parameter) {
+  for (;;) {
+    xSemaphoreTake(hidSchedulerMutex, portMAX_DELAY);
+    uint32_t now = micros();
+    bool sent = hidScheduler.service(now);
+    hidTransport->service(now);
+    bool wait = hidScheduler.idle() && !hidTransport->capabilities().paced;
+    xSemaphoreGive(hidSchedulerMutex);
+    if (!sent) ulTaskNotifyTake(pdTRUE, wait ? portMAX_DELAY : 1);
+  }
+}
+
+/// @brief Start the hidSchedulerTask(). Call this once in setupUSB()
+void startHidSchedulerTask() {
+  xTaskCreatePinnedToCore(hidSchedulerTask, "hidScheduler", HID_SCHEDULER_TASK_STACK, NULL, HID_SCHEDULER_TASK_PRIORITY,
+                          &hidSchedulerTaskHandle, HID_SCHEDULER_CORE);
+}
+#endif
+
+/// @brief A report was handed to the transport
+void hidReportSent(uint8_t id, uint32_t nowUs) {
+#if LATENCY_PROBE > 0
+  if (id == 1 || id == 2) latencyProbe.motionSent(nowUs);
+#endif
+}
+
+/// @brief Send the reports over this transport from now on
+void selectTransport(HidTransport& transport) {
+  HidCapabilities caps = transport.capabilities();
+#if HID_SCHEDULER > 0
+  uint32_t minIntervalUs = 1000000UL / caps.maxReportRateHz;
+  if (hidSchedulerMutex) xSemaphoreTake(hidSchedulerMutex, portMAX_DELAY);
+  hidTransport = &transport;
+  hidScheduler.setEndpoint(transport);
+  hidScheduler.minIntervalUs = caps.paced ? 0 : max((uint32_t)HID_MIN_INTERVAL_US, minIntervalUs);
+  if (hidSchedulerMutex) xSemaphoreGive(hidSchedulerMutex);
+#else
+  hidTransport = &transport;
+#endif
+  if (HID_COMBINED_REPORT > 0 && !caps.combinedReport) {
+    SERIAL.printf("HID transport %s doesn't support the combined report\n", transport.name());
+  }
+  if (caps.maxReportSize < HID_COMBINED_MAX_SIZE) {
+    SERIAL.printf("HID transport %s supports only %u bytes per report\n", transport.name(), caps.maxReportSize);
+  }
+}
+
+// Builds the reports of the spacemouse and hands them to the selected transport
+class SpaceMouseHID_Device {
+public:
+  bool ledState = false;
+
+  bool getLed() {
+    return ledState;
+  }
+
+  /// @brief Handle an output report of the host, independent of the transport
+  void output(uint8_t report_id, const uint8_t* buffer, uint16_t len) {
     if (report_id == 4 && len >= 1) {
       ledState = (buffer[0] != 0);
       SERIAL.printf("LED state set to %s\n", ledState ? "ON" : "OFF");
     }
+#if LATENCY_PROBE > 0
+    if (report_id == LATENCY_PROBE_ID) latencyProbe.probe(buffer, len, micros());
+#endif
   }
 
-  bool getLed() {
-    return ledState;
+  /// @brief Fill a feature report, which is read by the host
+  /// @return size of the report, 0 if it is unknown
+  uint16_t getFeature(uint8_t report_id, uint8_t* buffer, uint16_t len) {
+#if LATENCY_PROBE > 0
+    if (report_id == LATENCY_PROBE_ID) {
+#if HID_SCHEDULER > 0
+      uint8_t queueDepth = hidScheduler.pending();  // read without the lock, a snapshot is good enough for the probe
+#else
+      uint8_t queueDepth = 0;
+#endif
+      return latencyProbe.echo(buffer, len, micros(), queueDepth);
+    }
+#endif
+    return 0;
   }
 
   bool send(uint8_t id, const void* value, size_t len) {
-    return HID.SendReport(id, value, len);
+    TELEMETRY_REPORT(id, value, len);
+    if (reportSink) {
+      reportSink(id, value, len);
+      return true;
+    }
+#if LATENCY_PROBE > 0
+    if (id == 1 || id == 2) latencyProbe.motionPosted();
+#endif
+#if HID_SCHEDULER > 0
+    return hidSchedulerPost(id, value, len);
+#else
+    bool sent = hidTransport->send(id, (const uint8_t*)value, len);
+    hidReportSent(id, micros());
+    return sent;
+#endif
   }
 
   void sendBattery(uint8_t percent, bool charging) {
@@ -140,15 +260,29 @@ public:
       uint8_t payload[2];
       payload[0] = constrain(percent, 0, 100);
       payload[1] = charging ? 1 : 0;
-      HID.SendReport(23, payload, sizeof(payload));
+#if HID_SCHEDULER > 0
+      hidSchedulerPost(23, payload, sizeof(payload));
+#else
+      hidTransport->send(23, payload, sizeof(payload));
+#endif
     }
   }
 };
 
 SpaceMouseHID_Device SpaceMouseHID;
 
+// the handlers of the reports from the host for all transports
+void hidOutput(uint8_t id, const uint8_t* data, uint16_t len) {
+  SpaceMouseHID.output(id, data, len);
+}
+
+uint16_t hidGetFeature(uint8_t id, uint8_t* buffer, uint16_t len) {
+  return SpaceMouseHID.getFeature(id, buffer, len);
+}
+
 
 char usbState[32] = "USB: Unknown";
+volatile bool usbSuspended = false;  // the host has suspended the USB, see the power governor
 char mscState[32] = "MSC: Idle";
 char mscProgress[32] = "";
 
@@ -167,10 +301,12 @@ static void usbEventCallback(void* arg, esp_event_base_t event_base, int32_t eve
       case ARDUINO_USB_SUSPEND_EVENT:
         SERIAL.printf("USB SUSPENDED: remote_wakeup_en: %u\n", data->suspend.remote_wakeup_en);
         snprintf(usbState, sizeof(usbState), "USB: Suspended");
+        usbSuspended = true;
         break;
       case ARDUINO_USB_RESUME_EVENT:
         SERIAL.println("USB RESUMED");
         snprintf(usbState, sizeof(usbState), "USB: Resumed");
+        usbSuspended = false;
         break;
       default: break;
     }
@@ -216,6 +352,9 @@ static void usbEventCallback(void* arg, esp_event_base_t event_base, int32_t eve
   u8g2.drawStr(0, 22, mscState);
   u8g2.drawStr(0, 32, mscProgress);
   u8g2.sendBuffer();
+#if SCREEN_DIRTY_RENDER > 0
+  screenInvalidate();
+#endif
 }
 
 
@@ -240,8 +379,17 @@ void setupUSB() {
 #endif
   MSC_Update.begin();
 #endif
-  SpaceMouseHID.begin();
+  usbHidTransport.setHandlers(hidOutput, hidGetFeature);
+  usbHidTransport.begin(report_descriptor, sizeof(report_descriptor));
+#if HID_SCHEDULER > 0
+  hidScheduler.onSent = hidReportSent;
+  hidSchedulerMutex = xSemaphoreCreateMutex();
+#endif
+  selectTransport(usbHidTransport);
   USB.begin();
+#if HID_SCHEDULER > 0
+  startHidSchedulerTask();
+#endif
 }
 
 
@@ -251,59 +399,66 @@ enum SpaceMouseHIDStates {
   ST_START,      // start to check if something is to be sent
   ST_SENDTRANS,  // send translations
   ST_SENDROT,    // send rotations
-  ST_SENDKEYS    // send keys
+  ST_SENDKEYS,   // send keys
+  ST_SENDALL     // send the combined report, see HID_COMBINED_REPORT
 };
 
 SpaceMouseHIDStates nextState;
 
-#define HIDMAXBUTTONS 2        // for Compact
 unsigned long lastHIDsentRep;  // time from millis(), when the last HID report was sent
 
-
+uint8_t countTransZeros = 0;  // count how many times, the zero data has been sent
+uint8_t countRotZeros = 0;
 #if (NUMKEYS > 0)
-// Array with the bitnumbers, which should assign keys to buttons
-uint8_t bitNumber[NUMHIDKEYS] = BUTTONLIST;
-
-// Takes the data in keys and sort them into the bits of keyData
-// Which key from keyData should belong to which byte is defined in bitNumber = BUTTONLIST see config.h
-void prepareKeyBytes(uint8_t* keys, uint8_t* keyData, int debug) {
-  for (int i = 0; i < HIDMAXBUTTONS; i++) {
-    keyData[i] = 0;
-  }
+uint8_t keyData[HIDMAXBUTTONS];      // key data to be sent via HID
+uint8_t prevKeyData[HIDMAXBUTTONS];  // previous key data
+#endif
 
-  // bitNumber[] should be { 0, 1 } for the Compact
-  for (int i = 0; i < NUMHIDKEYS; i++) {
-    if (keys[i]) {
-      int bitNo = bitNumber[i];
-      int byteNo = bitNo / 8;
-      int bitPos = bitNo % 8;
-      // ACCUMULATE instead of overwrite:
-      keyData[byteNo] |= (1 << bitPos);
-
-      if (debug == 8) {
-        SERIAL.printf("bitNumber: %d -> keyData[%d] = 0x%02X\n", bitNumber[i], (bitNumber[i] / 8), keyData[(bitNumber[i] / 8)]);
-      }
-    }
-  }
+#if HID_COALESCE > 0
+int16_t hidSignificance[HID_COALESCE_MAX_VALUES] = HID_SIGNIFICANCE;  // x, y, z, rx, ry, rz, the buttons are compared exactly
+ReportCoalescer reportCoalescer(HID_MAX_STALE_MS);
+#endif
+
+/// @brief Check, if a report is significant enough to be sent, see HID_COALESCE in config.h
+/// @param first index of the first value in hidSignificance, 0 for translations, 3 for rotations
+bool admitReport(uint8_t id, const int16_t* values, int first, int count, unsigned long now) {
+#if HID_COALESCE > 0
+  return reportCoalescer.admit(id, values, hidSignificance + first, count, now);
+#else
+  return true;
+#endif
 }
+
+/// @brief Start the state machine of sendUSBData() from the beginning, e.g. before the replay of a trace
+void resetUSBData() {
+  nextState = ST_INIT;
+#if HID_COALESCE > 0
+  reportCoalescer.reset();
 #endif
+  countTransZeros = 0;
+  countRotZeros = 0;
+#if (NUMKEYS > 0)
+  memset(keyData, 0, sizeof(keyData));
+  memset(prevKeyData, 0, sizeof(prevKeyData));
+#endif
+}
+
 
 // check if a new HID report shall be send
 bool IsNewHidReportDue(unsigned long now) {
+#if HID_SCHEDULER > 0
+  return true;  // the reports are coalesced and paced by the hidScheduler
+#endif
   return (now - lastHIDsentRep >= HIDUPDATERATE_MS);
 }
 
 bool sendUSBData(int16_t rx, int16_t ry, int16_t rz, int16_t x, int16_t y, int16_t z, uint8_t* keys, int debug) {
 
-  static uint8_t countTransZeros = 0;  // count how many times, the zero data has been sent
-  static uint8_t countRotZeros = 0;
-  unsigned long now = millis();
+  unsigned long now = clockMillis();
   bool hasSentNewData = false;  // this value will be returned
 
 #if (NUMKEYS > 0)
-  static uint8_t keyData[HIDMAXBUTTONS];      // key data to be sent via HID
-  static uint8_t prevKeyData[HIDMAXBUTTONS];  // previous key data
-  prepareKeyBytes(keys, keyData, debug);      // sort the bytes from keys into the bits in keyData
+  prepareKeyBytes(keys, keyData, debug);  // sort the bytes from keys into the bits in keyData
 #endif
 
   switch (nextState)  // state machine
@@ -316,12 +471,12 @@ bool sendUSBData(int16_t rx, int16_t ry, int16_t rz, int16_t x, int16_t y, int16
     case ST_START:
       // Evaluate everytime, without waiting for 8ms
       if (countTransZeros < 3 || countRotZeros < 3 || (x != 0 || y != 0 || z != 0 || rx != 0 || ry != 0 || rz != 0)) {
-        nextState = ST_SENDTRANS;
+        nextState = (HID_COMBINED_REPORT > 0) ? ST_SENDALL : ST_SENDTRANS;
       } else {
 #if (NUMKEYS > 0)
         // compare key data to previous key data
         if (memcmp(keyData, prevKeyData, HIDMAXBUTTONS) != 0) {
-          nextState = ST_SENDKEYS;
+          nextState = (HID_COMBINED_REPORT > 0 && HID_COMBINED_BUTTONS > 0) ? ST_SENDALL : ST_SENDKEYS;
         }
 #endif
         if (nextState == ST_START && IsNewHidReportDue(now)) {
@@ -332,13 +487,23 @@ bool sendUSBData(int16_t rx, int16_t ry, int16_t rz, int16_t x, int16_t y, int16
     case ST_SENDTRANS:
       // send translation data, if the 8 ms from the last hid report have past
       if (IsNewHidReportDue(now)) {
-        uint8_t payload[6];
-        int16_t trans[] = { x, y, z };
-        memcpy(payload, trans, 6);
-        SpaceMouseHID.send(1, payload, sizeof(payload));
-
-        lastHIDsentRep += HIDUPDATERATE_MS;
-        hasSentNewData = true;  // return value
+        const int16_t values[3] = { x, y, z };
+        if (admitReport(1, values, 0, 3, now)) {
+          uint8_t payload[HID_AXES_REPORT_SIZE];
+          packAxesReport(payload, x, y, z);
+          SpaceMouseHID.send(1, payload, sizeof(payload));
+
+          lastHIDsentRep += HIDUPDATERATE_MS;
+          hasSentNewData = true;  // return value
+
+          if (debug == 20 || debug == 21) {
+            SERIAL.printf(
+              "Tran payload: %02X %02X %02X %02X %02X %02X, countRotZeros: %d\n",
+              payload[0], payload[1], payload[2],
+              payload[3], payload[4], payload[5],
+              countRotZeros);
+          }
+        }
 
         if (x == 0 && y == 0 && rz == 0) {
           countTransZeros++;
@@ -346,38 +511,32 @@ bool sendUSBData(int16_t rx, int16_t ry, int16_t rz, int16_t x, int16_t y, int16
           countTransZeros = 0;
         }
         nextState = ST_SENDROT;
-
-        if (debug == 20 || debug == 21) {
-          SERIAL.printf(
-            "Tran payload: %02X %02X %02X %02X %02X %02X, countRotZeros: %d\n",
-            payload[0], payload[1], payload[2],
-            payload[3], payload[4], payload[5],
-            countRotZeros);
-        }
       }
       break;
     case ST_SENDROT:
       // send rotational data, if the 8 ms from the last hid report have past
       if (IsNewHidReportDue(now)) {
-        uint8_t payload[6];
-        int16_t rot[] = { rx, ry, rz };
-        memcpy(payload, rot, 6);
-        SpaceMouseHID.send(2, payload, sizeof(payload));
-
-        lastHIDsentRep += HIDUPDATERATE_MS;
-        hasSentNewData = true;  // return value
-
         if (rx == 0 && ry == 0 && rz == 0) {
           countRotZeros++;
         } else {
           countRotZeros = 0;
         }
-        if (debug == 20 || debug == 22) {
-          SERIAL.printf(
-            "Rot payload:  %02X %02X %02X %02X %02X %02X, countRotZeros: %d\n",
-            payload[0], payload[1], payload[2],
-            payload[3], payload[4], payload[5],
-            countRotZeros);
+        const int16_t values[3] = { rx, ry, rz };
+        if (admitReport(2, values, 3, 3, now)) {
+          uint8_t payload[HID_AXES_REPORT_SIZE];
+          packAxesReport(payload, rx, ry, rz);
+          SpaceMouseHID.send(2, payload, sizeof(payload));
+
+          lastHIDsentRep += HIDUPDATERATE_MS;
+          hasSentNewData = true;  // return value
+
+          if (debug == 20 || debug == 22) {
+            SERIAL.printf(
+              "Rot payload:  %02X %02X %02X %02X %02X %02X, countRotZeros: %d\n",
+              payload[0], payload[1], payload[2],
+              payload[3], payload[4], payload[5],
+              countRotZeros);
+          }
         }
 
 // check if the next state should be keys
@@ -408,6 +567,52 @@ bool sendUSBData(int16_t rx, int16_t ry, int16_t rz, int16_t x, int16_t y, int16
       }
       break;
 #endif
+    case ST_SENDALL:
+      // send all axis (and the buttons) in one report, if the time since the last report has past
+      if (IsNewHidReportDue(now)) {
+        if (x == 0 && y == 0 && z == 0) {
+          countTransZeros++;
+        } else {
+          countTransZeros = 0;
+        }
+        if (rx == 0 && ry == 0 && rz == 0) {
+          countRotZeros++;
+        } else {
+          countRotZeros = 0;
+        }
+        int16_t values[HID_COALESCE_MAX_VALUES] = { x, y, z, rx, ry, rz };
+        int count = 6;
+#if (NUMKEYS > 0 && HID_COMBINED_BUTTONS > 0)
+        for (int i = 0; i < HIDMAXBUTTONS; i++) values[count++] = keyData[i];
+#endif
+        if (admitReport(1, values, 0, count, now)) {
+          uint8_t payload[HID_COMBINED_MAX_SIZE];
+#if (NUMKEYS > 0 && HID_COMBINED_BUTTONS > 0)
+          size_t len = packCombinedReport(payload, x, y, z, rx, ry, rz, keyData, HIDMAXBUTTONS);
+          memcpy(prevKeyData, keyData, HIDMAXBUTTONS);
+#else
+          size_t len = packCombinedReport(payload, x, y, z, rx, ry, rz, nullptr, 0);
+#endif
+          SpaceMouseHID.send(1, payload, len);
+
+          lastHIDsentRep += HIDUPDATERATE_MS;
+          hasSentNewData = true;  // return value
+
+          if (debug == 20 || debug == 21 || debug == 22) {
+            SERIAL.print("All payload: ");
+            for (size_t i = 0; i < len; i++) SERIAL.printf(" %02X", payload[i]);
+            SERIAL.printf(", countTransZeros: %d, countRotZeros: %d\n", countTransZeros, countRotZeros);
+          }
+        }
+
+        nextState = ST_START;
+#if (NUMKEYS > 0 && HID_COMBINED_BUTTONS == 0)
+        if (memcmp(keyData, prevKeyData, HIDMAXBUTTONS) != 0) {
+          nextState = ST_SENDKEYS;
+        }
+#endif
+      }
+      break;
     default:
       nextState = ST_START;  // send nothing if all data is zero
       break;
@@ -0,0 +1,18 @@
+// This file contains the clock of the processing. Normally it is millis() and micros().
+// During the replay of a trace (see traceReplay.h), the time is taken from the trace instead, so the replay doesn't depend
+// on the speed of the replay and gives the same HID reports every time.
+#ifndef VIRTUALCLOCK_H
+#define VIRTUALCLOCK_H
+#include <stdint.h>
+
+bool clockVirtual = false;     // true: use clockVirtualUs instead of the real time
+uint32_t clockVirtualUs = 0;  // virtual time in us
+
+inline unsigned long clockMillis() {
+  return clockVirtual ? clockVirtualUs / 1000 : millis();
+}
+
+inline unsigned long clockMicros() {
+  return clockVirtual ? clockVirtualUs : micros();
+}
+#endif